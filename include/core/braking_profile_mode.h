@@ -0,0 +1,27 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2013 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#ifndef INC_BRAKING_PROFILE_MODE_ALREADY
+#define INC_BRAKING_PROFILE_MODE_ALREADY
+
+enum class BRAKING_PROFILE_MODE {
+	STRICT,         ///< Braking speeds are calculated exactly
+	TABLE,          ///< Braking speeds are interpolated from per-train tables, see train_braking_profile_cache
+};
+
+#endif
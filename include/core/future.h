@@ -19,10 +19,9 @@
 #ifndef INC_FUTURE_ALREADY
 #define INC_FUTURE_ALREADY
 
-#include <list>
 #include <memory>
-#include <map>
 #include <string>
+#include <vector>
 #include "core/serialisable.h"
 #include "common.h"
 
@@ -37,11 +36,26 @@ typedef deserialisation_type_factory<future_container &, serialisable_futurable_
 
 //all futures must be allocated with new
 class future : public serialisable_obj {
+	friend future_set;
+	friend futurable_obj;
+
 	futurable_obj &target;
 	world_time trigger_time;
 	const uint64_t future_id = 1;
 	future_set *registered_fs = 0;
 
+	//These are owned by registered_fs
+	std::shared_ptr<future> fs_self;    // keeps this alive whilst registered
+	future *fs_prev = 0;
+	future *fs_next = 0;
+	uint64_t fs_seq = 0;
+	unsigned int fs_bucket = 0;
+
+	//These are owned by target
+	future *fo_prev = 0;
+	future *fo_next = 0;
+	bool fo_linked = false;
+
 	virtual void ExecuteAction() = 0;
 
 	public:
@@ -62,11 +76,45 @@ class future_container {
 	virtual void EnumerateRegisteredFutures(std::function<void(world_time, const std::shared_ptr<future> &)> func) const = 0;
 };
 
+//Hierarchical timing wheel
+//Registration and removal are O(1), each future is cascaded down at most once per level before it is executed
+//Futures with the same trigger time are executed in registration order
 class future_set : public future_container {
-	std::multimap<world_time, std::shared_ptr<future> > futures;
+	enum {
+		WHEEL_SLOT_BITS = 6,
+		WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS,
+		WHEEL_SLOT_MASK = WHEEL_SLOTS - 1,
+		WHEEL_LEVELS = (sizeof(world_time) * 8 + WHEEL_SLOT_BITS - 1) / WHEEL_SLOT_BITS,
+		OVERDUE_BUCKET = WHEEL_LEVELS * WHEEL_SLOTS,    // futures registered with a trigger time before wheel_time
+		BUCKET_COUNT = OVERDUE_BUCKET + 1,
+	};
+
+	struct bucket {
+		future *head = 0;
+		future *tail = 0;
+	};
+
+	bucket buckets[BUCKET_COUNT];
+	uint64_t occupied[WHEEL_LEVELS] = { };
+	world_time wheel_time = 0;
+	uint64_t next_seq = 0;
+	size_t count = 0;
+	std::vector<std::shared_ptr<future> > exec_buffer;
+
+	static bool ExecutesBefore(const future &a, const future &b);
+	void Insert(future *f);
+	void Unlink(future *f);
+	void TakeBucket(unsigned int index, std::vector<std::shared_ptr<future> > &out);
+	void AdvanceTo(world_time ft, std::vector<std::shared_ptr<future> > &out);
 
 	public:
+	future_set() = default;
+	future_set(const future_set &) = delete;
+	future_set &operator=(const future_set &) = delete;
+	~future_set();
 	void ExecuteUpTo(world_time ft);
+	size_t GetCount() const { return count; }
+	bool GetNextTriggerTime(world_time &ft) const;    // returns false if the set is empty
 	virtual void RegisterFuture(const std::shared_ptr<future> &f) override;
 	virtual void RemoveFuture(future &f) override;
 	virtual void EnumerateRegisteredFutures(std::function<void(world_time, const std::shared_ptr<future> &)> func) const override;
@@ -75,12 +123,16 @@ class future_set : public future_container {
 class serialisable_futurable_obj;
 
 class futurable_obj {
-	//Use list because various parts of the code erase elements whilst iterating the list
-	//vector iterator invalidation would break this
-	//Don't use forward_list, because this reverses the order on serialisation round-trip
-	std::list<future *> own_futures;
+	//Intrusive doubly-linked list through future::fo_prev/fo_next, in registration order
+	//Various parts of the code erase elements whilst enumerating the list, see EnumerateFutures
+	//Registration order must be kept, otherwise the order changes on serialisation round-trip
+	future *futures_head = 0;
+	future *futures_tail = 0;
 
 	public:
+	futurable_obj() = default;
+	futurable_obj(const futurable_obj &) = delete;
+	futurable_obj &operator=(const futurable_obj &) = delete;
 	virtual ~futurable_obj() { }
 	void ClearFutures();
 	void EnumerateFutures(std::function<void (future &)> f);
@@ -88,6 +140,7 @@ class futurable_obj {
 	bool HaveFutures() const;
 
 	private:
+	friend future;
 	friend future_set;
 	void DeregisterFuture(future *f);
 	void RegisterFuture(future *f);
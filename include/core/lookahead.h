@@ -19,9 +19,9 @@
 #ifndef INC_LOOKAHEAD_ALREADY
 #define INC_LOOKAHEAD_ALREADY
 
-#include <deque>
 #include <functional>
 
+#include "util/ring_buffer.h"
 #include "track.h"
 
 class generic_track;
@@ -51,12 +51,38 @@ class lookahead  : public serialisable_obj {
 		uint64_t sighting_offset;
 		vartrack_target_ptr<routing_point> gs;
 		unsigned int last_aspect;
-		std::deque<lookahead_item> l2_list;
+		unsigned int l2_count = 0;    // number of items in l2_list which belong to this routing point
+		const route *rt = nullptr;    // route from the previous routing point which was scanned to reach this one, if any
 	};
 
+	public:
+	// State saved by StartUndoRecording, the lists are only copied when they are first modified
+	class undo_state {
+		friend lookahead;
+
+		uint64_t current_offset = 0;
+		unsigned int scan_count = 0;
+		bool lists_saved = false;
+		ring_buffer<lookahead_routing_point> l1_list;
+		ring_buffer<lookahead_item> l2_list;
+	};
 
+	private:
+	// The items of each routing point are stored contiguously in l2_list, in the same order as the routing points in l1_list.
+	// New items are always added to the last routing point.
 	uint64_t current_offset = 0;
-	std::deque<lookahead_routing_point> l1_list;
+	ring_buffer<lookahead_routing_point> l1_list;
+	ring_buffer<lookahead_item> l2_list;
+	unsigned int scan_count = 0;
+	undo_state *undo = nullptr;
+
+	void SaveListsForUndo();
+	void TruncateL1(size_t l1_count);
+	void TruncateL2(size_t l1_index, size_t l2_index);
+	void SetRoutingPoint(const vartrack_target_ptr<routing_point> &sig, uint64_t offset, unsigned int &blocklimit);
+	lookahead_item &AddPiece(const train *t /* optional */, const track_target_ptr &piece, unsigned int connection_index, uint64_t &offset);
+	void ScanUnrouted(const train *t /* optional */, track_target_ptr current, uint64_t offset, unsigned int blocklimit);
+	size_t KeepValidBlocks(size_t l1_index, unsigned int &blocklimit);
 
 	public:
 	enum class LA_ERROR {
@@ -74,10 +100,49 @@ class lookahead  : public serialisable_obj {
 	void ScanAppend(const train *t /* optional */, const track_location &pos, unsigned int blocklimit, const route *rt);
 	void Clear();
 
+	// Any changes made after calling StartUndoRecording can be reverted by Undo, until StopUndoRecording is called
+	// state must remain valid until then
+	void StartUndoRecording(undo_state &state);
+	void StopUndoRecording() { undo = nullptr; }
+	void Undo(undo_state &state);
+
+	unsigned int GetScanCount() const { return scan_count; }
+	uint64_t GetCurrentOffset() const { return current_offset; }
+
+	// Lowest offset ahead at which CheckLookaheads would newly sight a routing point or points, or UINT64_MAX if none
+	uint64_t GetNextSightingOffset() const;
+
+	// Returns false if the aspect or target of any sighted routing point, or the state of any sighted points,
+	// has changed such that CheckLookaheads would modify the lookahead or report a new stop
+	bool IsSightedRoutingUnchanged() const;
+
+	// Enumerates the track which has already been scanned, in order of offset, without rescanning or checking signal aspects.
+	// piece_func(start_offset, end_offset, speed, piece): speed is 0 if the piece cannot currently be passed, or UINT_MAX if there is no limit
+	// rp_func(offset, routing_point, aspect): aspect is the aspect of the routing point when last seen by the train
+	template <typename F, typename G> void EnumerateScanned(F piece_func, G rp_func) const;
+
 	virtual void Deserialise(const deserialiser_input &di, error_collection &ec) override;
 	virtual void Serialise(serialiser_output &so, error_collection &ec) const override;
 };
 
 template<> struct enum_traits< lookahead::lookahead_item::LAI_FLAGS > { static constexpr bool flags = true; };
 
+template <typename F, typename G> void lookahead::EnumerateScanned(F piece_func, G rp_func) const {
+	size_t l2_start = 0;
+	for (size_t i = 0; i < l1_list.size(); l2_start += l1_list[i].l2_count, i++) {
+		for (size_t j = l2_start; j < l2_start + l1_list[i].l2_count; j++) {
+			const lookahead_item &l2 = l2_list[j];
+			unsigned int speed = l2.speed;
+			if (l2.flags & lookahead_item::LAI_FLAGS::NOT_ALWAYS_PASSABLE && !l2.piece.track->IsTrackPassable(l2.piece.direction, l2.connection_index)) {
+				speed = 0;
+			}
+			piece_func(l2.start_offset, l2.end_offset, speed, l2.piece);
+		}
+		const lookahead_routing_point &l1 = l1_list[i];
+		if (l1.gs.IsValid()) {
+			rp_func(l1.offset, l1.gs, l1.last_aspect);
+		}
+	}
+}
+
 #endif
@@ -93,6 +93,9 @@ class generic_points : public generic_zlen_track {
 		return IsFlagsImmovable(GetPointsFlags(points_index));
 	}
 
+	// Returns the state bits which determine which actions reserving a route through these points would submit
+	inline unsigned int GetReservationActionStateBits(unsigned int points_index) const;
+
 	virtual bool IsMovementAllowedByOwnReservationState(unsigned int points_index, bool is_rev, reservation_result *conflicts_out = nullptr) { return true; }
 	bool IsMovementAllowedByReservationState(unsigned int points_index, bool is_rev, reservation_result *conflicts_out = nullptr);
 	bool IsMovementAllowedByCoupledReservationState(unsigned int points_index, bool is_rev, reservation_result *conflicts_out = nullptr);
@@ -115,6 +118,10 @@ inline bool generic_points::IsFlagsImmovable(PTF pflags) {
 	return false;
 }
 
+inline unsigned int generic_points::GetReservationActionStateBits(unsigned int points_index) const {
+	return (GetPointsFlags(points_index) & PTF::REV ? 1 : 0) | (trs.GetReservationCount() ? 2 : 0);
+}
+
 class points : public generic_points {
 	track_target_ptr prev;
 	track_target_ptr normal;
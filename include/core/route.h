@@ -34,6 +34,8 @@ class track_circuit;
 class generic_signal;
 class track_berth;
 class route_restriction_set;
+class route_conflict_matrix;
+class generic_points;
 typedef std::vector<routing_point *> via_list;
 typedef std::vector<track_circuit *> tc_list;
 typedef std::vector<generic_signal *> sig_list;
@@ -125,9 +127,9 @@ template<> struct enum_traits< route_common::DeserialisationFlags> { static cons
 class route_restriction : public route_common {
 	friend route_restriction_set;
 
-	std::vector<std::string> targets;
-	std::vector<std::string> via;
-	std::vector<std::string> not_via;
+	std::vector<track_id_type> targets;
+	std::vector<track_id_type> via;
+	std::vector<track_id_type> not_via;
 
 	route_class::set allowed_types = route_class::All();
 	route_class::set apply_to_types = route_class::All();
@@ -144,16 +146,19 @@ class route_restriction_set {
 	public:
 	route_class::set CheckAllRestrictions(std::vector<const route_restriction*> &matching_restrictions, const route_recording_list &route_pieces,
 			const track_target_ptr &piece) const;
-	void DeserialiseRestriction(const deserialiser_input &subdi, error_collection &ec, bool isendtype);
+	void DeserialiseRestriction(world &w, const deserialiser_input &subdi, error_collection &ec, bool isendtype);
 
 	unsigned int GetRestrictionCount() const { return restrictions.size(); }
 };
 
+size_t HashViaList(const via_list &vias);
+
 struct route  : public route_common {
 	vartrack_target_ptr<routing_point> start;
 	route_recording_list pieces;
 	vartrack_target_ptr<routing_point> end;
 	via_list vias;
+	size_t vias_hash = 0;    // HashViaList(vias), set by FillLists
 	tc_list track_circuits;
 	sig_list repeater_signals;
 	passable_test_list pass_test_list;
@@ -163,6 +168,14 @@ struct route  : public route_common {
 	routing_point *parent = nullptr;
 	unsigned int index  = 0;
 
+	route_conflict_matrix *conflict_matrix = nullptr;    // set by route_conflict_matrix::Build
+	unsigned int conflict_id = ~0u;
+
+	std::vector<std::pair<generic_points *, unsigned int> > action_points;    // points and indices whose state determines RouteReservationActions, set by FillLists
+	mutable uint64_t action_count_key = 0;
+	mutable unsigned int action_count = 0;
+	mutable bool action_count_valid = false;
+
 	route() : type(route_class::ID::NONE) { }
 	void FillLists();
 	bool TestRouteForMatch(const routing_point *check_end, const via_list &check_vias) const;
@@ -171,6 +184,13 @@ struct route  : public route_common {
 	reservation_result PartialRouteReservationWithActions(RRF reserve_flags, std::string *fail_reason_key, RRF action_reserve_flags,
 			std::function<void(action &&reservation_act)> action_callback, track_reservation_state_backup_guard *guard = nullptr) const;
 	void RouteReservationActions(RRF reserve_flags, std::function<void(action &&reservation_act)> action_callback) const;
+
+	// Returns the number of actions which RouteReservationActions(RRF::RESERVE) would currently submit
+	// This is memoised, keyed on the state of the points in action_points
+	unsigned int GetReservationActionCount() const;
+
+	// Returns true if a reservation with reserve_flags is known to fail as a conflicting route is set, without walking the route
+	bool IsReservationBlockedBySetRoute(RRF reserve_flags) const;
 	bool IsRouteSubSet(const route *subset) const;
 	bool IsStartAnchored(RRF check_mask = RRF::RESERVE) const;
 	bool IsRouteTractionSuitable(const train* t) const;
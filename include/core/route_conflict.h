@@ -0,0 +1,75 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2013 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#ifndef INC_ROUTE_CONFLICT_ALREADY
+#define INC_ROUTE_CONFLICT_ALREADY
+
+#include <vector>
+#include <cstdint>
+#include "core/track_reservation.h"
+
+class world;
+struct route;
+
+// Precomputed conflict relation between all routes and overlaps in the world.
+// Two routes conflict if they use the same piece of track with a different direction or connection index,
+// such that a reservation of one will always fail whilst the other is reserved.
+// Conflicts which depend on dynamic state, such as locked points, are not included.
+//
+// A live set of routes which are currently reserved over their full length is also maintained,
+// this is used to reject route reservation attempts which must fail without walking the route.
+class route_conflict_matrix {
+	struct conflict_word {
+		unsigned int index;
+		uint64_t bits;
+	};
+
+	std::vector<route *> routes;                   // by conflict ID
+	std::vector<unsigned int> row_offsets;         // conflict_words offsets, by conflict ID, with a trailing end offset
+	std::vector<conflict_word> conflict_words;     // non-zero words of each route's conflict bitset
+	std::vector<uint64_t> set_routes;              // routes which are currently fully reserved, by conflict ID
+	bool built = false;
+
+	public:
+	static const unsigned int INVALID_ID = ~0u;
+
+	// Assigns conflict IDs to all routes and overlaps, and computes the conflict relation and set routes
+	// Must be called once all routes have been created
+	void Build(world &w);
+	bool IsBuilt() const { return built; }
+	unsigned int GetRouteCount() const { return routes.size(); }
+	unsigned int GetConflictWordCount() const { return conflict_words.size(); }
+
+	bool IsConflicting(const route &a, const route &b) const;
+
+	// Returns true if a route which conflicts with r is currently set
+	bool HasSetConflict(const route &r) const;
+	bool IsRouteSet(const route &r) const;
+
+	// These are called by track_reservation_state
+	void RouteSet(const route &r);
+	void RouteUnset(const route &r);
+
+	// Recompute whether r is currently reserved over its full length
+	void RefreshRoute(const route &r);
+
+	// Recompute the set routes from scratch, for use after reservations are changed without notification
+	void RefreshAllRoutes();
+};
+
+#endif
@@ -20,6 +20,7 @@
 #define INC_SIGNAL_ALREADY
 
 #include <vector>
+#include <unordered_map>
 
 #include "util/flags.h"
 #include "core/track.h"
@@ -82,6 +83,10 @@ class routing_point : public generic_zlen_track {
 
 	route_restriction_set endrestrictions;
 
+	// Routes starting here, by end routing point, in the same order as EnumerateRoutes
+	std::unordered_map<const routing_point *, std::vector<const route *> > route_index;
+	bool route_index_built = false;
+
 	protected:
 	unsigned int aspect = 0;
 	unsigned int reserved_aspect = 0;
@@ -110,6 +115,9 @@ class routing_point : public generic_zlen_track {
 			route_class::set types = route_class::AllOverlaps()) const;
 	virtual void EnumerateRoutes(std::function<void (const route *)> func) const;
 
+	// Must be called once all routes starting here have been created, GetMatchingRoutes then only looks at routes with the requested end
+	void BuildRouteIndex();
+
 	enum class GPBF {
 		ZERO            = 0,
 		GET_NON_EMPTY   = 1<<0,
@@ -225,6 +233,8 @@ class generic_signal : public track_routing_point {
 	virtual void UpdateSignalState();
 	virtual void UpdateRoutingPoint() override { UpdateSignalState(); }
 	virtual void TrackTick() override { UpdateSignalState(); }
+	virtual bool IsTickUpdateOrderSensitive() const override;
+	void InitTickUpdateDependencies();
 
 	virtual unsigned int GetTRSList(std::vector<track_reservation_state *> &output_list) override;
 
@@ -239,6 +249,7 @@ class generic_signal : public track_routing_point {
 	void BackwardsReservedTrackScan(std::function<bool(const generic_signal*)> checksignal, std::function<bool(const track_target_ptr&)> check_piece) const;
 
 	protected:
+	void UpdateSignalStateIntl(world_time &wake_time);    // wake_time is reduced to the time at which the result may change by itself
 	bool PostLayoutInitTrackScan(error_collection &ec, unsigned int max_pieces, unsigned int junction_max, route_restriction_set *restrictions,
 			std::function<route*(route_class::ID type, const track_target_ptr &piece)> make_blank_route);
 	virtual reservation_result ReservationV(const reservation_request_res &req) override;
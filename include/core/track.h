@@ -55,18 +55,22 @@ struct reservation_request_action;
 
 struct speed_restriction {
 	unsigned int speed;
-	std::string speed_class;
+	speed_class_id_type speed_class;    // 0 applies to all trains
 };
 
+// Restrictions are held in order of speed class ID, only the lowest speed for each speed class is kept
 class speed_restriction_set : public serialisable_obj {
-	std::forward_list<speed_restriction> speeds;
+	std::vector<speed_restriction> speeds;
+	const world *w = nullptr;    // set when deserialised, used to look up speed class names
 
 	public:
+	unsigned int GetTrackSpeedLimitByClass(speed_class_id_type speed_class, unsigned int default_max) const;
 	unsigned int GetTrackSpeedLimitByClass(const std::string &speed_class, unsigned int default_max) const;
 	unsigned int GetTrainTrackSpeedLimit(const train *t /* optional */) const;
-	inline void AddSpeedRestriction(const speed_restriction &sr) {
-		speeds.push_front(sr);
-	}
+
+	// As GetTrainTrackSpeedLimit, but not capped to the train's vehicle maximum speed
+	unsigned int GetTrainClassTrackSpeedLimit(const train *t) const;
+	void AddSpeedRestriction(const speed_restriction &sr);
 	virtual void Deserialise(const deserialiser_input &di, error_collection &ec) override;
 	virtual void Serialise(serialiser_output &so, error_collection &ec) const override;
 };
@@ -97,10 +101,16 @@ class generic_track : public world_obj {
 
 	unsigned int connection_reserved_edge_mask = 0;
 
+	track_id_type track_id = INVALID_TRACK_ID;
+	unsigned int tick_update_index = UINT_MAX;
+	std::vector<generic_track *> tick_update_dependents;
+
+	friend world;
 	friend world_deserialisation;
 	void SetPreviousTrackPiece(generic_track *prev) { prev_track = prev; }
 	void SetNextTrackPiece(generic_track *next) { next_track = next; }
 	public:
+	track_id_type GetTrackId() const { return track_id; }
 	const generic_track *GetPreviousTrackPiece() const { return prev_track; }
 	const generic_track *GetNextTrackPiece() const { return next_track; }
 
@@ -184,6 +194,15 @@ class generic_track : public world_obj {
 
 	virtual void TrackTick() { }
 
+	// Tick update dirty marking, see TICK_UPDATE_MODE
+	inline bool HasTickUpdate() const { return tick_update_index != UINT_MAX; }
+	void MarkTickUpdateDirty();
+	void ClearTickUpdateDirty();
+	void SetTickUpdateWakeup(world_time wake);
+	void AddTickUpdateDependent(generic_track *piece);
+	void MarkTickUpdateDependentsDirty();    // marks this piece (if it has a tick update) and all dependent pieces
+	virtual bool IsTickUpdateOrderSensitive() const { return false; }
+
 	virtual bool IsTrackAlwaysPassable() const { return true; }
 	inline bool IsTrackPassable(EDGE direction, unsigned int connection_index) const;
 
@@ -225,6 +244,12 @@ class generic_track : public world_obj {
 		train_os.clear();
 	}
 
+	// Finds the nearest train on this piece at or beyond offset, when moving in direction.
+	// Returns false if there are none, otherwise distance is set to the distance to the train, or 0 if offset is within the train.
+	virtual bool GetNearestTrainOccupation(EDGE direction, unsigned int offset, train_occupation &to, unsigned int &distance) {
+		return false;
+	}
+
 	private:
 	static bool TryConnectPiece(track_target_ptr &piece_var, const track_target_ptr &new_target);
 
@@ -39,6 +39,9 @@ class track_train_counter_block : public world_obj {
 	std::vector<train_ref> occupying_trains;
 	std::vector<generic_track *> owned_pieces;
 	world_time last_change;
+	std::vector<generic_track *> tick_update_dependents;
+
+	void OccupationStateChanged();
 
 	public:
 	enum class TCF {
@@ -63,6 +66,7 @@ class track_train_counter_block : public world_obj {
 	void RegisterTrack(generic_track *piece) { owned_pieces.push_back(piece); }
 	const std::vector<generic_track *> &GetOwnedTrackSet() const { return owned_pieces; }
 	void GetSetRoutes(std::vector<const route *> &routes);
+	void AddTickUpdateDependent(generic_track *piece);
 
 	virtual std::string GetTypeName() const override { return "Track Train Counter Block"; }
 	static std::string GetTypeSerialisationClassNameStatic() { return "track_train_counter_block"; }
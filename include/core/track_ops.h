@@ -163,10 +163,18 @@ class future_unreserve_track : public future_reserve_track_base {
 			: future_reserve_track_base(targ, ft, reserved_route_, rflags_ | RRF::UNRESERVE) { };
 };
 
+struct route_reservation_plan;
+
 class action_reserve_track_base : public action {
 	private:
 	void CancelApproachLocking(generic_signal *sig) const;
 
+	protected:
+	bool PlanRouteReservation(const route *rt, route_reservation_plan &plan, std::string &fail_reason_key) const;
+	bool PlanPathReservation(const routing_point *start, const routing_point *end, route_class::set allowed_route_types,
+			GMRF gmr_flags, RRF extra_flags, const via_list &vias, route_reservation_plan &plan, std::string &fail_reason_key) const;
+	void ExecuteRouteReservation(const route_reservation_plan &plan) const;
+
 	public:
 	action_reserve_track_base(world &w_) : action(w_) { }
 	bool TryReserveRoute(const route *rt, world_time action_time, std::function<void(const std::shared_ptr<future> &f)> error_handler) const;
@@ -225,6 +233,38 @@ class action_reserve_path : public action_reserve_track_base {
 	virtual void Serialise(serialiser_output &so, error_collection &ec) const override;
 };
 
+// Reserves a list of routes and paths together.
+// All requests are checked in a single pass, against the current reservation state and against the requests earlier in the list,
+// the compatible requests are then reserved together. Each failed request gets the same user message as action_reserve_track/action_reserve_path.
+class action_reserve_batch : public action_reserve_track_base {
+	public:
+	struct reserve_request {
+		const route *rt = nullptr;                 // a specific route, as for action_reserve_track, or
+		const routing_point *start = nullptr;      // a path, as for action_reserve_path
+		const routing_point *end = nullptr;
+		route_class::set allowed_route_types = route_class::AllNonOverlaps();
+		GMRF gmr_flags;
+		via_list vias;
+
+		reserve_request();
+	};
+
+	private:
+	std::vector<reserve_request> requests;
+
+	public:
+	action_reserve_batch(world &w_) : action_reserve_track_base(w_) { }
+	action_reserve_batch &AddRoute(const route &rt);
+	action_reserve_batch &AddPath(const routing_point *start, const routing_point *end, route_class::set allowed_route_types = route_class::AllNonOverlaps());
+	action_reserve_batch &AddPath(const routing_point *start, const routing_point *end, route_class::set allowed_route_types, GMRF gmr_flags, via_list vias);
+	const std::vector<reserve_request> &GetRequests() const { return requests; }
+	static std::string GetTypeSerialisationNameStatic() { return "action_reserve_batch"; }
+	virtual std::string GetTypeSerialisationName() const override { return GetTypeSerialisationNameStatic(); }
+	virtual void ExecuteAction() const override;
+	virtual void Deserialise(const deserialiser_input &di, error_collection &ec) override;
+	virtual void Serialise(serialiser_output &so, error_collection &ec) const override;
+};
+
 //NB: this operation does no approach locking or other safety checks
 class action_unreserve_track_route : public action_reserve_track_routeop {
 	public:
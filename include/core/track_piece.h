@@ -29,7 +29,11 @@ class track_seg : public generic_track {
 	traction_set traction_types;
 	std::vector<track_train_counter_block *> ttcbs;
 	unsigned int train_count = 0;
-	std::vector<train *> occupying_trains;
+	struct occupant {
+		train_occupation to;
+		uint64_t position_generation;    // train position generation when to was calculated
+	};
+	std::vector<occupant> occupying_trains;    // in order of increasing offset, trains cannot pass each other on the same piece
 	track_target_ptr next;
 	track_target_ptr prev;
 	track_reservation_state trs;
@@ -65,6 +69,9 @@ class track_seg : public generic_track {
 	virtual void Serialise(serialiser_output &so, error_collection &ec) const override;
 
 	protected:
+	train_occupation GetTrainOccupation(train *t) const;
+	const train_occupation &GetOccupantOccupation(occupant &o) const;
+
 	virtual unsigned int GetTRSList(std::vector<track_reservation_state *> &output_list) override {
 		output_list.push_back(&trs);
 		return 1;
@@ -76,6 +83,7 @@ class track_seg : public generic_track {
 
 	public:
 	virtual void GetTrainOccupationState(std::vector<train_occupation> &train_os) override;
+	virtual bool GetNearestTrainOccupation(EDGE direction, unsigned int offset, train_occupation &to, unsigned int &distance) override;
 
 	// For use of test code **only**
 	virtual track_seg & SetLength(unsigned int length) override;
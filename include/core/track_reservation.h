@@ -54,6 +54,7 @@ template<> struct enum_traits< RRF > { static constexpr bool flags = true; };
 
 class inner_track_reservation_state {
 	friend track_reservation_state;
+	friend track_reservation_state_backup_guard;
 
 	const route *reserved_route = nullptr;
 	EDGE direction = EDGE::INVALID;
@@ -126,13 +127,40 @@ struct reservation_request_action : public reservation_request_base {
 			: reservation_request_base(base), submit_action(std::move(submit_action_)) { }
 };
 
+// Reservations made with a backup guard are recorded in an undo log, and are rolled back when the guard is destroyed.
+// The undo log is shared by all guards on the thread, and records only the inner states which were actually changed.
+// Guards may be nested, but reservations may only be made using the innermost guard.
 class track_reservation_state_backup_guard {
 	friend track_reservation_state;
 
-	std::map<track_reservation_state *, std::vector<inner_track_reservation_state>> backups;
+	enum class UNDO_OP : unsigned char {
+		ADDED,
+		CHANGED,
+		REMOVED,
+	};
+
+	struct undo_record {
+		track_reservation_state *trs;
+		unsigned int position;
+		UNDO_OP op;
+		inner_track_reservation_state itrs;    // the added state, or the state before it was changed or removed
+	};
+
+	static thread_local std::vector<undo_record> undo_log;
+	static thread_local track_reservation_state_backup_guard *innermost_guard;
+
+	size_t start;
+	track_reservation_state_backup_guard *outer_guard;
+
+	void Record(track_reservation_state *trs, unsigned int position, UNDO_OP op, const inner_track_reservation_state &itrs);
 
 	public:
+	track_reservation_state_backup_guard();
 	~track_reservation_state_backup_guard();
+
+	// A savepoint may be rolled back to without destroying the guard, rollback is linear in the number of changes since the savepoint
+	size_t Savepoint() const { return undo_log.size(); }
+	void RollbackTo(size_t savepoint);
 };
 
 struct reservation_result {
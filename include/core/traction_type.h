@@ -21,36 +21,76 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include "core/serialisable.h"
 
 class train;
 
+typedef unsigned int traction_type_id_type;
+
 struct traction_type {
 	std::string name;
 	bool always_available;
+	traction_type_id_type id = 0;    ///< Small integer ID, assigned in order of registration with the world
 	traction_type(std::string n, bool a) : name(n), always_available(a) { }
 	traction_type() : always_available(false) { }
 };
 
+// Set of traction types, stored as a bitmap indexed by traction type ID.
+// The first 64 IDs are held inline, any further IDs use the overflow vector, which is only allocated when required.
+// The list of types is also kept, in order of insertion, for enumeration when serialising.
 class traction_set : public serialisable_obj {
+	uint64_t bits = 0;
+	std::vector<uint64_t> overflow;    // bits for IDs 64 and above
 	std::vector<traction_type *> tractions;
 
+	inline bool HasBit(traction_type_id_type id) const {
+		if (id < 64) {
+			return bits & (((uint64_t) 1) << id);
+		}
+		size_t word = (id / 64) - 1;
+		return word < overflow.size() && overflow[word] & (((uint64_t) 1) << (id % 64));
+	}
+
+	inline void SetBit(traction_type_id_type id) {
+		if (id < 64) {
+			bits |= ((uint64_t) 1) << id;
+			return;
+		}
+		size_t word = (id / 64) - 1;
+		if (word >= overflow.size()) {
+			overflow.resize(word + 1);
+		}
+		overflow[word] |= ((uint64_t) 1) << (id % 64);
+	}
+
 	public:
 	inline void AddTractionType(traction_type *type) {
 		if (!HasTraction(type)) {
+			SetBit(type->id);
 			tractions.emplace_back(type);
 		}
 	}
+	void RemoveTractionType(traction_type *type);
 
 	bool CanTrainPass(const train *t) const;
-	bool HasTraction(const traction_type *tt) const;
-	bool IsIntersecting(const traction_set &ts) const;
+	inline bool HasTraction(const traction_type *tt) const { return HasBit(tt->id); }
+	inline bool IsIntersecting(const traction_set &ts) const {
+		if (bits & ts.bits) {
+			return true;
+		}
+		return (!overflow.empty() && !ts.overflow.empty()) ? IsOverflowIntersecting(ts) : false;
+	}
 	void IntersectWith(const traction_set &ts);
 	void UnionWith(const traction_set &ts);
+	bool IsEmpty() const { return tractions.empty(); }
 	virtual void Deserialise(const deserialiser_input &di, error_collection &ec) override;
 	virtual void Serialise(serialiser_output &so, error_collection &ec) const override;
 
 	std::string DumpString() const;
+
+	private:
+	bool IsOverflowIntersecting(const traction_set &ts) const;
 };
 
 #endif
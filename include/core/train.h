@@ -20,12 +20,16 @@
 #define INC_TRAIN_ALREADY
 
 #include "core/world_obj.h"
+#include "core/braking_profile_mode.h"
 #include "core/track.h"
 #include "core/timetable.h"
 #include "core/lookahead.h"
+#include "core/train_projection.h"
 #include "core/serialisable.h"
 #include "core/traction_type.h"
 #include <list>
+#include <vector>
+#include <climits>
 
 struct vehicle_class : public serialisable_obj {
 	const std::string name;
@@ -76,6 +80,20 @@ struct train_track_speed_limit_item {
 	train_track_speed_limit_item(unsigned int speed_, unsigned int count_) : speed(speed_), count(count_) { }
 };
 
+// Multiset of the speed limits of the track pieces which a train covers.
+// Held as an array of distinct speeds with counts, sorted by increasing speed, such that the lowest limit is always at the front.
+class train_track_speed_limit_set {
+	std::vector<train_track_speed_limit_item> items;
+
+	public:
+	void Add(unsigned int speed);
+	bool Remove(unsigned int speed);    // returns false if speed is not in the set
+	void Clear() { items.clear(); }
+	bool Empty() const { return items.empty(); }
+	unsigned int GetLowest() const { return items.empty() ? UINT_MAX : items.front().speed; }
+	const std::vector<train_track_speed_limit_item> &GetItems() const { return items; }
+};
+
 struct train_dynamics {
 	unsigned int total_length = 0;
 	unsigned int veh_max_speed = 0;
@@ -88,6 +106,12 @@ struct train_dynamics {
 	unsigned int total_mass = 0;
 };
 
+// drag: N, drag_v: N/(m/s), drag_v_2: N/(m/s)^2, v: mm/s --> N
+inline int CalcDrag(unsigned int drag_const, unsigned int drag_v, unsigned int drag_v_2, unsigned int v) {
+	return drag_const + (((uint64_t) v) * ((uint64_t) drag_v)) / ((uint64_t) 1000)
+			+ (((uint64_t) v) * ((uint64_t) v) * ((uint64_t) drag_v_2)) / ((uint64_t) 1000000);
+}
+
 struct train_motion_state {
 	unsigned int current_speed = 0;
 	unsigned int current_max_speed = 0;
@@ -97,34 +121,148 @@ struct train_motion_state {
 	int tail_relative_height = 0;
 };
 
+// Per-train cache of braking curves, used by CheckCalculateProjectedBrakingSpeed to avoid a full integer square root
+// for each lookahead item on each step.
+// Profiles are keyed by target speed, and in BRAKING_PROFILE_MODE::TABLE also by the braking deceleration rounded down to a multiple of DECEL_BUCKET.
+// In BRAKING_PROFILE_MODE::STRICT, the previous result for the same target speed is used to seed the square root, the result is exact.
+// In BRAKING_PROFILE_MODE::TABLE, the result is linearly interpolated from a table of braking distances at SPEED_STEP intervals,
+// which is extended as required. The result is never greater than the exact value, and is less than it by at most:
+// SPEED_STEP/4 + (exact speed * DECEL_BUCKET / brake deceleration) + 2
+// The cache must be cleared whenever the train's motion properties change.
+class train_braking_profile_cache {
+	public:
+	static constexpr unsigned int DECEL_BUCKET = 4;       ///< m/(s^2) << 8
+	static constexpr unsigned int SPEED_STEP = 50;        ///< mm/s
+	static constexpr unsigned int MAX_PROFILES = 8;
+
+	private:
+	struct profile {
+		unsigned int decel_bucket;
+		unsigned int target_speed;
+		unsigned int last_brake_speed = 0;
+		unsigned int last_use = 0;
+		std::vector<uint64_t> distances;    ///< mm << 8, minimum braking distance from target_speed + (index * SPEED_STEP)
+
+		profile(unsigned int decel_bucket_, unsigned int target_speed_) : decel_bucket(decel_bucket_), target_speed(target_speed_) { }
+	};
+	std::vector<profile> profiles;
+	unsigned int use_counter = 0;
+
+	profile &GetProfile(unsigned int decel_bucket, unsigned int target_speed, bool &found);
+	unsigned int TableLookup(profile &p, unsigned int target_distance);
+
+	public:
+	// vsq is the exact squared braking speed, as calculated by CheckCalculateProjectedBrakingSpeed
+	unsigned int GetBrakeSpeed(BRAKING_PROFILE_MODE mode, unsigned int brake_deceleration, unsigned int target_speed,
+			unsigned int target_distance, uint64_t vsq);
+	void Clear() { profiles.clear(); }
+	size_t GetProfileCount() const { return profiles.size(); }
+};
+
+class train;
+class train_registry;
+
+// A train is free running when nothing in its lookahead could limit its speed before its lookahead reaches end_offset,
+// so checking the lookahead on each step can be skipped until then.
+// This holds for as long as the train's maximum speed and the routing state in its lookahead are unchanged,
+// and its braking deceleration is no lower than that used to calculate end_offset.
+// The train still moves on every step, such that track entry and exit events happen at the same steps as otherwise.
+struct train_free_run_state {
+	uint64_t end_offset = 0;
+	uint64_t routing_generation = 0;    // world routing state generation when last checked
+	unsigned int max_speed = 0;
+	int brake_deceleration = 0;         // m/(s^2) << 8
+};
+
+// State which is modified by train::TrainTimeStepPrepare, this is used to undo a prepared step
+// The lookahead is only copied if the step modifies it
+struct train_step_state {
+	friend train;
+
+	private:
+	unsigned int current_speed;
+	unsigned int flags;
+	world_time red_sig_wait_start_time;
+	lookahead::undo_state la;
+	train_free_run_state free_run;
+};
+
 class train : public world_obj, protected train_dynamics, protected train_motion_state {
+	friend train_registry;
+
 	enum class TF {
 		ZERO                 = 0,
 		CONSIST_REV_DIR      = 1<<0,
 		WAITING_AT_RED_SIG   = 1<<1,
+		PENDING_MOVE         = 1<<2,
+		PENDING_MOVE_SCANNED = 1<<3,
+		HELD                 = 1<<4,    // stationary and unable to move at the last time step
+		FREE_RUNNING         = 1<<5,    // see train_free_run_state
 	};
 	TF tflags = TF::ZERO;
 
 	std::list<train_unit> train_segments;
 	traction_set active_tractions;
 	std::string veh_speed_class;
-	std::forward_list<train_track_speed_limit_item> covered_track_speed_limits;
+	speed_class_id_type veh_speed_class_id = 0;
+	train_track_speed_limit_set covered_track_speed_limits;
 
 	lookahead la;
+	train_braking_profile_cache braking_profiles;
+	train_projection projection;
+	train_free_run_state free_run;
 	world_time red_sig_wait_start_time = 0;
 
 	std::string headcode;
 	timetable current_timetable;
 
-	void TrainMoveStep(unsigned int ms);
+	unsigned int pending_displacement = 0;
+	uint64_t position_generation = 0;    // incremented whenever head_pos or tail_pos are changed
+
+	train_id_type train_id = INVALID_TRAIN_ID;
+	size_t registry_slot = 0;
+
+	void TrainMovePrepare(unsigned int ms);
+	void TrainMoveCommit();
+	bool CheckFreeRunning(int min_acceleration);
 
 	public:
 	train(world &w_);
+	train_id_type GetTrainId() const { return train_id; }
+	uint64_t GetPositionGeneration() const { return position_generation; }
+	// Hides world_obj::SetName, such that the world's name index is kept up to date
+	// Returns false and leaves the name unchanged if another train already has newname
+	bool SetName(const std::string &newname);
 	void TrainTimeStep(unsigned int ms);
+
+	// TrainTimeStep split into two phases, TrainTimeStepPrepare followed by TrainTimeStepCommit is equivalent to TrainTimeStep.
+	// TrainTimeStepPrepare does not modify anything outside of this train, and may be run concurrently for different trains
+	// as long as nothing else modifies the world at the same time.
+	// TrainTimeStepCommit moves the train, which has side-effects on the track and other world state.
+	void TrainTimeStepPrepare(unsigned int ms);
+	void TrainTimeStepCommit();
+	bool IsPendingMoveScanned() const;
+
+	// True if the train cannot move until something else in the world changes
+	bool IsHeld() const;
+
+	// True if the train skipped checking its lookahead at the last time step
+	bool IsFreeRunning() const;
+	// Changes to the lookahead are recorded into state until EndSaveStepState is called
+	void SaveStepState(train_step_state &state);
+	void EndSaveStepState();
+	void RestoreStepState(train_step_state &state);
 	void CalculateTrainMotionProperties(unsigned int weather_factor_shl8);
 	void AddCoveredTrackSpeedLimit(unsigned int speed);
 	void RemoveCoveredTrackSpeedLimit(unsigned int speed);
 	void CalculateCoveredTrackSpeedLimit();
+	const train_track_speed_limit_set &GetCoveredTrackSpeedLimits() const { return covered_track_speed_limits; }
+	const train_braking_profile_cache &GetBrakingProfileCache() const { return braking_profiles; }
+	const lookahead &GetLookahead() const { return la; }
+
+	// Returns true if the projection was recalculated
+	bool UpdateProjection();
+	const train_projection &GetProjection() const { return projection; }
 	void ReverseDirection();
 	void RefreshCoveredTrackSpeedLimits();
 	void DropTrainIntoPosition(const track_location &position, error_collection &ec);
@@ -132,7 +270,8 @@ class train : public world_obj, protected train_dynamics, protected train_motion
 	inline const train_dynamics &GetTrainDynamics() const { return *this; }
 	inline const train_motion_state &GetTrainMotionState() const { return *this; }
 	inline unsigned int GetMaxVehSpeed() const { return veh_max_speed; }
-	inline std::string GetVehSpeedClass() const { return veh_speed_class; }
+	inline const std::string &GetVehSpeedClass() const { return veh_speed_class; }
+	inline speed_class_id_type GetVehSpeedClassId() const { return veh_speed_class_id; }
 	const traction_set &GetActiveTractionTypes() const { return active_tractions; }
 	traction_set GetAllTractionTypes() const;
 	void SetActiveTractionSet(traction_set ts) { active_tractions = std::move(ts); }
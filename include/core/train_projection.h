@@ -0,0 +1,83 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2013 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#ifndef INC_TRAIN_PROJECTION_ALREADY
+#define INC_TRAIN_PROJECTION_ALREADY
+
+#include <vector>
+#include <cstdint>
+#include "common.h"
+#include "core/track.h"
+
+class train;
+
+struct train_projection_point {
+	track_target_ptr target;    ///< Routing point, or track piece with a berth
+	bool is_berth;
+	uint64_t offset;            ///< Lookahead offset of target
+	unsigned int speed;         ///< mm/s, projected speed of the head of the train at target
+	world_time eta;             ///< Projected game time at which the head of the train reaches target
+};
+
+// Projection of the time-distance profile of a train over the track which its lookahead has already scanned,
+// giving projected arrival times at the routing points and berths ahead.
+// The train is assumed to accelerate at its maximum rate up to the lowest applicable speed limit, and to brake at its
+// maximum rate for lower speed limits and stops ahead, ignoring gradients.
+// The profile is only recalculated when the lookahead or the train changes, or when the train's actual progress
+// diverges from the profile by more than SPEED_TOLERANCE or TIME_TOLERANCE, otherwise updating it is a lookup.
+class train_projection {
+	public:
+	static constexpr unsigned int MAX_POINTS = 16;
+	static constexpr unsigned int DISTANCE_STEP = 10000;       ///< mm, resolution of the profile
+	static constexpr unsigned int SPEED_TOLERANCE = 1000;      ///< mm/s
+	static constexpr unsigned int TIME_TOLERANCE = 5000;       ///< ms
+
+	private:
+	bool valid = false;
+	uint64_t base_offset = 0;        // lookahead offset of the start of the profile
+	world_time base_time = 0;        // game time at the start of the profile
+	unsigned int scan_count = 0;     // lookahead scan count when the profile was calculated
+	unsigned int max_speed = 0;      // train's current maximum speed when the profile was calculated
+	unsigned int projection_count = 0;
+
+	// profile at intervals of DISTANCE_STEP from base_offset, the last interval may be shorter
+	uint64_t profile_length = 0;
+	std::vector<unsigned int> profile_speed;    // mm/s
+	std::vector<uint64_t> profile_time;         // ms from base_time, UINT64_MAX if not reachable
+	std::vector<train_projection_point> points;
+
+	void Project(const train &t, world_time now);
+	bool Lookup(uint64_t distance, unsigned int &speed, uint64_t &time) const;
+
+	public:
+	// Returns true if the profile was recalculated
+	bool Update(const train &t, world_time now);
+	void Invalidate() { valid = false; }
+	bool IsValid() const { return valid; }
+
+	// Points which the train is projected to reach, in order of distance, which the train has not yet passed
+	const std::vector<train_projection_point> &GetPoints() const { return points; }
+
+	// Returns false if target is not in the projection, or the train is not projected to reach it
+	bool GetEta(const generic_track *target, world_time &eta) const;
+
+	// Number of times that the profile has been recalculated
+	unsigned int GetProjectionCount() const { return projection_count; }
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "core/track.h"
 #include <functional>
 #include <deque>
+#include <algorithm>
 
 enum class ADF {
 	ZERO                    = 0,
@@ -37,11 +38,81 @@ enum class ADRESULTF {
 };
 template<> struct enum_traits<ADRESULTF> { static constexpr bool flags = true; };
 
-//return displacement length that could not be fulfilled
+//returns the distance which can be moved along the current piece of track before running into a train, or UINT_MAX
+//step is the distance which is to be moved along the current piece
+unsigned int GetTrainObstructionDistance(const track_location &track, unsigned int step);
+
+//returns displacement length that could not be fulfilled
+//func is called with the old and new locations each time that a piece of track is left
+template <typename F> unsigned int AdvanceDisplacement(unsigned int displacement, track_location &track, int *elevation_delta /*optional, out*/,
+		F func, flagwrapper<ADF> ad_flags = 0, flagwrapper<ADRESULTF> *ad_result_flags = nullptr) {
+
+	if (elevation_delta) {
+		*elevation_delta = 0;
+	}
+
+	if (!track.IsValid()) {
+		if (ad_result_flags) {
+			*ad_result_flags |= ADRESULTF::TRACK_INVALID;
+		}
+		return displacement;
+	}
+
+	while (displacement > 0) {
+		unsigned int length_on_piece = track.GetTrack()->GetRemainingLength(track.GetDirection(), track.GetOffset());
+
+		if (ad_flags & ADF::CHECK_FOR_TRAINS) {
+			unsigned int obstruction_offset = GetTrainObstructionDistance(track, std::min(displacement, length_on_piece));
+
+			if (obstruction_offset < displacement) {
+				track.GetOffset() = track.GetTrack()->GetNewOffset(track.GetDirection(), track.GetOffset(), obstruction_offset);
+				if (elevation_delta) {
+					*elevation_delta += track.GetTrack()->GetPartialElevationDelta(track.GetDirection(), obstruction_offset);
+				}
+				displacement -= obstruction_offset;
+
+				if (ad_result_flags) {
+					*ad_result_flags |= ADRESULTF::TRAIN_IN_WAY;
+				}
+				return displacement;
+			}
+		}
+
+		if (length_on_piece >= displacement) {
+			track.GetOffset() = track.GetTrack()->GetNewOffset(track.GetDirection(), track.GetOffset(), displacement);
+			if (elevation_delta) {
+				*elevation_delta += track.GetTrack()->GetPartialElevationDelta(track.GetDirection(), displacement);
+			}
+			break;
+		} else {
+			displacement -= length_on_piece;
+
+			if (elevation_delta) {
+				*elevation_delta += track.GetTrack()->GetElevationDelta(track.GetDirection());
+			}
+
+			track_location old_track = track;
+			const track_target_ptr &targ = old_track.GetTrack()->GetConnectingPiece(old_track.GetDirection());
+			if (targ.IsValid()) {
+				track.SetTargetStartLocation(targ);
+			} else {    //run out of valid track
+				track.GetOffset() = track.GetTrack()->GetNewOffset(track.GetDirection(), track.GetOffset(), length_on_piece);
+				if (ad_result_flags) {
+					*ad_result_flags |= ADRESULTF::RAN_OUT_OF_TRACK;
+				}
+				return displacement;
+			}
+
+			func(old_track, track);
+		}
+	}
+	return 0;
+}
+
 unsigned int AdvanceDisplacement(unsigned int displacement, track_location &track, flagwrapper<ADF> ad_flags = 0,
 		flagwrapper<ADRESULTF> *ad_result_flags = nullptr);
 unsigned int AdvanceDisplacement(unsigned int displacement, track_location &track, int *elevation_delta /*optional, out*/,
-		std::function<void(track_location & /*old*/, track_location & /*new*/)> func, flagwrapper<ADF> ad_flags = 0,
+		const std::function<void(track_location & /*old*/, track_location & /*new*/)> &func, flagwrapper<ADF> ad_flags = 0,
 		flagwrapper<ADRESULTF> *ad_result_flags = nullptr);
 
 enum class TSEF {
@@ -21,14 +21,19 @@
 
 #include <unordered_map>
 #include <deque>
-#include <forward_list>
+#include <functional>
+#include <queue>
 #include <set>
+#include <climits>
 #include "util/flags.h"
 #include "core/traction_type.h"
 #include "core/serialisable.h"
 #include "core/action.h"
 #include "core/future.h"
 #include "core/edge_type.h"
+#include "core/braking_profile_mode.h"
+#include "core/world_obj.h"
+#include "core/route_conflict.h"
 
 class world_deserialisation;
 class world_serialisation;
@@ -39,7 +44,11 @@ class track_circuit;
 class track_train_counter_block;
 class vehicle_class;
 class world;
+template <typename T> class vartrack_location;
+typedef vartrack_location<generic_track> track_location;
 class updatable_obj;
+class train_projection;
+struct train_step_context;
 
 struct connection_forward_declaration {
 	generic_track *track1;
@@ -55,6 +64,11 @@ enum class GAME_MODE {
 	CLIENT,
 };
 
+enum class TICK_UPDATE_MODE {
+	POLL,           ///< All tick update pieces are updated every tick
+	EVENT,          ///< Only tick update pieces which have been marked dirty are updated
+};
+
 enum class LOG_CATEGORY {
 	INVALID,
 	DENIED,
@@ -123,21 +137,86 @@ class track_train_counter_block_container {
 	}
 };
 
+// Owns all trains in a world.
+// Trains are heap allocated and never move, and are kept in creation order in a vector of owning pointers.
+// Deleting a train leaves a null slot, which is removed by the next Compact() call.
+// This keeps deletion O(1) and makes it safe to create or delete trains whilst enumerating.
+// Trains are enumerated newest first.
+class train_registry {
+	std::vector<std::unique_ptr<train> > slots;
+	std::unordered_map<std::string, train *> name_index;
+	std::unordered_map<train_id_type, train *> id_index;
+	train_id_type next_id = 0;
+	unsigned int count = 0;
+
+	public:
+	train_registry();
+	~train_registry();
+	train *Create(world &w);
+	void Delete(train *t);
+	bool Rename(train *t, const std::string &newname);
+	train *FindByName(const std::string &name) const;
+	train *FindById(train_id_type id) const;
+	void Compact();
+	unsigned int size() const { return count; }
+
+	// func may create or delete trains, trains created during the enumeration are not included
+	template <typename F> void Enumerate(F func) const {
+		for (size_t i = slots.size(); i-- > 0;) {
+			if (slots[i]) {
+				func(const_cast<const train &>(*slots[i]));
+			}
+		}
+	}
+
+	template <typename F> void Enumerate(F func) {
+		for (size_t i = slots.size(); i-- > 0;) {
+			if (slots[i]) {
+				func(*slots[i]);
+			}
+		}
+	}
+};
+
 class world : public serialisable_futurable_obj {
 	friend world_deserialisation;
 	friend world_serialisation;
-	std::unordered_map<std::string, std::unique_ptr<generic_track> > all_pieces;
+	std::vector<std::unique_ptr<generic_track> > all_pieces;    // indexed by track ID
+	std::unordered_map<std::string, track_id_type> track_name_index;
+	std::vector<const std::string *> track_id_names;    // indexed by track ID, points to the key in track_name_index
+	std::unordered_map<std::string, speed_class_id_type> speed_class_index;
+	std::vector<const std::string *> speed_class_names;    // indexed by speed class ID - 1, points to the key in speed_class_index
 	std::unordered_map<std::string, std::unique_ptr<vehicle_class> > all_vehicle_classes;
-	std::forward_list<train> all_trains;
+	train_registry all_trains;
 	std::deque<connection_forward_declaration> connection_forward_declarations;
 	std::unordered_map<std::string, traction_type> traction_types;
+	std::vector<traction_type *> traction_types_by_id;
+	traction_set always_available_tractions;
 	std::deque<generic_track *> tick_update_list;
+	std::vector<uint64_t> tick_update_dirty;    // bitmap, indexed by position in tick_update_list
+	TICK_UPDATE_MODE tick_update_mode = TICK_UPDATE_MODE::EVENT;
+	BRAKING_PROFILE_MODE braking_profile_mode = BRAKING_PROFILE_MODE::STRICT;
+	bool train_projections = false;
+	bool train_free_running = true;
+	std::vector<unsigned int> tick_update_worklist;
+	bool in_tick_updates = false;
+	typedef std::pair<world_time, unsigned int> tick_update_wakeup;    // time, position in tick_update_list
+	std::priority_queue<tick_update_wakeup, std::vector<tick_update_wakeup>, std::greater<tick_update_wakeup> > tick_update_wakeups;
+	std::vector<world_time> tick_update_wake_times;    // pending wake time, or 0 if none, indexed by position in tick_update_list
 	world_time gametime = 0;
 	GAME_MODE mode = GAME_MODE::SINGLE;
 	error_collection ec;
 	unsigned int auto_seq_item = 0;
 	uint64_t load_count = 0;    // incremented on each save/load cycle
 	uint64_t last_future_id = 0;
+	uint64_t routing_state_generation = 0;        // incremented when points or signal aspects change
+	uint64_t reservation_state_generation = 0;    // incremented when track reservations change
+	uint64_t train_step_routing_generation = 0;        // routing_state_generation when the trains were last stepped
+	uint64_t train_step_reservation_generation = 0;    // reservation_state_generation when the trains were last stepped
+	std::unique_ptr<train_step_context> train_step;
+
+	void ParallelTrainTimeStep(world_time delta);
+	void TickUpdates();
 
 	public:
 	enum class WFLAGS {
@@ -151,23 +230,41 @@ class world : public serialisable_futurable_obj {
 	public:
 	future_deserialisation_type_factory future_types;
 	action_deserialisation_type_factory action_types;
-	future_set futures;
 	fixup_list layout_init_final_fixups;
 	fixup_list post_layout_init_final_fixups;
 	track_train_counter_block_container<track_circuit> track_circuits;
 	track_train_counter_block_container<track_train_counter_block> track_triggers;
-	std::set<updatable_obj *> update_set;
+	future_set futures;    // must be declared after all futurable members, as pending futures deregister from their target when destroyed
+	route_conflict_matrix route_conflicts;
+	updatable_obj_set update_set;
 
 	world();
 	virtual ~world();
-	void AddTrack(std::unique_ptr<generic_track> &&piece, error_collection &ec);
+	// Returns the added piece, or nullptr if the name is already in use, in which case piece is deleted
+	generic_track *AddTrack(std::unique_ptr<generic_track> &&piece, error_collection &ec);
 	void AddTractionType(std::string name, bool always_available);
 	traction_type *GetTractionTypeByName(std::string name) const;
+	traction_type *GetTractionTypeById(traction_type_id_type id) const { return id < traction_types_by_id.size() ? traction_types_by_id[id] : nullptr; }
+	const traction_set &GetAlwaysAvailableTractionTypes() const { return always_available_tractions; }
 	void ConnectTrack(generic_track *track1, EDGE dir1, std::string name2, EDGE dir2, error_collection &ec);
 	void LayoutInit(error_collection &ec);
 	void PostLayoutInit(error_collection &ec);
 	generic_track *FindTrackByName(const std::string &name) const;
 
+	// Track IDs are allocated densely in the order in which pieces are defined
+	// Returns the ID of name, allocating a new ID if it has not been seen before
+	// This is only for defining pieces, use FindTrackId or FindTrackByName to look up names
+	track_id_type InternTrackName(const std::string &name);
+	track_id_type FindTrackId(const std::string &name) const;    // returns INVALID_TRACK_ID if not found
+	generic_track *GetTrackById(track_id_type id) const { return id < all_pieces.size() ? all_pieces[id].get() : nullptr; }
+	const std::string &GetTrackNameById(track_id_type id) const { return *track_id_names[id]; }
+	track_id_type GetTrackIdCount() const { return all_pieces.size(); }
+
+	// Speed class IDs are allocated densely in the order in which names are first seen, the empty speed class is always 0
+	speed_class_id_type InternSpeedClass(const std::string &name);
+	speed_class_id_type FindSpeedClassId(const std::string &name) const;    // returns INVALID_SPEED_CLASS_ID if not found
+	const std::string &GetSpeedClassNameById(speed_class_id_type id) const;
+
 	template <typename C> C *FindTrackByNameCast(const std::string &name) const {
 		return dynamic_cast<C*>(FindTrackByName(name));
 	}
@@ -186,9 +283,63 @@ class world : public serialisable_futurable_obj {
 	virtual text_pool &GetUserMessageTextpool();
 	virtual void LogUserMessageLocal(LOG_CATEGORY lc, const std::string &message);
 	virtual void GameStep(world_time delta);
+
+	// The world is quiescent if nothing can change until either the next future or tick update wakeup is due, or an action is submitted.
+	// This requires TICK_UPDATE_MODE::EVENT, as in poll mode it is not known which pieces might change.
+	bool IsQuiescent() const;
+
+	// Returns false if there is nothing pending
+	bool GetNextEventTime(world_time &next) const;
+
+	// Equivalent to calling GameStep(step) repeatedly until the game time reaches target, the last step may be shorter.
+	// Steps during which the world is quiescent are skipped instead of run. Returns the number of steps actually run.
+	unsigned int FastForward(world_time target, world_time step);
+
 	void RegisterTickUpdate(generic_track *targ);
 	void UnregisterTickUpdate(generic_track *targ);
 
+	// In TICK_UPDATE_MODE::EVENT, tick update pieces are only ticked when marked dirty
+	// TrackTick implementations clear their own dirty mark when they actually update, pieces which do not are ticked on every tick
+	void SetTickUpdateMode(TICK_UPDATE_MODE mode);
+	TICK_UPDATE_MODE GetTickUpdateMode() const { return tick_update_mode; }
+
+	void SetBrakingProfileMode(BRAKING_PROFILE_MODE mode) { braking_profile_mode = mode; }
+	BRAKING_PROFILE_MODE GetBrakingProfileMode() const { return braking_profile_mode; }
+
+	// When enabled, the arrival time projections of all trains are kept up to date in GameStep
+	void SetTrainProjectionsEnabled(bool enabled) { train_projections = enabled; }
+	bool AreTrainProjectionsEnabled() const { return train_projections; }
+	void UpdateTrainProjections();
+
+	// Brings the projection up to date if it is not already
+	const train_projection &GetTrainProjection(train &t);
+
+	// When enabled, trains skip checking their lookahead while nothing in it could limit their speed, see train_free_run_state
+	void SetTrainFreeRunningEnabled(bool enabled) { train_free_running = enabled; }
+	bool IsTrainFreeRunningEnabled() const { return train_free_running; }
+
+	inline void MarkTickUpdateDirty(unsigned int index) {
+		if (tick_update_mode == TICK_UPDATE_MODE::EVENT) {
+			uint64_t &word = tick_update_dirty[index / 64];
+			uint64_t bit = ((uint64_t) 1) << (index % 64);
+			if (!(word & bit)) {
+				word |= bit;
+				if (in_tick_updates) {
+					tick_update_worklist.push_back(index);
+				}
+			}
+		}
+	}
+
+	// Marks the piece dirty at the first tick at or after wake
+	// Only the earliest pending wake of each piece is kept
+	void SetTickUpdateWakeup(unsigned int index, world_time wake);
+	size_t GetTickUpdateWakeupCount() const { return tick_update_wakeups.size(); }
+
+	inline void ClearTickUpdateDirty(unsigned int index) {
+		tick_update_dirty[index / 64] &= ~(((uint64_t) 1) << (index % 64));
+	}
+
 	inline bool IsAuthoritative() const {
 		return mode == GAME_MODE::SINGLE || mode == GAME_MODE::SERVER;
 	}
@@ -198,7 +349,15 @@ class world : public serialisable_futurable_obj {
 	void CapAllTrackPieceUnconnectedEdges();
 	train *CreateEmptyTrain();
 	train *FindTrainByName(const std::string &name) const;
+	train *FindTrainById(train_id_type id) const;
 	void DeleteTrain(train *t);
+	bool RenameTrain(train *t, const std::string &newname);    // returns false if another train already has newname
+	unsigned int GetTrainCount() const { return all_trains.size(); }
+
+	// Returns the nearest train at or ahead of location, within max_distance (mm), or nullptr.
+	// If location is within a train, that train is returned with a distance of 0.
+	// The search follows the current points settings.
+	train *FindNearestTrainAhead(const track_location &location, unsigned int max_distance = UINT_MAX, unsigned int *distance = nullptr) const;
 	unsigned int EnumerateTrains(std::function<void(const train &)> f) const;
 
 	inline unsigned int EnumerateTrains(std::function<void(train &)> f) {
@@ -208,10 +367,18 @@ class world : public serialisable_futurable_obj {
 	vehicle_class *FindOrMakeVehicleClassByName(const std::string &name);
 	vehicle_class *FindVehicleClassByName(const std::string &name);
 	void MarkUpdated(updatable_obj *wo);
-	const std::set<updatable_obj *> &GetLastUpdateSet() const { return update_set; }
+	const updatable_obj_set &GetLastUpdateSet() const { return update_set; }
 
 	flagwrapper<WFLAGS> GetWFlags() const { return wflags; }
 
+	void RoutingStateChanged() { routing_state_generation++; }
+	uint64_t GetRoutingStateGeneration() const { return routing_state_generation; }
+	void ReservationStateChanged() { reservation_state_generation++; }
+
+	// Number of threads used to prepare train movement in GameStep, 1 (the default) disables multi-threaded stepping
+	void SetTrainStepThreadCount(unsigned int threads);
+	unsigned int GetTrainStepThreadCount() const;
+
 	uint64_t MakeNewFutureID() {
 		return ++last_future_id;
 	}
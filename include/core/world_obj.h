@@ -28,9 +28,19 @@
 #include "core/serialisable.h"
 
 class world;
+class updatable_obj_set;
+
+typedef unsigned int track_id_type;    // dense index of a track piece within its world
+const track_id_type INVALID_TRACK_ID = (track_id_type) -1;
+typedef unsigned int train_id_type;    // unique within a world for the lifetime of the world, not reused or serialised
+const train_id_type INVALID_TRAIN_ID = (train_id_type) -1;
+typedef unsigned int speed_class_id_type;    // dense index of a speed class name within its world, the empty class (all trains) is 0
+const speed_class_id_type INVALID_SPEED_CLASS_ID = (speed_class_id_type) -1;
 
 class updatable_obj {
 	std::vector<std::function<void(updatable_obj*, world &)> > update_functions;
+	uint64_t update_set_generation = 0;    // generation of the updatable_obj_set which this was last inserted into
+	friend updatable_obj_set;
 
 	public:
 	void AddUpdateHook(const std::function<void(updatable_obj*, world &)> &f);
@@ -38,6 +48,43 @@ class updatable_obj {
 	virtual void UpdateNotification(world &w);
 };
 
+//Set of objects, in insertion order
+//Insertion and lookup are O(1), by comparing the object's generation stamp with that of the set
+//Clearing the set starts a new generation, and keeps the allocation
+//An object can only be in one set at a time, this is fine as objects are only marked updated in their own world
+class updatable_obj_set {
+	std::vector<updatable_obj *> objs;
+	uint64_t generation;
+
+	static uint64_t NextGeneration();
+
+	public:
+	typedef std::vector<updatable_obj *>::const_iterator const_iterator;
+
+	updatable_obj_set() : generation(NextGeneration()) { }
+	updatable_obj_set(const updatable_obj_set &) = delete;
+	updatable_obj_set &operator=(const updatable_obj_set &) = delete;
+
+	bool insert(updatable_obj *obj) {
+		if (obj->update_set_generation == generation) {
+			return false;
+		}
+		obj->update_set_generation = generation;
+		objs.push_back(obj);
+		return true;
+	}
+	void clear() {
+		objs.clear();
+		generation = NextGeneration();
+	}
+	size_t count(const updatable_obj *obj) const { return obj->update_set_generation == generation ? 1 : 0; }
+	size_t size() const { return objs.size(); }
+	bool empty() const { return objs.empty(); }
+	updatable_obj *operator[](size_t index) const { return objs[index]; }
+	const_iterator begin() const { return objs.begin(); }
+	const_iterator end() const { return objs.end(); }
+};
+
 class world_obj : public serialisable_futurable_obj, public updatable_obj {
 	std::string name;
 	world &w;
@@ -22,6 +22,7 @@
 #include <map>
 #include <string>
 #include <deque>
+#include <forward_list>
 
 #include "util/flags.h"
 #include "core/world.h"
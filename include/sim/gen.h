@@ -0,0 +1,74 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2015 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#ifndef INC_SIM_GEN_ALREADY
+#define INC_SIM_GEN_ALREADY
+
+#include <string>
+#include <vector>
+
+namespace sim {
+
+	// Parameters for a procedurally generated layout.
+	// The layout is a single line of units, each unit consists of:
+	// * auto_signals automatic signal sections
+	// * an entry route signal, followed by facing points
+	// * a main line with a route signal, and a passing loop with a route signal
+	// * trailing points rejoining the main line
+	// Trains are dropped at the start of the units, one per unit, from the start of the line
+	struct layout_gen_params {
+		unsigned int units = 100;
+		unsigned int auto_signals = 4;
+		unsigned int trains = 50;
+	};
+
+	struct layout_gen_counts {
+		unsigned int track_segs = 0;
+		unsigned int points = 0;
+		unsigned int route_signals = 0;
+		unsigned int auto_signals = 0;
+		unsigned int routing_markers = 0;
+		unsigned int trains = 0;
+		unsigned int total_pieces = 0;
+	};
+
+	class layout_generator {
+		layout_gen_params params;
+		layout_gen_counts counts;
+		std::string content;
+		std::string game_state;
+
+		void AddItem(std::string &out, const std::string &item);
+		void AddTrackSeg(const std::string &name, const char *length, const std::string &extra = "");
+		void AddOverlap(const std::string &signal_name);
+
+		public:
+		layout_generator(const layout_gen_params &params_);
+		std::string GetJson() const;
+		const layout_gen_counts &GetCounts() const { return counts; }
+
+		// Text commands which set the main line routes from all route signals
+		std::vector<std::string> GetRouteSettingCommands() const;
+
+		// Number of units needed for approximately total_pieces track pieces, given the other parameters
+		static unsigned int UnitsForPieceCount(unsigned int total_pieces, unsigned int auto_signals);
+	};
+
+};
+
+#endif
@@ -0,0 +1,98 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2015 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#ifndef INC_SIM_SIM_ALREADY
+#define INC_SIM_SIM_ALREADY
+
+#include "common.h"
+#include "core/world.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class world_deserialisation;
+
+namespace sim {
+
+	//world without any GUI, user messages are either written to stdout or just counted
+	class sim_world : public world {
+		bool quiet = false;
+		uint64_t message_count = 0;
+
+		public:
+		void SetQuiet(bool q) { quiet = q; }
+		uint64_t GetMessageCount() const { return message_count; }
+		virtual void LogUserMessageLocal(LOG_CATEGORY lc, const std::string &message) override;
+	};
+
+	struct sim_result {
+		world_time start_time = 0;
+		world_time end_time = 0;
+		uint64_t steps = 0;
+		double wall_seconds = 0.0;
+
+		double GetSimSeconds() const { return (end_time - start_time) / 1000.0; }
+		double GetSimSecondsPerWallSecond() const;
+	};
+
+	// Steps w in increments of step_ms as fast as possible until duration_ms of game time have elapsed
+	// The final step is shortened if duration_ms is not a multiple of step_ms
+	// If fast_forward is set, steps during which nothing can change are skipped, see world::FastForward
+	sim_result RunSimulation(world &w, world_time duration_ms, world_time step_ms, bool fast_forward = false);
+
+	double GetWallTime();
+
+	struct mem_usage {
+		uint64_t current_kb = 0;
+		uint64_t peak_kb = 0;
+	};
+
+	// Returns zeroes where not supported
+	// The peak is the process high-water mark, it is not reset between phases
+	mem_usage GetMemUsage();
+
+	struct phase_result {
+		std::string name;
+		double wall_seconds;
+		mem_usage mem;          // sampled at the end of the phase
+		int64_t rss_delta_kb;   // change in resident set size over the phase
+	};
+
+	class phase_timer {
+		std::vector<phase_result> phases;
+
+		public:
+		template <typename F> void Run(const std::string &name, F func) {
+			mem_usage start_mem = GetMemUsage();
+			double start = GetWallTime();
+			func();
+			double end = GetWallTime();
+			mem_usage end_mem = GetMemUsage();
+			phases.push_back({ name, end - start, end_mem, static_cast<int64_t>(end_mem.current_kb) - static_cast<int64_t>(start_mem.current_kb) });
+		}
+		const std::vector<phase_result> &GetPhases() const { return phases; }
+		void Print(FILE *f) const;
+	};
+
+	// This is equivalent to world_deserialisation::LoadGameFromStrings, except that each phase is timed separately
+	// World::PostLayoutInit includes the signal track scans (generic_signal::PostLayoutInitTrackScan)
+	void LoadGamePhased(world_deserialisation &ws, world &w, const std::string &base, const std::string &save, error_collection &ec, phase_timer &pt);
+};
+
+#endif
@@ -0,0 +1,91 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2013 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#ifndef INC_RING_BUFFER_ALREADY
+#define INC_RING_BUFFER_ALREADY
+
+#include <vector>
+#include <cstddef>
+
+// Double-ended queue held in a single contiguous power of two sized array.
+// Elements are not destructed when popped, they are reset when they are next pushed.
+// Pushing may reallocate, which invalidates references to elements.
+template <typename T> class ring_buffer {
+	std::vector<T> items;
+	size_t head = 0;
+	size_t count = 0;
+
+	size_t Mask() const { return items.size() - 1; }
+
+	void Grow() {
+		std::vector<T> newitems(items.empty() ? 8 : items.size() * 2);
+		for (size_t i = 0; i < count; i++) {
+			newitems[i] = std::move(items[(head + i) & Mask()]);
+		}
+		items.swap(newitems);
+		head = 0;
+	}
+
+	public:
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T &operator[](size_t index) { return items[(head + index) & Mask()]; }
+	const T &operator[](size_t index) const { return items[(head + index) & Mask()]; }
+	T &front() { return (*this)[0]; }
+	const T &front() const { return (*this)[0]; }
+	T &back() { return (*this)[count - 1]; }
+	const T &back() const { return (*this)[count - 1]; }
+
+	T &emplace_back() {
+		if (count == items.size()) {
+			Grow();
+		}
+		count++;
+		T &item = back();
+		item = T();
+		return item;
+	}
+
+	void pop_front() {
+		head = (head + 1) & Mask();
+		count--;
+	}
+
+	void pop_front(size_t n) {
+		head = (head + n) & Mask();
+		count -= n;
+	}
+
+	void pop_back() {
+		count--;
+	}
+
+	void resize_down(size_t n) {
+		if (n < count) {
+			count = n;
+		}
+	}
+
+	void clear() {
+		head = 0;
+		count = 0;
+	}
+};
+
+#endif
@@ -47,6 +47,22 @@ template <typename I> I fast_isqrt( I n ){
 	return p;
 }
 
+//As fast_isqrt, but starting from an estimate of the result
+//The result is exact whatever the estimate, but is found in far fewer iterations when the estimate is close
+template <typename I> I seeded_isqrt(I n, I estimate) {
+	if (n == 0) {
+		return 0;
+	}
+
+	I r = estimate ? estimate : 1;
+	r = (r + n/r) / 2;    // r >= isqrt(n) after one iteration from any starting point
+
+	while (r > n/r) {
+		r = (r + n/r) / 2;
+	}
+	return r;
+}
+
 std::string string_format(const char *fmt, ...);
 std::string gr_strftime(const char *format, const struct tm *tm, time_t timestamp, bool localtime);
 unsigned int GetMilliTime();
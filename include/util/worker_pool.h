@@ -0,0 +1,57 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2015 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#ifndef INC_WORKER_POOL_ALREADY
+#define INC_WORKER_POOL_ALREADY
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads for running independent work items in parallel.
+// The calling thread also runs items, so a pool of size n creates n - 1 threads.
+class worker_pool {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable work_cv;
+	std::condition_variable done_cv;
+	const std::function<void(size_t)> *job = nullptr;
+	size_t job_count = 0;
+	std::atomic<size_t> next_index;
+	unsigned int busy_workers = 0;
+	uint64_t job_generation = 0;
+	bool shutdown = false;
+
+	void WorkerMain();
+	void RunItems(const std::function<void(size_t)> &func, size_t count);
+
+	public:
+	worker_pool(unsigned int thread_count);
+	~worker_pool();
+	unsigned int GetThreadCount() const { return threads.size() + 1; }
+
+	// Calls func(i) for each i in [0, count), returns when all calls have completed.
+	// No ordering between items is guaranteed.
+	void ParallelFor(size_t count, const std::function<void(size_t)> &func);
+};
+
+#endif
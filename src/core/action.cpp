@@ -62,6 +62,7 @@ void action::RegisterAllActionTypes(action_deserialisation_type_factory &factory
 	MakeActionTypeWrapper<action_points_auto_normalise>(factory);
 	MakeActionTypeWrapper<action_reserve_track>(factory);
 	MakeActionTypeWrapper<action_reserve_path>(factory);
+	MakeActionTypeWrapper<action_reserve_batch>(factory);
 	MakeActionTypeWrapper<action_unreserve_track_route>(factory);
 	MakeActionTypeWrapper<action_unreserve_track>(factory);
 	MakeActionTypeWrapper<action_approach_locking_timeout>(factory);
@@ -19,13 +19,14 @@
 #include "common.h"
 #include "core/future.h"
 #include "core/serialisable_impl.h"
+#include <algorithm>
 
 future::future(futurable_obj &targ, world_time ft, future_id_type id) : target(targ), trigger_time(ft), future_id(id) {
 	assert(id > 0);
 }
 
 future::~future() {
-
+	target.DeregisterFuture(this);
 }
 
 void future::Execute() {
@@ -42,75 +43,323 @@ void future::Serialise(serialiser_output &so, error_collection &ec) const {
 	SerialiseValueJson(GetTypeSerialisationName(), so, "ftype");
 }
 
+bool future_set::ExecutesBefore(const future &a, const future &b) {
+	if (a.GetTriggerTime() != b.GetTriggerTime()) {
+		return a.GetTriggerTime() < b.GetTriggerTime();
+	}
+	return a.fs_seq < b.fs_seq;
+}
+
+future_set::~future_set() {
+	for (auto &it : buckets) {
+		for (future *f = it.head; f;) {
+			future *next = f->fs_next;
+			f->registered_fs = 0;
+			f->fs_self.reset();
+			f = next;
+		}
+	}
+}
+
+void future_set::Insert(future *f) {
+	unsigned int index;
+	world_time ft = f->GetTriggerTime();
+	if (ft < wheel_time) {
+		index = OVERDUE_BUCKET;
+	} else {
+		//the level is that of the most significant bit which differs from wheel_time
+		world_time diff = ft ^ wheel_time;
+		unsigned int level = diff ? (sizeof(unsigned int) * 8 - 1 - __builtin_clz(diff)) / WHEEL_SLOT_BITS : 0;
+		unsigned int slot = (ft >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK;
+		index = (level * WHEEL_SLOTS) + slot;
+		occupied[level] |= ((uint64_t) 1) << slot;
+	}
+
+	bucket &b = buckets[index];
+	f->fs_bucket = index;
+	f->fs_next = 0;
+	f->fs_prev = b.tail;
+	if (b.tail) {
+		b.tail->fs_next = f;
+	} else {
+		b.head = f;
+	}
+	b.tail = f;
+}
+
+void future_set::Unlink(future *f) {
+	bucket &b = buckets[f->fs_bucket];
+	if (f->fs_prev) {
+		f->fs_prev->fs_next = f->fs_next;
+	} else {
+		b.head = f->fs_next;
+	}
+	if (f->fs_next) {
+		f->fs_next->fs_prev = f->fs_prev;
+	} else {
+		b.tail = f->fs_prev;
+	}
+	if (!b.head && f->fs_bucket != OVERDUE_BUCKET) {
+		occupied[f->fs_bucket / WHEEL_SLOTS] &= ~(((uint64_t) 1) << (f->fs_bucket % WHEEL_SLOTS));
+	}
+	f->fs_prev = f->fs_next = 0;
+}
+
+//Moves all futures in a bucket to out, the futures are no longer registered in the set
+void future_set::TakeBucket(unsigned int index, std::vector<std::shared_ptr<future> > &out) {
+	bucket &b = buckets[index];
+	for (future *f = b.head; f;) {
+		future *next = f->fs_next;
+		f->fs_prev = f->fs_next = 0;
+		f->registered_fs = 0;
+		out.emplace_back(std::move(f->fs_self));
+		count--;
+		f = next;
+	}
+	b.head = b.tail = 0;
+	if (index != OVERDUE_BUCKET) {
+		occupied[index / WHEEL_SLOTS] &= ~(((uint64_t) 1) << (index % WHEEL_SLOTS));
+	}
+}
+
+//Moves all futures with a trigger time <= ft to out, in no particular order, and advances wheel_time to ft
+void future_set::AdvanceTo(world_time ft, std::vector<std::shared_ptr<future> > &out) {
+	if (ft < wheel_time) {
+		//only overdue futures can be due
+		for (future *f = buckets[OVERDUE_BUCKET].head; f;) {
+			future *next = f->fs_next;
+			if (f->GetTriggerTime() <= ft) {
+				Unlink(f);
+				f->registered_fs = 0;
+				out.emplace_back(std::move(f->fs_self));
+				count--;
+			}
+			f = next;
+		}
+		return;
+	}
+
+	TakeBucket(OVERDUE_BUCKET, out);
+
+	while (true) {
+		//level 0 buckets each contain futures with a single trigger time
+		bool same_block = (ft >> WHEEL_SLOT_BITS) == (wheel_time >> WHEEL_SLOT_BITS);
+		unsigned int first = wheel_time & WHEEL_SLOT_MASK;
+		unsigned int last = same_block ? (ft & WHEEL_SLOT_MASK) : (unsigned int) WHEEL_SLOT_MASK;
+		uint64_t due = occupied[0] & (~((uint64_t) 0) << first);
+		if (last < WHEEL_SLOT_MASK) {
+			due &= (((uint64_t) 1) << (last + 1)) - 1;
+		}
+		while (due) {
+			TakeBucket(__builtin_ctzll(due), out);
+			due &= due - 1;
+		}
+		if (same_block) {
+			wheel_time = ft;
+			return;
+		}
+
+		//find the earliest non-empty bucket in the higher levels, this is always after the current slot of that level
+		unsigned int level = 1;
+		uint64_t pending = 0;
+		for (; level < WHEEL_LEVELS; level++) {
+			unsigned int current_slot = (((uint64_t) wheel_time) >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK;
+			pending = occupied[level] & ((~((uint64_t) 0) << current_slot) << 1);
+			if (pending) {
+				break;
+			}
+		}
+		if (!pending) {
+			wheel_time = ft;
+			return;
+		}
+
+		unsigned int slot = __builtin_ctzll(pending);
+		unsigned int shift = level * WHEEL_SLOT_BITS;
+		uint64_t upper_mask = ~((((uint64_t) 1) << (shift + WHEEL_SLOT_BITS)) - 1);
+		uint64_t bucket_start = (((uint64_t) wheel_time) & upper_mask) | (((uint64_t) slot) << shift);
+		if (bucket_start > ft) {
+			wheel_time = ft;
+			return;
+		}
+
+		//cascade the bucket into the lower levels
+		wheel_time = bucket_start;
+		bucket &b = buckets[(level * WHEEL_SLOTS) + slot];
+		future *f = b.head;
+		b.head = b.tail = 0;
+		occupied[level] &= ~(((uint64_t) 1) << slot);
+		while (f) {
+			future *next = f->fs_next;
+			Insert(f);
+			f = next;
+		}
+	}
+}
+
+bool future_set::GetNextTriggerTime(world_time &ft) const {
+	if (!count) {
+		return false;
+	}
+
+	auto bucket_min = [&](unsigned int index) {
+		const future *f = buckets[index].head;
+		world_time min = f->GetTriggerTime();
+		for (f = f->fs_next; f; f = f->fs_next) {
+			if (f->GetTriggerTime() < min) {
+				min = f->GetTriggerTime();
+			}
+		}
+		return min;
+	};
+
+	if (buckets[OVERDUE_BUCKET].head) {
+		ft = bucket_min(OVERDUE_BUCKET);
+		return true;
+	}
+
+	//buckets are ordered by level, and then by slot, from the current slot of that level
+	uint64_t pending = occupied[0] & (~((uint64_t) 0) << (wheel_time & WHEEL_SLOT_MASK));
+	if (pending) {
+		ft = bucket_min(__builtin_ctzll(pending));
+		return true;
+	}
+	for (unsigned int level = 1; level < WHEEL_LEVELS; level++) {
+		unsigned int current_slot = (((uint64_t) wheel_time) >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK;
+		pending = occupied[level] & ((~((uint64_t) 0) << current_slot) << 1);
+		if (pending) {
+			ft = bucket_min((level * WHEEL_SLOTS) + __builtin_ctzll(pending));
+			return true;
+		}
+	}
+	return false;
+}
+
 void future_set::RegisterFuture(const std::shared_ptr<future> &f) {
-	futures.insert(std::make_pair(f->GetTriggerTime(), f));
+	assert(!f->registered_fs);
+	f->registered_fs = this;
+	f->fs_self = f;
+	f->fs_seq = next_seq++;
+	Insert(f.get());
+	count++;
 	f->GetTarget().RegisterFuture(f.get());
 }
 
 void future_set::RemoveFuture(future &f) {
 	f.GetTarget().DeregisterFuture(&f);
-	auto range = futures.equal_range(f.GetTriggerTime());
-	for (auto it = range.first; it != range.second; ) {
-		auto current = it;
-		++it;
-		//this is so that *current can be erased without invalidating *it
-
-		if (current->second.get() == &f)
-			futures.erase(current);
+	if (f.registered_fs == this) {
+		Unlink(&f);
+		f.registered_fs = 0;
+		count--;
+		std::shared_ptr<future> self = std::move(f.fs_self);
+		//f may be deleted when self goes out of scope
 	}
 }
 
 void future_set::ExecuteUpTo(world_time ft) {
-	auto past_end = futures.upper_bound(ft);
 	std::vector<std::shared_ptr<future> > current_execs;
-	for (auto it = futures.begin(); it != past_end; ++it) {
-		current_execs.emplace_back(std::move(it->second));
+	current_execs.swap(exec_buffer);    // re-use the allocation from the last call
+
+	if (count) {
+		AdvanceTo(ft, current_execs);
+	} else if (ft > wheel_time) {
+		wheel_time = ft;
+	}
+
+	if (current_execs.size() > 1) {
+		std::sort(current_execs.begin(), current_execs.end(), [](const std::shared_ptr<future> &a, const std::shared_ptr<future> &b) {
+			return ExecutesBefore(*a, *b);
+		});
 	}
-	futures.erase(futures.begin(), past_end);
 
 	//do it this way as futures could themselves insert items into the future set
 	for (auto &it : current_execs) {
 		it->Execute();
 		it->GetTarget().DeregisterFuture(it.get());
 	}
+
+	current_execs.clear();
+	exec_buffer.swap(current_execs);
 }
 
 void future_set::EnumerateRegisteredFutures(std::function<void(world_time, const std::shared_ptr<future> &)> func) const {
-	for (auto &it : futures) {
-		func(it.first, it.second);
+	std::vector<const future *> all;
+	all.reserve(count);
+	for (auto &it : buckets) {
+		for (const future *f = it.head; f; f = f->fs_next) {
+			all.push_back(f);
+		}
+	}
+	std::sort(all.begin(), all.end(), [](const future *a, const future *b) {
+		return ExecutesBefore(*a, *b);
+	});
+	for (auto &it : all) {
+		func(it->GetTriggerTime(), it->fs_self);
 	}
 }
 
 void futurable_obj::RegisterFuture(future *f) {
-	own_futures.emplace_back(f);
+	if (f->fo_linked) {
+		return;
+	}
+	f->fo_linked = true;
+	f->fo_next = 0;
+	f->fo_prev = futures_tail;
+	if (futures_tail) {
+		futures_tail->fo_next = f;
+	} else {
+		futures_head = f;
+	}
+	futures_tail = f;
 }
 
 void futurable_obj::DeregisterFuture(future *f) {
-	own_futures.remove_if([&](const future *upf) { return upf == f; });
+	if (!f->fo_linked) {
+		return;
+	}
+	if (f->fo_prev) {
+		f->fo_prev->fo_next = f->fo_next;
+	} else {
+		futures_head = f->fo_next;
+	}
+	if (f->fo_next) {
+		f->fo_next->fo_prev = f->fo_prev;
+	} else {
+		futures_tail = f->fo_prev;
+	}
+	f->fo_prev = f->fo_next = 0;
+	f->fo_linked = false;
 }
 
 void futurable_obj::ClearFutures() {
-	own_futures.clear();
+	for (future *f = futures_head; f;) {
+		future *next = f->fo_next;
+		f->fo_prev = f->fo_next = 0;
+		f->fo_linked = false;
+		f = next;
+	}
+	futures_head = futures_tail = 0;
 }
 
+//The next future is fetched before calling f, such that f may deregister (and delete) the current future
 void futurable_obj::EnumerateFutures(std::function<void (future &)> f) {
-	for (auto it = own_futures.begin(); it != own_futures.end();) {
-		auto current = it;
-		++it;
-		f(**current);
+	for (future *it = futures_head; it;) {
+		future *current = it;
+		it = it->fo_next;
+		f(*current);
 	}
 }
 
 void futurable_obj::EnumerateFutures(std::function<void (const future &)> f) const {
-	for (auto it = own_futures.begin(); it != own_futures.end();) {
-		auto current = it;
-		++it;
-		f(**current);
+	for (const future *it = futures_head; it;) {
+		const future *current = it;
+		it = it->fo_next;
+		f(*current);
 	}
 }
 
 bool futurable_obj::HaveFutures() const {
-	return !own_futures.empty();
+	return futures_head != nullptr;
 }
 
 void serialisable_futurable_obj::DeserialiseFutures(const deserialiser_input &di, error_collection &ec,
@@ -23,33 +23,83 @@
 #include "core/train.h"
 #include "core/serialisable_impl.h"
 #include <climits>
+#include <utility>
 
 void lookahead::Init(const train *t /* optional */, const track_location &pos, const route *rt) {
+	SaveListsForUndo();
 	l1_list.clear();
+	l2_list.clear();
 	current_offset = ((uint64_t) 1) << 32;
 	ScanAppend(t, pos, 1, rt);
 }
 
 void lookahead::Advance(unsigned int distance) {
 	current_offset += distance;
-	for (auto it = l1_list.begin(); it != l1_list.end();) {
-		if (current_offset > it->offset) {
-			l1_list.pop_front();
-			it = l1_list.begin();
-		} else {
-			for (auto jt = it->l2_list.begin(); jt != it->l2_list.end();) {
-				if (current_offset > jt->end_offset) {
-					it->l2_list.pop_front();
-					jt = it->l2_list.begin();
-				} else {
-					++jt;
-				}
-			}
-			++it;
+	if (undo && !l1_list.empty() && (current_offset > l1_list.front().offset || (l1_list.front().l2_count && current_offset > l2_list.front().end_offset))) {
+		SaveListsForUndo();
+	}
+	while (!l1_list.empty() && current_offset > l1_list.front().offset) {
+		l2_list.pop_front(l1_list.front().l2_count);
+		l1_list.pop_front();
+	}
+	if (!l1_list.empty()) {
+		lookahead_routing_point &l1 = l1_list.front();
+		while (l1.l2_count && current_offset > l2_list.front().end_offset) {
+			l2_list.pop_front();
+			l1.l2_count--;
 		}
 	}
 }
 
+void lookahead::StartUndoRecording(undo_state &state) {
+	state.current_offset = current_offset;
+	state.scan_count = scan_count;
+	state.lists_saved = false;
+	undo = &state;
+}
+
+void lookahead::Undo(undo_state &state) {
+	current_offset = state.current_offset;
+	scan_count = state.scan_count;
+	if (state.lists_saved) {
+		std::swap(l1_list, state.l1_list);
+		std::swap(l2_list, state.l2_list);
+		state.lists_saved = false;
+	}
+	undo = nullptr;
+}
+
+// This must be called before modifying l1_list or l2_list, or any of their items
+void lookahead::SaveListsForUndo() {
+	if (undo && !undo->lists_saved) {
+		undo->l1_list = l1_list;
+		undo->l2_list = l2_list;
+		undo->lists_saved = true;
+	}
+}
+
+// Remove all routing points after the first l1_count, and their items
+void lookahead::TruncateL1(size_t l1_count) {
+	SaveListsForUndo();
+	size_t l2_count = l2_list.size();
+	for (size_t i = l1_count; i < l1_list.size(); i++) {
+		l2_count -= l1_list[i].l2_count;
+	}
+	l1_list.resize_down(l1_count);
+	l2_list.resize_down(l2_count);
+}
+
+// Remove the item at index l2_index in l2_list and all items after it, l2_index must be an item of the routing point at l1_index
+// The routing point at l1_index is kept, but is no longer valid until it has been rescanned
+void lookahead::TruncateL2(size_t l1_index, size_t l2_index) {
+	TruncateL1(l1_index + 1);
+	lookahead_routing_point &l1 = l1_list.back();
+	l1.l2_count -= l2_list.size() - l2_index;
+	l2_list.resize_down(l2_index);
+	l1.gs.Reset();
+	l1.rt = nullptr;
+}
+
 void lookahead::CheckLookaheads(const train *t /* optional */, const track_location &pos,
 		std::function<void(unsigned int distance, unsigned int speed)> f, std::function<void(LA_ERROR err, const track_target_ptr &piece)> errfunc) {
 	unsigned int last_distance = UINT_MAX;
@@ -65,96 +115,234 @@ void lookahead::CheckLookaheads(const train *t /* optional */, const track_locat
 		}
 	};
 
-	for (auto it = l1_list.begin(); it != l1_list.end(); ++it) {
-		for (auto jt = it->l2_list.begin(); jt != it->l2_list.end(); ++jt) {
-			if (current_offset >= jt->start_offset && current_offset <= jt->end_offset) {
-				sendresponse(0, jt->speed);
-				if (jt->flags & lookahead_item::LAI_FLAGS::TRACTION_UNSUITABLE) {
-					errfunc(LA_ERROR::TRACTION_UNSUITABLE, jt->piece);
+	//ScanAppend may reallocate l1_list and l2_list, so iterate by index and do not hold references across calls to it
+	size_t l2_start = 0;
+	for (size_t i = 0; i < l1_list.size(); l2_start += l1_list[i].l2_count, i++) {
+		for (size_t j = l2_start; j < l2_start + l1_list[i].l2_count; j++) {
+			lookahead_item &l2 = l2_list[j];
+			if (current_offset >= l2.start_offset && current_offset <= l2.end_offset) {
+				sendresponse(0, l2.speed);
+				if (l2.flags & lookahead_item::LAI_FLAGS::TRACTION_UNSUITABLE) {
+					errfunc(LA_ERROR::TRACTION_UNSUITABLE, l2.piece);
 				}
-			} else if (current_offset < jt->start_offset) {
-				if (current_offset < jt->sighting_offset && jt->flags & lookahead_item::LAI_FLAGS::HALT_UNLESS_VISIBLE) {
-					sendresponse(jt->start_offset - current_offset, 0);
-				} else if (jt->flags & lookahead_item::LAI_FLAGS::NOT_ALWAYS_PASSABLE && current_offset >= jt->sighting_offset) {
-					if (jt->flags & lookahead_item::LAI_FLAGS::ALLOW_DIFFERENT_CONNECTION_INDEX &&
-							jt->connection_index != jt->piece.track->GetCurrentNominalConnectionIndex(jt->piece.direction)) {
-						//points have moved, rescan
-						Init(t, pos, 0);
-						CheckLookaheads(t, pos, f, errfunc);
-						return;
+			} else if (current_offset < l2.start_offset) {
+				if (current_offset < l2.sighting_offset && l2.flags & lookahead_item::LAI_FLAGS::HALT_UNLESS_VISIBLE) {
+					sendresponse(l2.start_offset - current_offset, 0);
+				} else if (l2.flags & lookahead_item::LAI_FLAGS::NOT_ALWAYS_PASSABLE && current_offset >= l2.sighting_offset) {
+					if (l2.flags & lookahead_item::LAI_FLAGS::ALLOW_DIFFERENT_CONNECTION_INDEX &&
+							l2.connection_index != l2.piece.track->GetCurrentNominalConnectionIndex(l2.piece.direction)) {
+						//points have moved, everything from here onwards is invalid
+						//rescan from the points and check this item again
+						track_target_ptr piece = l2.piece;
+						uint64_t offset = l2.start_offset;
+						TruncateL2(i, j);
+						scan_count++;
+						ScanUnrouted(t, piece, offset, 1);
+						j--;
+						continue;
 					}
-					if (jt->piece.track->IsTrackPassable(jt->piece.direction, jt->connection_index)) {
-						if (jt->flags & lookahead_item::LAI_FLAGS::SCAN_BEYOND_IF_PASSABLE) {
-							ScanAppend(t, track_location(jt->piece.track->GetConnectingPiece(jt->piece.direction)), 1, 0);
-							jt->flags &= ~lookahead_item::LAI_FLAGS::SCAN_BEYOND_IF_PASSABLE;
+					if (l2.piece.track->IsTrackPassable(l2.piece.direction, l2.connection_index)) {
+						unsigned int distance = l2.start_offset - current_offset;
+						unsigned int speed = l2.speed;
+						if (l2.flags & lookahead_item::LAI_FLAGS::SCAN_BEYOND_IF_PASSABLE) {
+							SaveListsForUndo();
+							l2.flags &= ~lookahead_item::LAI_FLAGS::SCAN_BEYOND_IF_PASSABLE;
+							ScanAppend(t, track_location(l2.piece.track->GetConnectingPiece(l2.piece.direction)), 1, 0);
 						}
-						sendresponse(jt->start_offset - current_offset, jt->speed);
+						sendresponse(distance, speed);
 					} else {
 						//track not passable, stop
-						sendresponse(jt->start_offset - current_offset, 0);
+						sendresponse(l2.start_offset - current_offset, 0);
 					}
 				} else {
-					sendresponse(jt->start_offset - current_offset, jt->speed);
+					sendresponse(l2.start_offset - current_offset, l2.speed);
 				}
 			}
 		}
-		if (current_offset > it->offset) {
+		if (current_offset > l1_list[i].offset) {
 			return;
 		}
-		if (current_offset >= it->sighting_offset && it->gs.IsValid()) {
+		if (current_offset >= l1_list[i].sighting_offset && l1_list[i].gs.IsValid()) {
 			//can see signal
+			lookahead_routing_point &l1 = l1_list[i];
 			bool reinit = false;
-			unsigned int aspect = it->gs.track->GetAspect();
-			if (it->last_aspect > 0 && it->gs.track->GetAspectNextTarget() != std::next(it)->gs.track) {
+			unsigned int aspect = l1.gs.track->GetAspect();
+			if (l1.last_aspect > 0 && i + 1 < l1_list.size() && l1.gs.track->GetAspectNextTarget() != l1_list[i + 1].gs.track) {
 				//signal now points somewhere else
 				//this is bad
-				errfunc(LA_ERROR::SIG_TARGET_CHANGE, it->gs);
+				errfunc(LA_ERROR::SIG_TARGET_CHANGE, l1.gs);
 				reinit = true;
 			}
-			if (aspect < it->last_aspect) {
+			if (aspect < l1.last_aspect) {
 				//adverse change of aspect
 				//this is also bad
-				errfunc(LA_ERROR::SIG_ASPECT_LESS_THAN_EXPECTED, it->gs);
+				errfunc(LA_ERROR::SIG_ASPECT_LESS_THAN_EXPECTED, l1.gs);
 				reinit = true;
 			}
 			if (reinit) {
-				while (std::next(it) != l1_list.end())
-					l1_list.pop_back();
-				const route *rt = nullptr;
-				generic_signal *gs = FastSignalCast(l1_list.back().gs.track, l1_list.back().gs.direction);
-				if (gs) {
-					rt = gs->GetCurrentForwardRoute();
+				SaveListsForUndo();
+				l1.last_aspect = aspect;
+				unsigned int blocklimit = aspect;
+				TruncateL1(KeepValidBlocks(i, blocklimit) + 1);
+				if (blocklimit || !aspect) {
+					const route *rt = nullptr;
+					generic_signal *gs = FastSignalCast(l1_list.back().gs.track, l1_list.back().gs.direction);
+					if (gs) {
+						rt = gs->GetCurrentForwardRoute();
+					}
+					ScanAppend(t, track_location(l1_list.back().gs), blocklimit, rt);
 				}
-				ScanAppend(t, track_location(l1_list.back().gs), aspect, rt);
-			} else if (aspect > it->last_aspect) {
+			} else if (aspect > l1.last_aspect) {
 				//need to extend lookahead
-				for (auto jt = std::next(it); jt != l1_list.end(); ++jt) {
-					if (jt->gs.IsValid()) {
-						jt->last_aspect = jt->gs.track->GetAspect();
+				SaveListsForUndo();
+				for (size_t j = i + 1; j < l1_list.size(); j++) {
+					if (l1_list[j].gs.IsValid()) {
+						l1_list[j].last_aspect = l1_list[j].gs.track->GetAspect();
 					}
 				}
+				unsigned int extend = aspect - l1.last_aspect;
+				l1.last_aspect = aspect;
 				const route *rt = nullptr;
 				generic_signal *gs = FastSignalCast(l1_list.back().gs.track, l1_list.back().gs.direction);
 				if (gs) {
 					rt = gs->GetCurrentForwardRoute();
 				}
-				ScanAppend(t, track_location(l1_list.back().gs), aspect - it->last_aspect, rt);
-				it->last_aspect = aspect;
+				ScanAppend(t, track_location(l1_list.back().gs), extend, rt);
 			}
 			if (aspect == 0) {
-				unsigned int distance = it->offset - current_offset;
+				unsigned int distance = l1_list[i].offset - current_offset;
 				sendresponse(distance, 0);
 				if (distance == 0) {
-					errfunc(LA_ERROR::WAITING_AT_RED_SIG, it->gs);
+					errfunc(LA_ERROR::WAITING_AT_RED_SIG, l1_list[i].gs);
 				}
 			}
-		} else if (it->gs.IsValid() && it->last_aspect == 0) {
-			sendresponse(it->offset - current_offset, 0);
+		} else if (l1_list[i].gs.IsValid() && l1_list[i].last_aspect == 0) {
+			sendresponse(l1_list[i].offset - current_offset, 0);
 		}
 	}
 }
 
+uint64_t lookahead::GetNextSightingOffset() const {
+	uint64_t next = UINT64_MAX;
+	size_t l2_start = 0;
+	for (size_t i = 0; i < l1_list.size(); l2_start += l1_list[i].l2_count, i++) {
+		for (size_t j = l2_start; j < l2_start + l1_list[i].l2_count; j++) {
+			const lookahead_item &l2 = l2_list[j];
+			if (current_offset < l2.sighting_offset && l2.sighting_offset < next &&
+					l2.flags & (lookahead_item::LAI_FLAGS::NOT_ALWAYS_PASSABLE | lookahead_item::LAI_FLAGS::HALT_UNLESS_VISIBLE)) {
+				next = l2.sighting_offset;
+			}
+		}
+		const lookahead_routing_point &l1 = l1_list[i];
+		if (l1.gs.IsValid() && current_offset < l1.sighting_offset && l1.sighting_offset < next) {
+			next = l1.sighting_offset;
+		}
+	}
+	return next;
+}
+
+// This follows the checks in CheckLookaheads, without modifying anything
+bool lookahead::IsSightedRoutingUnchanged() const {
+	size_t l2_start = 0;
+	for (size_t i = 0; i < l1_list.size(); l2_start += l1_list[i].l2_count, i++) {
+		for (size_t j = l2_start; j < l2_start + l1_list[i].l2_count; j++) {
+			const lookahead_item &l2 = l2_list[j];
+			if (current_offset < l2.start_offset && current_offset >= l2.sighting_offset &&
+					l2.flags & lookahead_item::LAI_FLAGS::NOT_ALWAYS_PASSABLE) {
+				if (l2.flags & lookahead_item::LAI_FLAGS::ALLOW_DIFFERENT_CONNECTION_INDEX &&
+						l2.connection_index != l2.piece.track->GetCurrentNominalConnectionIndex(l2.piece.direction)) {
+					return false;
+				}
+				if (l2.flags & lookahead_item::LAI_FLAGS::SCAN_BEYOND_IF_PASSABLE ||
+						!l2.piece.track->IsTrackPassable(l2.piece.direction, l2.connection_index)) {
+					return false;
+				}
+			}
+		}
+		const lookahead_routing_point &l1 = l1_list[i];
+		if (current_offset > l1.offset) {
+			return true;
+		}
+		if (current_offset >= l1.sighting_offset && l1.gs.IsValid()) {
+			if (l1.gs.track->GetAspect() != l1.last_aspect) {
+				return false;
+			}
+			if (l1.last_aspect > 0 && i + 1 < l1_list.size() && l1.gs.track->GetAspectNextTarget() != l1_list[i + 1].gs.track) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// After an adverse change at the signal at l1_index, find how many of the following blocks are still valid.
+// A block is still valid if the preceding signal still has the same route set as when the block was scanned.
+// Blocks which were not scanned along a single route are always rescanned.
+// Valid blocks are kept instead of being rescanned, and have their aspect limits reduced to match blocklimit.
+// Returns the index of the last block to keep, blocklimit is reduced by the number of blocks kept after l1_index.
+size_t lookahead::KeepValidBlocks(size_t l1_index, unsigned int &blocklimit) {
+	size_t last = l1_index;
+	while (blocklimit && last + 1 < l1_list.size()) {
+		const lookahead_routing_point &current = l1_list[last];
+		const lookahead_routing_point &next = l1_list[last + 1];
+		if (!current.gs.IsValid() || !next.gs.IsValid()) {
+			break;
+		}
+		generic_signal *gs = FastSignalCast(current.gs.track, current.gs.direction);
+		if (!gs || !next.rt || gs->GetCurrentForwardRoute() != next.rt) {
+			break;
+		}
+		last++;
+		blocklimit--;
+		l1_list[last].last_aspect = std::min(blocklimit, l1_list[last].gs.track->GetAspect());
+	}
+	return last;
+}
+
+void lookahead::SetRoutingPoint(const vartrack_target_ptr<routing_point> &sig, uint64_t offset, unsigned int &blocklimit) {
+	lookahead_routing_point &l = l1_list.back();
+	l.offset = offset;
+	l.gs = sig;
+	l.sighting_offset = offset - sig.track->GetSightingDistance(sig.direction);
+	blocklimit--;
+	l.last_aspect = std::min(blocklimit, sig.track->GetAspect());
+}
+
+lookahead::lookahead_item &lookahead::AddPiece(const train *t /* optional */, const track_target_ptr &piece, unsigned int connection_index, uint64_t &offset) {
+	lookahead_item &l2 = l2_list.emplace_back();
+	l1_list.back().l2_count++;
+	l2.connection_index = connection_index;
+	l2.start_offset = offset;
+	l2.sighting_offset = offset - piece.track->GetSightingDistance(piece.direction);
+	offset += piece.track->GetLength(piece.direction);
+	l2.end_offset = offset;
+	l2.piece = piece;
+
+	if (t) {
+		const traction_set *ts = piece.track->GetTractionTypes();
+		if (ts && !ts->CanTrainPass(t)) {
+			l2.speed = 0;
+			l2.flags |= lookahead_item::LAI_FLAGS::TRACTION_UNSUITABLE;
+			return l2;
+		}
+	}
+
+	const speed_restriction_set *srs = piece.track->GetSpeedRestrictions();
+	if (srs) {
+		l2.speed = srs->GetTrainTrackSpeedLimit(t);
+	} else {
+		l2.speed = UINT_MAX;
+	}
+	if (!piece.track->IsTrackAlwaysPassable()) {
+		l2.flags |= lookahead_item::LAI_FLAGS::NOT_ALWAYS_PASSABLE;
+	}
+	return l2;
+}
+
 void lookahead::ScanAppend(const train *t /* optional */, const track_location &pos, unsigned int blocklimit, const route *rt) {
+	SaveListsForUndo();
+	scan_count++;
+
 	uint64_t offset;
 	if (! l1_list.empty()) {
 		offset = l1_list.back().offset;
@@ -163,47 +351,10 @@ void lookahead::ScanAppend(const train *t /* optional */, const track_location &
 	}
 
 	l1_list.emplace_back();
-	lookahead_routing_point *l = &l1_list.back();
-	auto newsignal = [&](const vartrack_target_ptr<routing_point> &sig) {
-		l->offset = offset;
-		l->gs = sig;
-		l->sighting_offset = offset - sig.track->GetSightingDistance(sig.direction);
-		blocklimit--;
-		l->last_aspect = std::min(blocklimit, sig.track->GetAspect());
-	};
-	auto newpiece = [&](const track_target_ptr &piece, unsigned int connection_index) {
-		l->l2_list.emplace_back();
-		lookahead_item &l2 = l->l2_list.back();
-		l2.connection_index = connection_index;
-		l2.start_offset = offset;
-		l2.sighting_offset = offset - piece.track->GetSightingDistance(piece.direction);
-		offset += piece.track->GetLength(piece.direction);
-		l2.end_offset = offset;
-		l2.piece = piece;
-
-		if (t) {
-			const traction_set *ts = piece.track->GetTractionTypes();
-			if (ts && !ts->CanTrainPass(t)) {
-				l2.speed = 0;
-				l2.flags |= lookahead_item::LAI_FLAGS::TRACTION_UNSUITABLE;
-				return;
-			}
-		}
-
-		const speed_restriction_set *srs = piece.track->GetSpeedRestrictions();
-		if (srs) {
-			l2.speed = srs->GetTrainTrackSpeedLimit(t);
-		} else {
-			l2.speed = UINT_MAX;
-		}
-		if (!piece.track->IsTrackAlwaysPassable()) {
-			l2.flags |= lookahead_item::LAI_FLAGS::NOT_ALWAYS_PASSABLE;
-		}
-	};
 	if (rt) {
 		if (t && !rt->IsRouteTractionSuitable(t)) {
-			l->l2_list.emplace_back();
-			lookahead_item &l2 = l->l2_list.back();
+			lookahead_item &l2 = l2_list.emplace_back();
+			l1_list.back().l2_count++;
 			l2.start_offset = offset;
 			l2.end_offset = offset;
 			l2.sighting_offset = 0;
@@ -224,18 +375,18 @@ void lookahead::ScanAppend(const train *t /* optional */, const track_location &
 		for (;it != rt->pieces.end(); ++it) {
 			generic_signal *gs = FastSignalCast(it->location.track, it->location.direction);
 			if (gs) {
-				newsignal(vartrack_target_ptr<routing_point>(gs, it->location.direction));
+				SetRoutingPoint(vartrack_target_ptr<routing_point>(gs, it->location.direction), offset, blocklimit);
 				if (blocklimit) {
 					l1_list.emplace_back();
-					l = &l1_list.back();
 				} else {
 					return;
 				}
 			} else {
-				newpiece(it->location, it->connection_index);
+				AddPiece(t, it->location, it->connection_index, offset);
 			}
 		}
-		newsignal(rt->end);
+		SetRoutingPoint(rt->end, offset, blocklimit);
+		l1_list.back().rt = rt;
 		if (blocklimit) {
 			const route *next_rt = nullptr;
 			generic_signal *gs = FastSignalCast(rt->end.track, rt->end.direction);
@@ -246,61 +397,69 @@ void lookahead::ScanAppend(const train *t /* optional */, const track_location &
 		}
 	} else {
 		offset -= pos.GetTrack()->GetLength(pos.GetDirection()) - pos.GetTrack()->GetRemainingLength(pos.GetDirection(), pos.GetOffset());
-		track_target_ptr current(pos.GetTrack(), pos.GetDirection());
-		while (true) {
-			generic_signal *gs = FastSignalCast(current.track, current.direction);
-			if (gs) {
-				newsignal(vartrack_target_ptr<routing_point>(gs, current.direction));
-				l->last_aspect = 0;
-				return;
-			}
-			if (!current.track->IsTrackAlwaysPassable()) {
-				unsigned int connection_index = current.track->GetCurrentNominalConnectionIndex(current.direction);
-				newpiece(current, connection_index);
-				l->l2_list.back().flags |= lookahead_item::LAI_FLAGS::ALLOW_DIFFERENT_CONNECTION_INDEX | lookahead_item::LAI_FLAGS::HALT_UNLESS_VISIBLE;
-				if (current_offset < l->l2_list.back().sighting_offset) {    //can't see beyond this
-					l->l2_list.back().flags |= lookahead_item::LAI_FLAGS::SCAN_BEYOND_IF_PASSABLE;
-					break;
-				}
-			} else {
-				newpiece(current, 0);
-			}
+		ScanUnrouted(t, track_target_ptr(pos.GetTrack(), pos.GetDirection()), offset, blocklimit);
+	}
+}
 
-			track_target_ptr next = current.track->GetConnectingPiece(current.direction);
-			if (next.IsValid()) {
-				current = next;
-			} else {
-				routing_point *rp = FastRoutingpointCast(current.track, current.direction);
-				if (rp) {
-					newsignal(vartrack_target_ptr<routing_point>(rp, current.direction));
-				}
+// Scan from current, which starts at offset, until the next signal or a piece which cannot yet be seen beyond.
+// Pieces are added to the last routing point in l1_list, which must not have been filled in yet.
+void lookahead::ScanUnrouted(const train *t /* optional */, track_target_ptr current, uint64_t offset, unsigned int blocklimit) {
+	while (true) {
+		generic_signal *gs = FastSignalCast(current.track, current.direction);
+		if (gs) {
+			SetRoutingPoint(vartrack_target_ptr<routing_point>(gs, current.direction), offset, blocklimit);
+			l1_list.back().last_aspect = 0;
+			return;
+		}
+		if (!current.track->IsTrackAlwaysPassable()) {
+			unsigned int connection_index = current.track->GetCurrentNominalConnectionIndex(current.direction);
+			lookahead_item &l2 = AddPiece(t, current, connection_index, offset);
+			l2.flags |= lookahead_item::LAI_FLAGS::ALLOW_DIFFERENT_CONNECTION_INDEX | lookahead_item::LAI_FLAGS::HALT_UNLESS_VISIBLE;
+			if (current_offset < l2.sighting_offset) {    //can't see beyond this
+				l2.flags |= lookahead_item::LAI_FLAGS::SCAN_BEYOND_IF_PASSABLE;
 				break;
 			}
+		} else {
+			AddPiece(t, current, 0, offset);
 		}
-		if (!l->gs.IsValid()) {
-			if (l->l2_list.empty()) {
-				l1_list.pop_back();
-			} else {
-				l->offset = l->l2_list.back().end_offset;    //dummy signal
-				l->gs.Reset();
-				l->sighting_offset = l->offset;
-				l->last_aspect = 0;
+
+		track_target_ptr next = current.track->GetConnectingPiece(current.direction);
+		if (next.IsValid()) {
+			current = next;
+		} else {
+			routing_point *rp = FastRoutingpointCast(current.track, current.direction);
+			if (rp) {
+				SetRoutingPoint(vartrack_target_ptr<routing_point>(rp, current.direction), offset, blocklimit);
 			}
+			break;
+		}
+	}
+	lookahead_routing_point &l = l1_list.back();
+	if (!l.gs.IsValid()) {
+		if (!l.l2_count) {
+			l1_list.pop_back();
+		} else {
+			l.offset = l2_list.back().end_offset;    //dummy signal
+			l.gs.Reset();
+			l.sighting_offset = l.offset;
+			l.last_aspect = 0;
 		}
 	}
 }
 
 void lookahead::Clear() {
+	SaveListsForUndo();
 	l1_list.clear();
+	l2_list.clear();
 	current_offset = 0;
 }
 
 void lookahead::Deserialise(const deserialiser_input &di, error_collection &ec) {
 	l1_list.clear();
+	l2_list.clear();
 	CheckTransJsonValueDef(current_offset, di, "current_offset", 0, ec);
 	CheckIterateJsonArrayOrType<json_object>(di, "l1", "l1", ec, [&](const deserialiser_input &edi, error_collection &ec) {
-		l1_list.emplace_back();
-		lookahead_routing_point &l1 = l1_list.back();
+		lookahead_routing_point &l1 = l1_list.emplace_back();
 		CheckTransJsonValueDef(l1.offset, edi, "offset", 0, ec);
 		CheckTransJsonValueDef(l1.sighting_offset, edi, "sighting_offset", 0, ec);
 		track_target_ptr ttp;
@@ -308,8 +467,8 @@ void lookahead::Deserialise(const deserialiser_input &di, error_collection &ec)
 		l1.gs = vartrack_target_ptr<routing_point>(FastRoutingpointCast(ttp.track, ttp.direction), ttp.direction);
 		CheckTransJsonValueDef(l1.last_aspect, edi, "last_aspect", 0, ec);
 		CheckIterateJsonArrayOrType<json_object>(edi, "l2", "l2", ec, [&](const deserialiser_input &fdi, error_collection &ec) {
-			l1.l2_list.emplace_back();
-			lookahead_item &l2 = l1.l2_list.back();
+			lookahead_item &l2 = l2_list.emplace_back();
+			l1_list.back().l2_count++;
 			CheckTransJsonValueDef(l2.start_offset, fdi, "start_offset", 0, ec);
 			CheckTransJsonValueDef(l2.end_offset, fdi, "end_offset", 0, ec);
 			CheckTransJsonValueDef(l2.sighting_offset, fdi, "sighting_offset", 0, ec);
@@ -322,20 +481,33 @@ void lookahead::Deserialise(const deserialiser_input &di, error_collection &ec)
 
 void lookahead::Serialise(serialiser_output &so, error_collection &ec) const {
 	SerialiseValueJson(current_offset, so, "current_offset");
-	SerialiseObjectArrayContainer(l1_list, so, "l1", [&](serialiser_output &so, const lookahead_routing_point &l1) {
+	so.json_out.String("l1");
+	so.json_out.StartArray();
+	size_t l2_start = 0;
+	for (size_t i = 0; i < l1_list.size(); i++) {
+		const lookahead_routing_point &l1 = l1_list[i];
+		so.json_out.StartObject();
 		SerialiseValueJson(l1.offset, so, "offset");
 		SerialiseValueJson(l1.sighting_offset, so, "sighting_offset");
 		track_target_ptr ttp = l1.gs;
 		ttp.Serialise("gs", so, ec);
 		SerialiseValueJson(l1.last_aspect, so, "last_aspect");
-		SerialiseObjectArrayContainer(l1.l2_list, so, "l2", [&](serialiser_output &so, const lookahead_item &l2) {
+		so.json_out.String("l2");
+		so.json_out.StartArray();
+		for (size_t j = l2_start; j < l2_start + l1.l2_count; j++) {
+			const lookahead_item &l2 = l2_list[j];
+			so.json_out.StartObject();
 			SerialiseValueJson(l2.start_offset, so, "start_offset");
 			SerialiseValueJson(l2.end_offset, so, "end_offset");
 			SerialiseValueJson(l2.sighting_offset, so, "sighting_offset");
 			l2.piece.Serialise("piece", so, ec);
 			SerialiseValueJson(l2.connection_index, so, "connection_index");
 			SerialiseValueJson(l2.flags, so, "flags");
-		});
-	});
+			so.json_out.EndObject();
+		}
+		so.json_out.EndArray();
+		so.json_out.EndObject();
+		l2_start += l1.l2_count;
+	}
+	so.json_out.EndArray();
 }
-
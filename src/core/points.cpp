@@ -46,6 +46,8 @@ generic_points::PTF generic_points::SetPointsFlagsMasked(unsigned int points_ind
 	pflags = (pflags & (~mask_flags)) | (set_flags & mask_flags);
 	if (old_pflags != pflags) {
 		MarkUpdated();
+		GetWorld().RoutingStateChanged();
+		MarkTickUpdateDependentsDirty();
 	}
 
 	std::vector<points_coupling> *couplings = GetCouplingVector(points_index);
@@ -62,6 +64,8 @@ generic_points::PTF generic_points::SetPointsFlagsMasked(unsigned int points_ind
 			*(it.pflags) = (*(it.pflags) & (~curmask)) | (curbits & curmask);
 			if (old_cp_pflags != *(it.pflags)) {
 				it.targ->MarkUpdated();
+				GetWorld().RoutingStateChanged();
+				it.targ->MarkTickUpdateDependentsDirty();
 			}
 		}
 	}
@@ -18,11 +18,14 @@
 
 #include "common.h"
 #include "core/route.h"
+#include "core/route_conflict.h"
 #include "core/track.h"
 #include "util/util.h"
 #include "core/signal.h"
+#include "core/points.h"
 
 #include <algorithm>
+#include <functional>
 
 void route_common::ApplyTo(route_common &target) const {
 	if (route_common_flags & RCF::PRIORITY_SET) {
@@ -127,6 +130,38 @@ void route::RouteReservationActions(RRF reserve_flags, std::function<void(action
 	end.track->ReservationActions(reservation_request_action(end.direction, 0, reserve_flags | RRF::END_PIECE, this, action_callback));
 }
 
+unsigned int route::GetReservationActionCount() const {
+	auto count_actions = [&]() -> unsigned int {
+		unsigned int count = 0;
+		RouteReservationActions(RRF::RESERVE, [&](action &&reservation_act) {
+			count++;
+		});
+		return count;
+	};
+
+	if (action_points.size() > 32) {
+		return count_actions();    //too many points to pack into the key, don't memoise
+	}
+
+	uint64_t key = 0;
+	for (auto &it : action_points) {
+		key = (key << 2) | it.first->GetReservationActionStateBits(it.second);
+	}
+	if (!action_count_valid || key != action_count_key) {
+		action_count = count_actions();
+		action_count_key = key;
+		action_count_valid = true;
+	}
+	return action_count;
+}
+
+bool route::IsReservationBlockedBySetRoute(RRF reserve_flags) const {
+	if (!conflict_matrix || reserve_flags & RRF::IGNORE_EXISTING) {
+		return false;
+	}
+	return conflict_matrix->HasSetConflict(*this);
+}
+
 void route::FillLists() {
 	track_circuit *last_tc = nullptr;
 	for (auto &it : pieces) {
@@ -146,6 +181,12 @@ void route::FillLists() {
 		if (!it.location.track->IsTrackAlwaysPassable()) {
 			pass_test_list.push_back(it);
 		}
+		generic_points *gp = dynamic_cast<generic_points *>(it.location.track);
+		if (gp) {
+			for (unsigned int i = 0; i < gp->GetPointsCount(); i++) {
+				action_points.emplace_back(gp, i);
+			}
+		}
 		if (it.location.track->HasBerth(it.location.direction)) {
 			berths.emplace_back(it.location.track->GetBerth(), it.location.track);
 		}
@@ -153,6 +194,16 @@ void route::FillLists() {
 			berths.clear();	//if we reach a signal, remove any berths we saw beforehand
 		}
 	}
+	vias_hash = HashViaList(vias);
+}
+
+size_t HashViaList(const via_list &vias) {
+	size_t hash = vias.size();
+	std::hash<const routing_point *> hasher;
+	for (auto &it : vias) {
+		hash ^= hasher(it) + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+	}
+	return hash;
 }
 
 bool route::TestRouteForMatch(const routing_point *check_end, const via_list &check_vias) const {
@@ -219,17 +270,17 @@ bool route::IsRouteTractionSuitable(const train* t) const {
 
 //return true if restriction applies
 bool route_restriction::CheckRestriction(route_class::set &allowed_routes, const route_recording_list &route_pieces, const track_target_ptr &piece) const {
-	if (!targets.empty() && std::find(targets.begin(), targets.end(), piece.track->GetName()) == targets.end()) {
+	if (!targets.empty() && std::find(targets.begin(), targets.end(), piece.track->GetTrackId()) == targets.end()) {
 		return false;
 	}
 
 	auto via_start = via.begin();
 	for (auto &it : route_pieces) {
-		if (!not_via.empty() && std::find(not_via.begin(), not_via.end(), it.location.track->GetName()) != not_via.end()) {
+		if (!not_via.empty() && std::find(not_via.begin(), not_via.end(), it.location.track->GetTrackId()) != not_via.end()) {
 			return false;
 		}
 		if (!via.empty()) {
-			auto found_via = std::find(via_start, via.end(), it.location.track->GetName());
+			auto found_via = std::find(via_start, via.end(), it.location.track->GetTrackId());
 			if (found_via != via.end()) {
 				via_start = std::next(found_via, 1);
 			}
@@ -0,0 +1,179 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2013 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#include "common.h"
+#include "core/route_conflict.h"
+#include "core/route.h"
+#include "core/signal.h"
+#include "core/world.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+	struct route_piece_usage {
+		unsigned int id;
+		EDGE direction;
+		unsigned int index;
+
+		bool SameUsage(const route_piece_usage &other) const {
+			return direction == other.direction && index == other.index;
+		}
+	};
+}
+
+void route_conflict_matrix::Build(world &w) {
+	for (route *r : routes) {
+		r->conflict_id = INVALID_ID;
+		r->conflict_matrix = nullptr;
+	}
+	routes.clear();
+	row_offsets.clear();
+	conflict_words.clear();
+	set_routes.clear();
+
+	for (track_id_type id = 0; id < w.GetTrackIdCount(); id++) {
+		routing_point *rp = dynamic_cast<routing_point *>(w.GetTrackById(id));
+		if (!rp) {
+			continue;
+		}
+		rp->EnumerateRoutes([&](const route *cr) {
+			route *r = rp->GetRouteByIndex(cr->index);
+			if (r != cr) {
+				return;
+			}
+			r->conflict_id = routes.size();
+			r->conflict_matrix = this;
+			routes.push_back(r);
+		});
+	}
+
+	// Each piece reservation made by a route, see route::RouteReservation
+	std::unordered_map<const generic_track *, std::vector<route_piece_usage> > piece_usages;
+	for (const route *r : routes) {
+		piece_usages[r->start.track].push_back({ r->conflict_id, r->start.direction, 0 });
+		for (auto &it : r->pieces) {
+			piece_usages[it.location.track].push_back({ r->conflict_id, it.location.direction, it.connection_index });
+		}
+		piece_usages[r->end.track].push_back({ r->conflict_id, r->end.direction, 0 });
+	}
+
+	// A reservation fails if the piece is already reserved with a different direction or index, see track_reservation_state::Reservation
+	std::vector<std::vector<unsigned int> > conflicts(routes.size());
+	for (auto &it : piece_usages) {
+		const std::vector<route_piece_usage> &usages = it.second;
+		for (size_t i = 0; i < usages.size(); i++) {
+			for (size_t j = i + 1; j < usages.size(); j++) {
+				if (usages[i].id != usages[j].id && !usages[i].SameUsage(usages[j])) {
+					conflicts[usages[i].id].push_back(usages[j].id);
+					conflicts[usages[j].id].push_back(usages[i].id);
+				}
+			}
+		}
+	}
+
+	row_offsets.reserve(routes.size() + 1);
+	for (auto &row : conflicts) {
+		row_offsets.push_back(conflict_words.size());
+		std::sort(row.begin(), row.end());
+		for (unsigned int id : row) {
+			unsigned int word = id / 64;
+			if (conflict_words.size() == row_offsets.back() || conflict_words.back().index != word) {
+				conflict_words.push_back({ word, 0 });
+			}
+			conflict_words.back().bits |= UINT64_C(1) << (id % 64);
+		}
+	}
+	row_offsets.push_back(conflict_words.size());
+
+	set_routes.assign((routes.size() + 63) / 64, 0);
+	built = true;
+	RefreshAllRoutes();
+}
+
+void route_conflict_matrix::RefreshAllRoutes() {
+	for (const route *r : routes) {
+		RefreshRoute(*r);
+	}
+}
+
+bool route_conflict_matrix::IsConflicting(const route &a, const route &b) const {
+	if (a.conflict_matrix != this || b.conflict_matrix != this) {
+		return false;
+	}
+	unsigned int word = b.conflict_id / 64;
+	for (unsigned int i = row_offsets[a.conflict_id]; i < row_offsets[a.conflict_id + 1]; i++) {
+		if (conflict_words[i].index == word) {
+			return conflict_words[i].bits & (UINT64_C(1) << (b.conflict_id % 64));
+		}
+	}
+	return false;
+}
+
+bool route_conflict_matrix::HasSetConflict(const route &r) const {
+	if (r.conflict_matrix != this) {
+		return false;
+	}
+	for (unsigned int i = row_offsets[r.conflict_id]; i < row_offsets[r.conflict_id + 1]; i++) {
+		if (set_routes[conflict_words[i].index] & conflict_words[i].bits) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool route_conflict_matrix::IsRouteSet(const route &r) const {
+	if (r.conflict_matrix != this) {
+		return false;
+	}
+	return set_routes[r.conflict_id / 64] & (UINT64_C(1) << (r.conflict_id % 64));
+}
+
+void route_conflict_matrix::RouteSet(const route &r) {
+	set_routes[r.conflict_id / 64] |= UINT64_C(1) << (r.conflict_id % 64);
+}
+
+void route_conflict_matrix::RouteUnset(const route &r) {
+	set_routes[r.conflict_id / 64] &= ~(UINT64_C(1) << (r.conflict_id % 64));
+}
+
+void route_conflict_matrix::RefreshRoute(const route &r) {
+	if (r.conflict_matrix != this) {
+		return;
+	}
+	auto is_reserved = [&](generic_track *piece, EDGE direction, unsigned int index) -> bool {
+		bool found = false;
+		piece->ReservationEnumeration([&](const route *reserved_route, EDGE r_direction, unsigned int r_index, RRF rr_flags) {
+			if (reserved_route == &r && r_direction == direction && r_index == index) {
+				found = true;
+			}
+		}, RRF::RESERVE | RRF::PROVISIONAL_RESERVE);
+		return found;
+	};
+
+	bool set = is_reserved(r.start.track, r.start.direction, 0);
+	for (auto it = r.pieces.begin(); set && it != r.pieces.end(); ++it) {
+		set = is_reserved(it->location.track, it->location.direction, it->connection_index);
+	}
+	set = set && is_reserved(r.end.track, r.end.direction, 0);
+	if (set) {
+		RouteSet(r);
+	} else {
+		RouteUnset(r);
+	}
+}
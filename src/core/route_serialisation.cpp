@@ -228,18 +228,41 @@ void route_common::DeserialiseRouteCommon(const deserialiser_input &subdi, error
 	}
 }
 
-void route_restriction_set::DeserialiseRestriction(const deserialiser_input &subdi, error_collection &ec, bool isendtype) {
+void route_restriction_set::DeserialiseRestriction(world &w, const deserialiser_input &subdi, error_collection &ec, bool isendtype) {
 	restrictions.emplace_back();
 	route_restriction &rr = restrictions.back();
 
+	//names may refer to pieces which have not been deserialised yet, so are only resolved to IDs once the whole layout has been loaded
+	//names which are not found resolve to INVALID_TRACK_ID, which does not match any piece
+	auto fill_ids = [&](const char *prop, std::vector<track_id_type> route_restriction::*member) -> bool {
+		std::vector<std::string> names;
+		bool result = CheckFillTypeVectorFromJsonArrayOrType<std::string>(subdi, prop, ec, names);
+		if (names.empty()) {
+			return result;
+		}
+		(rr.*member).resize(names.size(), INVALID_TRACK_ID);
+		size_t index = restrictions.size() - 1;
+		auto resolve = [this, &w, index, member, names](error_collection &ec) {
+			std::vector<track_id_type> &ids = restrictions[index].*member;
+			for (size_t i = 0; i < names.size(); i++) {
+				ids[i] = w.FindTrackId(names[i]);
+			}
+		};
+		if (w.GetWFlags() & world::WFLAGS::DONE_LAYOUT_INIT) {
+			resolve(ec);
+		} else {
+			w.layout_init_final_fixups.AddFixup(resolve);
+		}
+		return result;
+	};
+
 	if (isendtype) {
-		CheckFillTypeVectorFromJsonArrayOrType<std::string>(subdi, "route_start", ec, rr.targets);
+		fill_ids("route_start", &route_restriction::targets);
 	} else {
-		CheckFillTypeVectorFromJsonArrayOrType<std::string>(subdi, "targets", ec, rr.targets) ||
-				CheckFillTypeVectorFromJsonArrayOrType<std::string>(subdi, "route_end", ec, rr.targets);
+		fill_ids("targets", &route_restriction::targets) || fill_ids("route_end", &route_restriction::targets);
 	}
-	CheckFillTypeVectorFromJsonArrayOrType<std::string>(subdi, "via", ec, rr.via);
-	CheckFillTypeVectorFromJsonArrayOrType<std::string>(subdi, "not_via", ec, rr.not_via);
+	fill_ids("via", &route_restriction::via);
+	fill_ids("not_via", &route_restriction::not_via);
 
 	rr.DeserialiseRouteCommon(subdi, ec);
 
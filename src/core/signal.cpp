@@ -48,6 +48,14 @@ class error_signalinit_trackscan : public error_signalinit {
 
 void routing_point::EnumerateRoutes(std::function<void (const route *)> func) const { }
 
+void routing_point::BuildRouteIndex() {
+	route_index.clear();
+	EnumerateRoutes([&](const route *r) {
+		route_index[r->end.track].push_back(r);
+	});
+	route_index_built = true;
+}
+
 const route *routing_point::FindBestOverlap(route_class::set types) const {
 	int best_score = INT_MIN;
 	const route *best_overlap = nullptr;
@@ -69,15 +77,12 @@ void routing_point::EnumerateAvailableOverlaps(std::function<void(const route *r
 		if (!(types & route_class::Flag(r->type))) {
 			return;
 		}
-		if (!r->RouteReservation(RRF::TRY_RESERVE | extra_flags).IsSuccess()) {
+		if (r->IsReservationBlockedBySetRoute(RRF::TRY_RESERVE | extra_flags) || !r->RouteReservation(RRF::TRY_RESERVE | extra_flags).IsSuccess()) {
 			return;
 		}
 
-		int score = r->priority;
-		auto action_counter = [&](action &&reservation_act) {
-			score -= 10;
-		};
-		r->RouteReservationActions(RRF::RESERVE | extra_flags, action_counter);
+		// extra_flags are not passed on, reservation actions only depend on RRF::RESERVE / RRF::UNRESERVE
+		int score = r->priority - (10 * static_cast<int>(r->GetReservationActionCount()));
 		func(r, score);
 	};
 	EnumerateRoutes(overlap_finder);
@@ -101,15 +106,13 @@ unsigned int routing_point::GetMatchingRoutes(std::vector<gmr_route_item> &route
 
 		int score = r->priority;
 		if (gmr_flags & GMRF::CHECK_TRY_RESERVE) {
-			if (!r->RouteReservation(RRF::TRY_RESERVE | extra_flags).IsSuccess()) {
+			if (r->IsReservationBlockedBySetRoute(RRF::TRY_RESERVE | extra_flags) || !r->RouteReservation(RRF::TRY_RESERVE | extra_flags).IsSuccess()) {
 				return;
 			}
 		}
 		if (gmr_flags & GMRF::DYNAMIC_PRIORITY) {
-			auto action_counter = [&](action &&reservation_act) {
-				score -= 10;
-			};
-			r->RouteReservationActions(RRF::RESERVE | extra_flags, action_counter);
+			// extra_flags are not passed on, reservation actions only depend on RRF::RESERVE / RRF::UNRESERVE
+			score -= 10 * static_cast<int>(r->GetReservationActionCount());
 
 			if (route_class::PreferWhenReservingIfAlreadyOccupied(r->type)) {
 				for (auto &it : r->track_circuits) {
@@ -127,7 +130,20 @@ unsigned int routing_point::GetMatchingRoutes(std::vector<gmr_route_item> &route
 		count++;
 
 	};
-	EnumerateRoutes(route_finder);
+	if (end && route_index_built) {
+		auto it = route_index.find(end);
+		if (it != route_index.end()) {
+			size_t vias_hash = (gmr_flags & GMRF::CHECK_VIAS) ? HashViaList(vias) : 0;
+			for (const route *r : it->second) {
+				if (gmr_flags & GMRF::CHECK_VIAS && r->vias_hash != vias_hash) {
+					continue;
+				}
+				route_finder(r);
+			}
+		}
+	} else {
+		EnumerateRoutes(route_finder);
+	}
 	auto sortfunc = [&](const gmr_route_item &a, const gmr_route_item &b) -> bool {
 		if (a.score > b.score) return true;
 		if (a.score < b.score) return false;
@@ -257,7 +273,11 @@ GSF generic_signal::GetSignalFlags() const {
 }
 
 GSF generic_signal::SetSignalFlagsMasked(GSF set_flags, GSF mask_flags) {
+	GSF old_sflags = sflags;
 	sflags = (sflags & (~mask_flags)) | set_flags;
+	if (old_sflags != sflags) {
+		MarkTickUpdateDirty();
+	}
 	return sflags;
 }
 
@@ -306,8 +326,45 @@ void generic_signal::UpdateSignalState() {
 		return;
 	}
 
+	ClearTickUpdateDirty();
+
+	unsigned int old_aspect = aspect;
+	unsigned int old_reserved_aspect = reserved_aspect;
+	route_class::ID old_aspect_type = aspect_type;
+	const routing_point *old_aspect_target = GetAspectNextTarget();
+	const routing_point *old_aspect_route_target = GetAspectRouteTarget();
+	world_time old_prove_time = last_route_prove_time;
+	world_time old_clear_time = last_route_clear_time;
+	world_time old_set_time = last_route_set_time;
+	world_time old_overlap_timeout_start = overlap_timeout_start;
+
+	world_time wake_time = UINT_MAX;
+	UpdateSignalStateIntl(wake_time);
+
+	// Anything which reads this signal's state needs to be re-evaluated if it changed.
+	// This signal needs to be re-evaluated on the next tick if its own state changed (as it depends on its previous state),
+	// and when any timer which it is waiting on expires.
+	if (old_aspect != aspect || old_reserved_aspect != reserved_aspect || old_aspect_type != aspect_type ||
+			old_aspect_target != GetAspectNextTarget() || old_aspect_route_target != GetAspectRouteTarget()) {
+		MarkTickUpdateDependentsDirty();
+	} else if (old_prove_time != last_route_prove_time || old_clear_time != last_route_clear_time ||
+			old_set_time != last_route_set_time || old_overlap_timeout_start != overlap_timeout_start) {
+		MarkTickUpdateDirty();
+	}
+	if (wake_time != UINT_MAX) {
+		SetTickUpdateWakeup(wake_time);
+	}
+}
+
+void generic_signal::UpdateSignalStateIntl(world_time &wake_time) {
 	last_state_update = GetWorld().GetGameTime();
 
+	auto wake_at = [&](world_time t) {
+		if (t < wake_time) {
+			wake_time = t;
+		}
+	};
+
 	unsigned int previous_aspect = aspect;
 	const routing_point *previous_aspect_target = GetAspectNextTarget();
 	const routing_point *previous_aspect_route_target = GetAspectRouteTarget();
@@ -317,6 +374,7 @@ void generic_signal::UpdateSignalState() {
 				previous_aspect_target != GetAspectNextTarget() ||
 				previous_aspect_route_target != GetAspectRouteTarget()) {
 			MarkUpdated();
+			GetWorld().RoutingStateChanged();
 		}
 	};
 
@@ -397,6 +455,7 @@ void generic_signal::UpdateSignalState() {
 				overlap_timeout_start = GetWorld().GetGameTime();
 				SetSignalFlagsMasked(GSF::OVERLAP_TIMEOUT_STARTED, GSF::OVERLAP_TIMEOUT_STARTED);
 			}
+			wake_at(overlap_timeout_start + own_overlap->overlap_timeout);
 			overlap_timeout_set = true;
 		}
 	}
@@ -466,9 +525,12 @@ void generic_signal::UpdateSignalState() {
 			bool can_trigger = false;
 
 			auto test_ttcb = [&](track_train_counter_block *ttcb) {
-				if (ttcb && ttcb->Occupied() && ttcb->GetLastOccupationStateChangeTime() +
-						set_route->approach_control_triggerdelay <= GetWorld().GetGameTime()) {
-					can_trigger = true;
+				if (ttcb && ttcb->Occupied()) {
+					if (ttcb->GetLastOccupationStateChangeTime() + set_route->approach_control_triggerdelay <= GetWorld().GetGameTime()) {
+						can_trigger = true;
+					} else {
+						wake_at(ttcb->GetLastOccupationStateChangeTime() + set_route->approach_control_triggerdelay);
+					}
 				}
 			};
 
@@ -545,12 +607,15 @@ void generic_signal::UpdateSignalState() {
 	}
 	if (last_state_update - last_route_prove_time < set_route->route_prove_delay) {
 		aspect = 0;
+		wake_at(last_route_prove_time + set_route->route_prove_delay);
 	}
 	if (last_state_update - last_route_clear_time < set_route->route_clear_delay) {
 		aspect = 0;
+		wake_at(last_route_clear_time + set_route->route_clear_delay);
 	}
 	if (last_state_update - last_route_set_time < set_route->route_set_delay) {
 		aspect = 0;
+		wake_at(last_route_set_time + set_route->route_set_delay);
 	}
 
 	auto check_aspect_mask = [&](unsigned int &aspect, aspect_mask_type mask) {
@@ -574,6 +639,68 @@ void generic_signal::UpdateSignalState() {
 	check_aspect_change();
 }
 
+// An expiring overlap timeout submits an unreserve action part way through the tick update pass,
+// the result of which depends on which other signals have already been updated
+bool generic_signal::IsTickUpdateOrderSensitive() const {
+	if (!(sflags & GSF::OVERLAP_TIMEOUT_STARTED)) {
+		return false;
+	}
+	const route *own_overlap = GetCurrentForwardOverlap();
+	return own_overlap && overlap_timeout_start + own_overlap->overlap_timeout <= GetWorld().GetGameTime();
+}
+
+// Register this signal with everything which its state update reads, such that changes to those mark it dirty
+void generic_signal::InitTickUpdateDependencies() {
+	EnumerateRoutes([&](const route *r) {
+		if (route_class::IsOverlap(r->type)) {
+			if (r->overlap_timeout_trigger) {
+				r->overlap_timeout_trigger->AddTickUpdateDependent(this);
+			}
+			return;
+		}
+
+		generic_signal *end_signal = FastSignalCast(r->end.track, r->end.direction);
+
+		// Repeaters on the route evaluate the same route
+		auto add_route_dependent = [&](generic_signal *gs) {
+			for (auto &it : r->pass_test_list) {
+				it.location.track->AddTickUpdateDependent(gs);
+			}
+			for (auto &it : r->track_circuits) {
+				it->AddTickUpdateDependent(gs);
+			}
+			if (r->approach_control_trigger) {
+				r->approach_control_trigger->AddTickUpdateDependent(gs);
+			}
+			for (auto &it : r->repeater_signals) {
+				it->AddTickUpdateDependent(gs);
+			}
+			if (end_signal) {
+				end_signal->AddTickUpdateDependent(gs);
+				end_signal->EnumerateRoutes([&](const route *ovlp) {
+					if (route_class::IsOverlap(ovlp->type)) {
+						for (auto &it : ovlp->track_circuits) {
+							it->AddTickUpdateDependent(gs);
+						}
+					}
+				});
+			}
+		};
+		add_route_dependent(this);
+		for (auto &it : r->repeater_signals) {
+			add_route_dependent(it);
+		}
+
+		// The end signal checks routes which terminate at it for approach control and overlap timeouts
+		if (end_signal) {
+			if (!r->track_circuits.empty()) {
+				r->track_circuits.back()->AddTickUpdateDependent(end_signal);
+			}
+			AddTickUpdateDependent(end_signal);
+		}
+	});
+}
+
 //this will not return the overlap, only the "real" route
 const route *generic_signal::GetCurrentForwardRoute() const {
 	const route *output = nullptr;
@@ -995,6 +1122,7 @@ bool generic_signal::PostLayoutInitTrackScan(error_collection &ec, unsigned int
 	TrackScan(max_pieces, junction_max, GetConnectingPieceByIndex(EDGE::FRONT, 0), pieces, &rrrs, error_flags, func);
 
 	available_overlaps = foundoverlaps;
+	BuildRouteIndex();
 
 	if (error_flags != TSEF::ZERO) {
 		continue_initing = false;
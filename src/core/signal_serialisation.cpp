@@ -28,7 +28,7 @@ void routing_point::Deserialise(const deserialiser_input &di, error_collection &
 	generic_zlen_track::Deserialise(di, ec);
 	CheckIterateJsonArrayOrType<json_object>(di, "route_end_restrictions", "route_restrictions", ec,
 		[&](const deserialiser_input &subdi, error_collection &ec) {
-			endrestrictions.DeserialiseRestriction(subdi, ec, true);
+			endrestrictions.DeserialiseRestriction(GetWorld(), subdi, ec, true);
 		});
 
 	CheckTransJsonValue(aspect, di, "aspect", ec);
@@ -225,7 +225,7 @@ void route_signal::Deserialise(const deserialiser_input &di, error_collection &e
 	std_signal::Deserialise(di, ec);
 	CheckIterateJsonArrayOrType<json_object>(di, "route_restrictions", "route_restrictions", ec,
 		[&](const deserialiser_input &subdi, error_collection &ec) {
-			restrictions.DeserialiseRestriction(subdi, ec, false);
+			restrictions.DeserialiseRestriction(GetWorld(), subdi, ec, false);
 		});
 }
 
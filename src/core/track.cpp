@@ -22,7 +22,9 @@
 #include "core/track_piece.h"
 #include "core/train.h"
 #include "core/track_circuit.h"
+#include "core/world.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <initializer_list>
@@ -30,25 +32,56 @@
 track_location empty_track_location;
 track_target_ptr empty_track_target;
 
-unsigned int speed_restriction_set::GetTrackSpeedLimitByClass(const std::string &speed_class, unsigned int default_max) const {
-	for (auto it = speeds.begin(); it != speeds.end(); ++it) {
-		if (it->speed_class.empty() || it->speed_class == speed_class) {
-			if (it->speed < default_max) {
-				default_max = it->speed;
-			}
+static bool SpeedRestrictionClassLess(const speed_restriction &sr, speed_class_id_type speed_class) {
+	return sr.speed_class < speed_class;
+}
+
+void speed_restriction_set::AddSpeedRestriction(const speed_restriction &sr) {
+	auto it = std::lower_bound(speeds.begin(), speeds.end(), sr.speed_class, SpeedRestrictionClassLess);
+	if (it != speeds.end() && it->speed_class == sr.speed_class) {
+		it->speed = std::min(it->speed, sr.speed);
+	} else {
+		speeds.insert(it, sr);
+	}
+}
+
+unsigned int speed_restriction_set::GetTrackSpeedLimitByClass(speed_class_id_type speed_class, unsigned int default_max) const {
+	if (speeds.empty()) {
+		return default_max;
+	}
+	if (speeds.front().speed_class == 0) {
+		default_max = std::min(default_max, speeds.front().speed);
+	}
+	if (speed_class != 0) {
+		auto it = std::lower_bound(speeds.begin(), speeds.end(), speed_class, SpeedRestrictionClassLess);
+		if (it != speeds.end() && it->speed_class == speed_class) {
+			default_max = std::min(default_max, it->speed);
 		}
 	}
 	return default_max;
 }
 
+// This is slower than looking up by speed class ID, and is not intended for use when stepping trains
+unsigned int speed_restriction_set::GetTrackSpeedLimitByClass(const std::string &speed_class, unsigned int default_max) const {
+	speed_class_id_type id = 0;
+	if (!speed_class.empty()) {
+		id = w ? w->FindSpeedClassId(speed_class) : INVALID_SPEED_CLASS_ID;
+	}
+	return GetTrackSpeedLimitByClass(id, default_max);
+}
+
 unsigned int speed_restriction_set::GetTrainTrackSpeedLimit(const train *t /* optional */) const {
 	if (t) {
-		return GetTrackSpeedLimitByClass(t->GetVehSpeedClass(), t->GetMaxVehSpeed());
+		return GetTrackSpeedLimitByClass(t->GetVehSpeedClassId(), t->GetMaxVehSpeed());
 	} else {
-		return GetTrackSpeedLimitByClass("", UINT_MAX);
+		return GetTrackSpeedLimitByClass(0, UINT_MAX);
 	}
 }
 
+unsigned int speed_restriction_set::GetTrainClassTrackSpeedLimit(const train *t) const {
+	return GetTrackSpeedLimitByClass(t->GetVehSpeedClassId(), UINT_MAX);
+}
+
 const speed_restriction_set *generic_track::GetSpeedRestrictions() const {
 	return nullptr;
 }
@@ -142,11 +175,47 @@ bool generic_track::PostLayoutInit(error_collection &ec) {
 	return true;
 }
 
+void generic_track::MarkTickUpdateDirty() {
+	if (HasTickUpdate()) {
+		GetWorld().MarkTickUpdateDirty(tick_update_index);
+	}
+}
+
+void generic_track::ClearTickUpdateDirty() {
+	if (HasTickUpdate()) {
+		GetWorld().ClearTickUpdateDirty(tick_update_index);
+	}
+}
+
+void generic_track::SetTickUpdateWakeup(world_time wake) {
+	if (HasTickUpdate()) {
+		GetWorld().SetTickUpdateWakeup(tick_update_index, wake);
+	}
+}
+
+void generic_track::AddTickUpdateDependent(generic_track *piece) {
+	if (piece != this && std::find(tick_update_dependents.begin(), tick_update_dependents.end(), piece) == tick_update_dependents.end()) {
+		tick_update_dependents.push_back(piece);
+	}
+}
+
+void generic_track::MarkTickUpdateDependentsDirty() {
+	if (GetWorld().GetTickUpdateMode() != TICK_UPDATE_MODE::EVENT) {
+		return;
+	}
+	MarkTickUpdateDirty();
+	for (auto &it : tick_update_dependents) {
+		it->MarkTickUpdateDirty();
+	}
+}
+
 reservation_result generic_track::Reservation(const reservation_request_res &req) {
 	reservation_result result = ReservationV(req);
 	if (result.IsSuccess()) {
 		MarkUpdated();
 		UpdateTrackCircuitReservationState();
+		GetWorld().ReservationStateChanged();
+		MarkTickUpdateDependentsDirty();
 	}
 	return result;
 }
@@ -228,26 +297,32 @@ void generic_track::TrainLeave(EDGE direction, train *t) {
 void track_seg::TrainEnter(EDGE direction, train *t) {
 	generic_track::TrainEnter(direction, t);
 	train_count++;
-	occupying_trains.push_back(t);
+	occupant o { GetTrainOccupation(t), t->GetPositionGeneration() };
+	auto it = std::upper_bound(occupying_trains.begin(), occupying_trains.end(), o.to.start_offset, [&](unsigned int start_offset, occupant &other) {
+		return start_offset < GetOccupantOccupation(other).start_offset;
+	});
+	occupying_trains.insert(it, o);
 	for (auto &it : ttcbs) {
 		it->TrainEnter(t);
 	}
 	const speed_restriction_set *speeds = GetSpeedRestrictions();
 	if (speeds) {
-		t->AddCoveredTrackSpeedLimit(speeds->GetTrainTrackSpeedLimit(t));
+		t->AddCoveredTrackSpeedLimit(speeds->GetTrainClassTrackSpeedLimit(t));
 	}
 }
 
 void track_seg::TrainLeave(EDGE direction, train *t) {
 	generic_track::TrainLeave(direction, t);
 	train_count--;
-	container_unordered_remove_if(occupying_trains, [&](const train * const it) { return it == t; });
+	occupying_trains.erase(std::remove_if(occupying_trains.begin(), occupying_trains.end(), [&](const occupant &o) {
+		return o.to.t == t;
+	}), occupying_trains.end());
 	for (auto &it : ttcbs) {
 		it->TrainLeave(t);
 	}
 	const speed_restriction_set *speeds = GetSpeedRestrictions();
 	if (speeds) {
-		t->RemoveCoveredTrackSpeedLimit(speeds->GetTrainTrackSpeedLimit(t));
+		t->RemoveCoveredTrackSpeedLimit(speeds->GetTrainClassTrackSpeedLimit(t));
 	}
 }
 
@@ -399,43 +474,83 @@ void track_seg::GetListOfEdges(std::vector<edgelistitem> &output_list) const {
 	output_list.insert(output_list.end(), { edgelistitem(EDGE::BACK, next), edgelistitem(EDGE::FRONT, prev) });
 }
 
+generic_track::train_occupation track_seg::GetTrainOccupation(train *t) const {
+	train_occupation to;
+	to.t = t;
+	to.start_offset = 0;
+	to.end_offset = length;
+
+	auto checkpos = [&](track_location l, bool reverse) {
+		if (l.GetTrack() != this) {
+			return;
+		}
+
+		if (reverse) {
+			l.ReverseDirection();
+		}
+
+		//l now points *outward* from the train
+
+		if (l.GetDirection() == EDGE::FRONT) {
+			//this is the inclusive upper bound
+			to.end_offset = l.GetOffset();
+		}
+		if (l.GetDirection() == EDGE::BACK) {
+			//this is the inclusive lower bound
+			to.start_offset = l.GetOffset();
+		}
+	};
+	checkpos(t->GetTrainMotionState().head_pos, false);
+	checkpos(t->GetTrainMotionState().tail_pos, true);
+	return to;
+}
+
+// The occupation of a train is only recalculated if it has moved since it was last calculated
+const generic_track::train_occupation &track_seg::GetOccupantOccupation(occupant &o) const {
+	if (o.position_generation != o.to.t->GetPositionGeneration()) {
+		o.to = GetTrainOccupation(o.to.t);
+		o.position_generation = o.to.t->GetPositionGeneration();
+	}
+	return o.to;
+}
+
 void track_seg::GetTrainOccupationState(std::vector<generic_track::train_occupation> &train_os) {
 	train_os.clear();
 	if (train_count == 0) {
 		return;
 	}
 
-	for (train *t : occupying_trains) {
-		train_os.emplace_back();
-		train_occupation &to = train_os.back();
-
-		to.t = t;
-		to.start_offset = 0;
-		to.end_offset = length;
-
-		auto checkpos = [&](track_location l, bool reverse) {
-			if (l.GetTrack() != this) {
-				return;
-			}
-
-			if (reverse) {
-				l.ReverseDirection();
-			}
-
-			//l now points *outward* from the train
+	for (occupant &o : occupying_trains) {
+		train_os.push_back(GetOccupantOccupation(o));
+	}
+}
 
-			if (l.GetDirection() == EDGE::FRONT) {
-				//this is the inclusive upper bound
-				to.end_offset = l.GetOffset();
-			}
-			if (l.GetDirection() == EDGE::BACK) {
-				//this is the inclusive lower bound
-				to.start_offset = l.GetOffset();
-			}
-		};
-		checkpos(t->GetTrainMotionState().head_pos, false);
-		checkpos(t->GetTrainMotionState().tail_pos, true);
+bool track_seg::GetNearestTrainOccupation(EDGE direction, unsigned int offset, train_occupation &to, unsigned int &distance) {
+	//as trains are in order of offset, the start and end offsets are both increasing
+	if (direction == EDGE::FRONT) {
+		//find the first train which is not entirely behind offset
+		auto it = std::partition_point(occupying_trains.begin(), occupying_trains.end(), [&](occupant &o) {
+			const train_occupation &oto = GetOccupantOccupation(o);
+			return oto.end_offset <= offset && oto.start_offset < offset;
+		});
+		if (it == occupying_trains.end()) {
+			return false;
+		}
+		to = GetOccupantOccupation(*it);
+		distance = (to.start_offset < offset) ? 0 : to.start_offset - offset;
+	} else {
+		//find the last train which is not entirely in front of offset
+		auto it = std::partition_point(occupying_trains.begin(), occupying_trains.end(), [&](occupant &o) {
+			const train_occupation &oto = GetOccupantOccupation(o);
+			return !(oto.start_offset >= offset && oto.end_offset > offset);
+		});
+		if (it == occupying_trains.begin()) {
+			return false;
+		}
+		to = GetOccupantOccupation(*(it - 1));
+		distance = (to.end_offset > offset) ? 0 : offset - to.end_offset;
 	}
+	return true;
 }
 
 unsigned int generic_zlen_track::GetStartOffset(EDGE direction) const {
@@ -105,8 +105,7 @@ void track_train_counter_block::TrainEnter(train *t) {
 	}
 
 	if (prevoccupied != Occupied()) {
-		last_change = GetWorld().GetGameTime();
-		OccupationStateChangeTrigger();
+		OccupationStateChanged();
 		OccupationTrigger();
 	}
 }
@@ -124,12 +123,25 @@ void track_train_counter_block::TrainLeave(train *t) {
 		}
 	}
 	if (prevoccupied != Occupied()) {
-		last_change = GetWorld().GetGameTime();
-		OccupationStateChangeTrigger();
+		OccupationStateChanged();
 		DeOccupationTrigger();
 	}
 }
 
+void track_train_counter_block::OccupationStateChanged() {
+	last_change = GetWorld().GetGameTime();
+	for (auto &it : tick_update_dependents) {
+		it->MarkTickUpdateDirty();
+	}
+	OccupationStateChangeTrigger();
+}
+
+void track_train_counter_block::AddTickUpdateDependent(generic_track *piece) {
+	if (std::find(tick_update_dependents.begin(), tick_update_dependents.end(), piece) == tick_update_dependents.end()) {
+		tick_update_dependents.push_back(piece);
+	}
+}
+
 void track_train_counter_block::Deserialise(const deserialiser_input &di, error_collection &ec) {
 	world_obj::Deserialise(di, ec);
 
@@ -152,8 +164,7 @@ track_train_counter_block::TCF track_train_counter_block::SetTCFlagsMasked(TCF b
 	bool prevoccupied = Occupied();
 	tc_flags = (tc_flags & ~mask) | (bits & mask);
 	if (prevoccupied != Occupied()) {
-		last_change = GetWorld().GetGameTime();
-		OccupationStateChangeTrigger();
+		OccupationStateChanged();
 		if (prevoccupied) {
 			DeOccupationTrigger();
 		} else {
@@ -56,7 +56,7 @@ struct overlap_conflict_resolution {
 	std::vector<const route *> add_overlaps;
 	int best_score = INT_MIN;
 
-	void Execute(const action &a, std::function<void()> callback = nullptr) {
+	void Execute(const action &a, std::function<void()> callback = nullptr) const {
 		{
 			track_reservation_state_backup_guard guard;
 			// This guard is so that the reservation actions are executed with the old overlaps removed,
@@ -93,7 +93,8 @@ struct overlap_conflict_req_info {
 };
 
 void CheckOverlapConflictIntl(std::vector<const route *> &conflicting_overlaps, std::vector<overlap_conflict_req_info> &overlap_starts,
-		std::vector<const route *> &add_overlaps, overlap_conflict_resolution &output, size_t stage, int stage_score) {
+		std::vector<const route *> &add_overlaps, overlap_conflict_resolution &output, track_reservation_state_backup_guard &guard,
+		size_t stage, int stage_score) {
 	generic_signal *start = overlap_starts[stage].start;
 	start->EnumerateAvailableOverlaps([&](const route *rt, int score) {
 		add_overlaps.push_back(rt);
@@ -101,10 +102,11 @@ void CheckOverlapConflictIntl(std::vector<const route *> &conflicting_overlaps,
 		if (result.IsSuccess()) {
 			if (stage < overlap_starts.size() - 1) {
 				// more stages
-				track_reservation_state_backup_guard guard;
+				size_t savepoint = guard.Savepoint();
 				auto res_result = rt->RouteReservation(RRF::RESERVE, nullptr, &guard);
 				assert(res_result.IsSuccess());
-				CheckOverlapConflictIntl(conflicting_overlaps, overlap_starts, add_overlaps, output, stage + 1, stage_score + score);
+				CheckOverlapConflictIntl(conflicting_overlaps, overlap_starts, add_overlaps, output, guard, stage + 1, stage_score + score);
+				guard.RollbackTo(savepoint);
 			} else {
 				// done
 				if (stage_score + score > output.best_score) {
@@ -129,7 +131,7 @@ void CheckOverlapConflictIntl(std::vector<const route *> &conflicting_overlaps,
 				}
 				if (ok) {
 					// found more overlaps to try and swing
-					track_reservation_state_backup_guard guard;
+					size_t savepoint = guard.Savepoint();
 
 					for (auto &it : result.conflicts) {
 						auto result = it.conflict_route->RouteReservation(RRF::UNRESERVE, nullptr, &guard);
@@ -142,7 +144,8 @@ void CheckOverlapConflictIntl(std::vector<const route *> &conflicting_overlaps,
 
 					auto res_result = rt->RouteReservation(RRF::RESERVE, nullptr, &guard);
 					assert(res_result.IsSuccess());
-					CheckOverlapConflictIntl(conflicting_overlaps, overlap_starts, add_overlaps, output, stage + 1, stage_score + score);
+					CheckOverlapConflictIntl(conflicting_overlaps, overlap_starts, add_overlaps, output, guard, stage + 1, stage_score + score);
+					guard.RollbackTo(savepoint);
 
 					overlap_starts.resize(overlap_starts.size() - result.conflicts.size());
 					conflicting_overlaps.resize(conflicting_overlaps.size() - result.conflicts.size());
@@ -173,7 +176,7 @@ bool CheckOverlapConflict(std::vector<const route *> conflicting_overlaps, gener
 	if (overlap_starts.empty()) return false;
 
 	std::vector<const route *> add_overlaps;
-	CheckOverlapConflictIntl(conflicting_overlaps, overlap_starts, add_overlaps, output, 0, 0);
+	CheckOverlapConflictIntl(conflicting_overlaps, overlap_starts, add_overlaps, output, guard, 0, 0);
 	assert(add_overlaps.empty());
 
 	return output.best_score != INT_MIN;
@@ -481,9 +484,18 @@ void future_reserve_track_base::Serialise(serialiser_output &so, error_collectio
 	SerialiseValueJson(rflags, so, "rflags");
 }
 
+struct route_reservation_plan {
+	const route *rt = nullptr;
+	bool already_set = false;    // the route is already set, only approach locking needs cancelling
+	bool resolve_overlap = false;
+	overlap_conflict_resolution overlap_result;
+};
+
 // return true on success
-bool action_reserve_track_base::TryReserveRoute(const route *rt, world_time action_time,
-		std::function<void(const std::shared_ptr<future> &f)> error_handler) const {
+// This does not change the reservation state, fail_reason_key is set on failure
+bool action_reserve_track_base::PlanRouteReservation(const route *rt, route_reservation_plan &plan, std::string &fail_reason_key) const {
+	plan.rt = rt;
+
 	// disallow if non-overlap route already set from start point in given direction
 	// but silently accept if the set route is identical to the one trying to be set
 	bool found_route = false;
@@ -503,22 +515,16 @@ bool action_reserve_track_base::TryReserveRoute(const route *rt, world_time acti
 	}, RRF::RESERVE | RRF::PROVISIONAL_RESERVE);
 	if (found_route) {
 		if (route_conflict) {
-			error_handler(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
-					"track/reservation/fail", "track/reservation/alreadyset"));
+			fail_reason_key = "track/reservation/alreadyset";
 			return false;
 		} else {
-			generic_signal *sig = FastSignalCast(rt->start.track, rt->start.direction);
-			if (sig) {
-				CancelApproachLocking(sig);
-			}
+			plan.already_set = true;
 			return true;
 		}
 	}
 
-	overlap_conflict_resolution route_overlap_result;
-	bool resolve_overlap = false;
-	std::string tryreservation_fail_reason_key = "generic/failurereason";
-	auto result = rt->RouteReservation(RRF::TRY_RESERVE, &tryreservation_fail_reason_key);
+	fail_reason_key = "generic/failurereason";
+	auto result = rt->RouteReservation(RRF::TRY_RESERVE, &fail_reason_key);
 	bool success = result.IsSuccess();
 	if (!success) {
 		bool ok = true;
@@ -541,41 +547,52 @@ bool action_reserve_track_base::TryReserveRoute(const route *rt, world_time acti
 				if (rt->overlap_type != route_class::ID::NONE) {
 					new_overlap_start = FastSignalCast(rt->end.track, rt->end.direction);
 				}
-				if (CheckOverlapConflict(std::move(conflict_overlaps), new_overlap_start, rt->overlap_type, route_overlap_result)) {
+				if (CheckOverlapConflict(std::move(conflict_overlaps), new_overlap_start, rt->overlap_type, plan.overlap_result)) {
 					success = true;
-					resolve_overlap = true;
+					plan.resolve_overlap = true;
 				}
 			}
 		}
 	}
 
 	if (!success) {
-		error_handler(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
-				"track/reservation/fail", tryreservation_fail_reason_key));
 		return false;
 	}
 
-	if (!resolve_overlap && rt->overlap_type != route_class::ID::NONE) {
+	if (!plan.resolve_overlap && rt->overlap_type != route_class::ID::NONE) {
 		// need an overlap too
 		track_reservation_state_backup_guard guard;
 		rt->RouteReservation(RRF::RESERVE | RRF::IGNORE_EXISTING, nullptr, &guard);
-		if (CheckOverlapConflict(std::vector<const route *>(), FastSignalCast(rt->end.track, rt->end.direction), rt->overlap_type, route_overlap_result)) {
-			resolve_overlap = true;
+		if (CheckOverlapConflict(std::vector<const route *>(), FastSignalCast(rt->end.track, rt->end.direction), rt->overlap_type, plan.overlap_result)) {
+			plan.resolve_overlap = true;
 		} else {
-			error_handler(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
-					"track/reservation/fail", "track/reservation/overlap/noneavailable"));
+			fail_reason_key = "track/reservation/overlap/noneavailable";
 			return false;
 		}
 	}
 
+	return true;
+}
+
+void action_reserve_track_base::ExecuteRouteReservation(const route_reservation_plan &plan) const {
+	const route *rt = plan.rt;
+
+	if (plan.already_set) {
+		generic_signal *sig = FastSignalCast(rt->start.track, rt->start.direction);
+		if (sig) {
+			CancelApproachLocking(sig);
+		}
+		return;
+	}
+
 	// route is OK, now reserve it
 
 	auto action_callback = [&](action &&reservation_act) {
 		reservation_act.Execute();
 	};
 
-	if (resolve_overlap) {
-		route_overlap_result.Execute(*this, [&]() {
+	if (plan.resolve_overlap) {
+		plan.overlap_result.Execute(*this, [&]() {
 			rt->RouteReservationActions(RRF::RESERVE, action_callback);
 		});
 	} else {
@@ -583,6 +600,19 @@ bool action_reserve_track_base::TryReserveRoute(const route *rt, world_time acti
 	}
 	ActionRegisterFuture(std::make_shared<future_reserve_track>(*rt->start.track, action_time + 1, rt));
 	rt->RouteReservation(RRF::PROVISIONAL_RESERVE);
+}
+
+// return true on success
+bool action_reserve_track_base::TryReserveRoute(const route *rt, world_time action_time,
+		std::function<void(const std::shared_ptr<future> &f)> error_handler) const {
+	route_reservation_plan plan;
+	std::string fail_reason_key;
+	if (!PlanRouteReservation(rt, plan, fail_reason_key)) {
+		error_handler(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
+				"track/reservation/fail", fail_reason_key));
+		return false;
+	}
+	ExecuteRouteReservation(plan);
 	return true;
 }
 
@@ -743,32 +773,54 @@ action_reserve_path &action_reserve_path::SetVias(via_list vias_) {
 	return *this;
 }
 
-void action_reserve_path::ExecuteAction() const {
+static void DeserialiseViaList(world &w, via_list &vias, const deserialiser_input &di, error_collection &ec) {
+	auto viaparser = [&](const deserialiser_input &di, error_collection &ec) {
+		routing_point *rp = FastRoutingpointCast(w.FindTrackByName(GetType<std::string>(di.json)));
+		if (rp) {
+			vias.push_back(rp);
+		}
+	};
+	vias.clear();
+	CheckIterateJsonArrayOrType<std::string>(di, "vias", "via", ec, viaparser);
+}
+
+static void SerialiseViaList(const via_list &vias, serialiser_output &so) {
+	if (vias.size()) {
+		so.json_out.String("vias");
+		so.json_out.StartArray();
+		for (auto &it : vias) {
+			so.json_out.String(it->GetSerialisationName());
+		}
+		so.json_out.EndArray();
+	}
+}
+
+// return true on success
+// This does not change the reservation state, fail_reason_key is set on failure
+bool action_reserve_track_base::PlanPathReservation(const routing_point *start, const routing_point *end, route_class::set allowed_route_types,
+		GMRF gmr_flags, RRF extra_flags, const via_list &vias, route_reservation_plan &plan, std::string &fail_reason_key) const {
 	if (!start) {
-		ActionSendReplyFuture(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
-				"track/reservation/fail", "track/reservation/notsignal"));
-		return;
+		fail_reason_key = "track/reservation/notsignal";
+		return false;
 	}
 
 	std::vector<routing_point::gmr_route_item> routes;
 	unsigned int routecount = start->GetMatchingRoutes(routes, end, allowed_route_types, gmr_flags, extra_flags, vias);
 
 	if (!routecount) {
-		ActionSendReplyFuture(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
-				"track/reservation/fail", "track/reservation/noroute"));
-		return;
+		fail_reason_key = "track/reservation/noroute";
+		return false;
 	}
 
-	std::vector<std::shared_ptr<future> > failmessages;
+	std::string first_fail_reason_key;
 
 	for (auto it = routes.begin(); it != routes.end(); ++it) {
 		if (it->rt->route_common_flags & route::RCF::EXIT_SIGNAL_CONTROL) {
 			generic_signal *gs = FastSignalCast(it->rt->end.track, it->rt->end.direction);
 			if (gs) {
 				if (gs->GetCurrentForwardRoute()) {
-					ActionSendReplyFuture(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
-							"track/reservation/fail", "track/reservation/routesetfromexitsignal"));
-					return;
+					fail_reason_key = "track/reservation/routesetfromexitsignal";
+					return false;
 				}
 			}
 		}
@@ -781,23 +833,31 @@ void action_reserve_path::ExecuteAction() const {
 			}
 		});
 		if (isbackexitsigroute) {
-			ActionSendReplyFuture(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
-					"track/reservation/fail", "track/reservation/routesettothissignal"));
-			return;
+			fail_reason_key = "track/reservation/routesettothissignal";
+			return false;
 		}
 
-		bool success = TryReserveRoute(it->rt, action_time, [&](const std::shared_ptr<future> &f) {
-			if (it == routes.begin()) {
-				failmessages.push_back(f);
-			}
-		});
-		if (success) {
-			return;
+		plan = route_reservation_plan();
+		if (PlanRouteReservation(it->rt, plan, fail_reason_key)) {
+			return true;
+		}
+		if (it == routes.begin()) {
+			first_fail_reason_key = fail_reason_key;
 		}
 	}
-	for (auto &it : failmessages) {
-		ActionSendReplyFuture(it);
+	fail_reason_key = first_fail_reason_key;
+	return false;
+}
+
+void action_reserve_path::ExecuteAction() const {
+	route_reservation_plan plan;
+	std::string fail_reason_key;
+	if (!PlanPathReservation(start, end, allowed_route_types, gmr_flags, extra_flags, vias, plan, fail_reason_key)) {
+		ActionSendReplyFuture(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
+				"track/reservation/fail", fail_reason_key));
+		return;
 	}
+	ExecuteRouteReservation(plan);
 }
 
 void action_reserve_path::Deserialise(const deserialiser_input &di, error_collection &ec) {
@@ -813,14 +873,7 @@ void action_reserve_path::Deserialise(const deserialiser_input &di, error_collec
 	CheckTransJsonValue(extra_flags, di, "extra_flags", ec);
 	route_class::DeserialiseProp("allowed_route_types", allowed_route_types, di, ec);
 
-	auto viaparser = [&](const deserialiser_input &di, error_collection &ec) {
-		routing_point *rp = FastRoutingpointCast(w.FindTrackByName(GetType<std::string>(di.json)));
-		if (rp) {
-			vias.push_back(rp);
-		}
-	};
-	vias.clear();
-	CheckIterateJsonArrayOrType<std::string>(di, "vias", "via", ec, viaparser);
+	DeserialiseViaList(w, vias, di, ec);
 
 	if (!start) {
 		ec.RegisterNewError<error_deserialisation>(di, "Invalid path reservation action definition");
@@ -834,14 +887,151 @@ void action_reserve_path::Serialise(serialiser_output &so, error_collection &ec)
 	SerialiseValueJson(gmr_flags, so, "gmr_flags");
 	SerialiseValueJson(extra_flags, so, "extra_flags");
 	route_class::SerialiseProp("allowed_route_types", allowed_route_types, so);
-	if (vias.size()) {
-		so.json_out.String("vias");
-		so.json_out.StartArray();
-		for (auto &it : vias) {
-			so.json_out.String(it->GetSerialisationName());
+	SerialiseViaList(vias, so);
+}
+
+action_reserve_batch::reserve_request::reserve_request() : gmr_flags(GMRF::DYNAMIC_PRIORITY) { }
+
+action_reserve_batch &action_reserve_batch::AddRoute(const route &rt) {
+	requests.emplace_back();
+	requests.back().rt = &rt;
+	return *this;
+}
+
+action_reserve_batch &action_reserve_batch::AddPath(const routing_point *start, const routing_point *end, route_class::set allowed_route_types) {
+	return AddPath(start, end, allowed_route_types, GMRF::DYNAMIC_PRIORITY, via_list());
+}
+
+action_reserve_batch &action_reserve_batch::AddPath(const routing_point *start, const routing_point *end, route_class::set allowed_route_types,
+		GMRF gmr_flags, via_list vias) {
+	requests.emplace_back();
+	reserve_request &req = requests.back();
+	req.start = start;
+	req.end = end;
+	req.allowed_route_types = allowed_route_types;
+	req.gmr_flags = gmr_flags;
+	req.vias = std::move(vias);
+	return *this;
+}
+
+void action_reserve_batch::ExecuteAction() const {
+	std::vector<route_reservation_plan> plans;
+	plans.reserve(requests.size());
+
+	{
+		// Accepted routes are reserved under this guard until all requests have been checked,
+		// such that each request is also checked against those before it
+		track_reservation_state_backup_guard guard;
+
+		auto reserve_plan = [&](const route_reservation_plan &plan) -> bool {
+			if (plan.resolve_overlap) {
+				for (auto &it : plan.overlap_result.remove_overlaps) {
+					if (!it->RouteReservation(RRF::UNRESERVE, nullptr, &guard).IsSuccess()) return false;
+				}
+			}
+			if (!plan.rt->RouteReservation(RRF::RESERVE, nullptr, &guard).IsSuccess()) return false;
+			if (plan.resolve_overlap) {
+				for (auto &it : plan.overlap_result.add_overlaps) {
+					if (!it->RouteReservation(RRF::RESERVE, nullptr, &guard).IsSuccess()) return false;
+				}
+			}
+			return true;
+		};
+
+		// An overlap added by an earlier plan only becomes reserved when that plan is executed,
+		// so it cannot also be swung away by a later plan in the same batch
+		auto removes_added_overlap = [&](const route_reservation_plan &plan) -> bool {
+			if (!plan.resolve_overlap) return false;
+			for (auto &it : plan.overlap_result.remove_overlaps) {
+				for (auto &prev : plans) {
+					if (prev.resolve_overlap && std::find(prev.overlap_result.add_overlaps.begin(), prev.overlap_result.add_overlaps.end(), it)
+							!= prev.overlap_result.add_overlaps.end()) {
+						return true;
+					}
+				}
+			}
+			return false;
+		};
+
+		for (auto &req : requests) {
+			route_reservation_plan plan;
+			std::string fail_reason_key;
+			bool ok;
+			if (req.rt) {
+				ok = PlanRouteReservation(req.rt, plan, fail_reason_key);
+			} else {
+				ok = PlanPathReservation(req.start, req.end, req.allowed_route_types, req.gmr_flags, RRF::ZERO, req.vias, plan, fail_reason_key);
+			}
+			if (ok && !plan.already_set) {
+				size_t savepoint = guard.Savepoint();
+				if (removes_added_overlap(plan) || !reserve_plan(plan)) {
+					guard.RollbackTo(savepoint);
+					fail_reason_key = "track/reservation/conflict";
+					ok = false;
+				}
+			}
+			if (ok) {
+				plans.push_back(std::move(plan));
+			} else {
+				ActionSendReplyFuture(std::make_shared<future_generic_user_message_reason>(w, action_time + 1, &w,
+						"track/reservation/fail", fail_reason_key));
+			}
 		}
-		so.json_out.EndArray();
 	}
+
+	// the accepted routes are all compatible with each other
+	for (auto &plan : plans) {
+		ExecuteRouteReservation(plan);
+	}
+}
+
+void action_reserve_batch::Deserialise(const deserialiser_input &di, error_collection &ec) {
+	action_reserve_track_base::Deserialise(di, ec);
+	requests.clear();
+	CheckIterateJsonArrayOrType<json_object>(di, "requests", "reserve_request", ec, [&](const deserialiser_input &innerdi, error_collection &ec) {
+		reserve_request req;
+		std::string targetname;
+		if (CheckTransJsonValue(targetname, innerdi, "start", ec)) {
+			req.start = FastRoutingpointCast(w.FindTrackByName(targetname));
+			if (CheckTransJsonValue(targetname, innerdi, "end", ec)) {
+				req.end = FastRoutingpointCast(w.FindTrackByName(targetname));
+			}
+			CheckTransJsonValue(req.gmr_flags, innerdi, "gmr_flags", ec);
+			route_class::DeserialiseProp("allowed_route_types", req.allowed_route_types, innerdi, ec);
+			DeserialiseViaList(w, req.vias, innerdi, ec);
+		} else {
+			DeserialiseRouteTargetByParentAndIndex(req.rt, innerdi, ec, false);
+		}
+		innerdi.PostDeserialisePropCheck(ec);
+
+		if (!req.rt && !req.start) {
+			ec.RegisterNewError<error_deserialisation>(innerdi, "Invalid batch reservation request definition");
+			return;
+		}
+		requests.push_back(std::move(req));
+	});
+}
+
+void action_reserve_batch::Serialise(serialiser_output &so, error_collection &ec) const {
+	action_reserve_track_base::Serialise(so, ec);
+	so.json_out.String("requests");
+	so.json_out.StartArray();
+	for (auto &it : requests) {
+		so.json_out.StartObject();
+		if (it.rt) {
+			SerialiseRouteTargetByParentAndIndex(it.rt, so, ec);
+		} else if (it.start) {
+			SerialiseValueJson(it.start->GetSerialisationName(), so, "start");
+			if (it.end) {
+				SerialiseValueJson(it.end->GetSerialisationName(), so, "end");
+			}
+			SerialiseValueJson(it.gmr_flags, so, "gmr_flags");
+			route_class::SerialiseProp("allowed_route_types", it.allowed_route_types, so);
+			SerialiseViaList(it.vias, so);
+		}
+		so.json_out.EndObject();
+	}
+	so.json_out.EndArray();
 }
 
 void action_unreserve_track::ExecuteAction() const {
@@ -18,8 +18,11 @@
 
 #include <vector>
 #include <algorithm>
+#include <cassert>
 #include "common.h"
 #include "core/track_reservation.h"
+#include "core/route.h"
+#include "core/route_conflict.h"
 #include "core/track.h"
 #include "core/signal.h"
 #include "core/serialisable_impl.h"
@@ -52,20 +55,76 @@ reservation_result &reservation_result::MergeFrom(const reservation_result &othe
 	return *this;
 }
 
+thread_local std::vector<track_reservation_state_backup_guard::undo_record> track_reservation_state_backup_guard::undo_log;
+thread_local track_reservation_state_backup_guard *track_reservation_state_backup_guard::innermost_guard = nullptr;
+
+track_reservation_state_backup_guard::track_reservation_state_backup_guard()
+		: start(undo_log.size()), outer_guard(innermost_guard) {
+	innermost_guard = this;
+}
+
 track_reservation_state_backup_guard::~track_reservation_state_backup_guard() {
-	for (auto &it : backups) {
-		it.first->itrss = std::move(it.second);
-	}
+	assert(innermost_guard == this);
+	RollbackTo(start);
+	innermost_guard = outer_guard;
 }
 
-reservation_result track_reservation_state::Reservation(const reservation_request_res &req) {
-	auto check_preserve = [&]() {
-		if (!req.backup_guard) return;
+void track_reservation_state_backup_guard::Record(track_reservation_state *trs, unsigned int position, UNDO_OP op,
+		const inner_track_reservation_state &itrs) {
+	assert(innermost_guard == this);
+	undo_log.push_back({ trs, position, op, itrs });
+}
+
+void track_reservation_state_backup_guard::RollbackTo(size_t savepoint) {
+	assert(savepoint >= start && savepoint <= undo_log.size());
 
-		// this does nothing if the backup already contains this track_reservation_state
-		req.backup_guard->backups.emplace(this, itrss);
-	};
+	// routes which were reserved or unreserved under the guard need their route conflict set state updating
+	std::vector<const route *> changed_routes;
+
+	while (undo_log.size() > savepoint) {
+		const undo_record &rec = undo_log.back();
+		std::vector<inner_track_reservation_state> &itrss = rec.trs->itrss;
+
+		// Changes are undone in reverse order, so the recorded position must be exact
+		auto check_position = [&]() -> bool {
+			if (rec.position >= itrss.size()) {
+				return false;
+			}
+			const inner_track_reservation_state &it = itrss[rec.position];
+			return it.reserved_route == rec.itrs.reserved_route && it.direction == rec.itrs.direction && it.index == rec.itrs.index;
+		};
+
+		switch (rec.op) {
+			case UNDO_OP::ADDED:
+				assert(check_position());
+				itrss.erase(itrss.begin() + rec.position);
+				break;
+
+			case UNDO_OP::CHANGED:
+				assert(check_position());
+				itrss[rec.position] = rec.itrs;
+				break;
+
+			case UNDO_OP::REMOVED:
+				assert(rec.position <= itrss.size());
+				itrss.insert(itrss.begin() + rec.position, rec.itrs);
+				break;
+		}
 
+		if (rec.itrs.reserved_route && rec.itrs.reserved_route->conflict_matrix) {
+			changed_routes.push_back(rec.itrs.reserved_route);
+		}
+		undo_log.pop_back();
+	}
+
+	std::sort(changed_routes.begin(), changed_routes.end());
+	changed_routes.erase(std::unique(changed_routes.begin(), changed_routes.end()), changed_routes.end());
+	for (const route *rt : changed_routes) {
+		rt->conflict_matrix->RefreshRoute(*rt);
+	}
+}
+
+reservation_result track_reservation_state::Reservation(const reservation_request_res &req) {
 	reservation_result res;
 	if (req.rr_flags & RRF::RESERVE_MASK) {
 		for (auto &it : itrss) {
@@ -82,7 +141,9 @@ reservation_result track_reservation_state::Reservation(const reservation_reques
 				if (it.reserved_route == req.res_route && (req.rr_flags & RRF::SAVEMASK & ~RRF::RESERVE)
 						== (it.rr_flags & RRF::SAVEMASK & ~RRF::PROVISIONAL_RESERVE)) {
 					//we are now properly reserving what we already preliminarily reserved, reuse inner_track_reservation_state
-					check_preserve();
+					if (req.backup_guard) {
+						req.backup_guard->Record(this, &it - itrss.data(), track_reservation_state_backup_guard::UNDO_OP::CHANGED, it);
+					}
 					it.rr_flags |= RRF::RESERVE;
 					it.rr_flags &= ~RRF::PROVISIONAL_RESERVE;
 					return res;
@@ -91,7 +152,6 @@ reservation_result track_reservation_state::Reservation(const reservation_reques
 		}
 		if (!res.IsSuccess()) return res;
 		if (req.rr_flags & (RRF::RESERVE | RRF::PROVISIONAL_RESERVE)) {
-			check_preserve();
 			itrss.emplace_back();
 			inner_track_reservation_state &itrs = itrss.back();
 
@@ -99,14 +159,27 @@ reservation_result track_reservation_state::Reservation(const reservation_reques
 			itrs.direction = req.direction;
 			itrs.index = req.index;
 			itrs.reserved_route = req.res_route;
+			if (req.backup_guard) {
+				req.backup_guard->Record(this, itrss.size() - 1, track_reservation_state_backup_guard::UNDO_OP::ADDED, itrs);
+			}
+
+			// the end piece is reserved last, the route is now set over its full length
+			if (itrs.rr_flags & RRF::END_PIECE && req.res_route && req.res_route->conflict_matrix) {
+				req.res_route->conflict_matrix->RouteSet(*req.res_route);
+			}
 		}
 		return res;
 	} else if (req.rr_flags & RRF::UNRESERVE_MASK) {
 		for (auto it = itrss.begin(); it != itrss.end(); ++it) {
 			if (it->rr_flags & RRF::RESERVE && it->direction == req.direction && it->index == req.index && it->reserved_route == req.res_route) {
 				if (req.rr_flags & RRF::UNRESERVE) {
-					check_preserve();
+					if (req.backup_guard) {
+						req.backup_guard->Record(this, it - itrss.begin(), track_reservation_state_backup_guard::UNDO_OP::REMOVED, *it);
+					}
 					itrss.erase(it);
+					if (req.res_route && req.res_route->conflict_matrix) {
+						req.res_route->conflict_matrix->RouteUnset(*req.res_route);
+					}
 				}
 				return res;
 			}
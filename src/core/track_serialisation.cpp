@@ -450,11 +450,21 @@ void DeserialiseRouteTargetByParentAndIndex(const route *& output, const deseria
 }
 
 void speed_restriction_set::Deserialise(const deserialiser_input &di, error_collection &ec) {
+	w = di.w;
 	for (rapidjson::SizeType i = 0; i < di.json.Size(); i++) {
 		deserialiser_input subdi(di.json[i], "speed_restriction", MkArrayRefName(i), di);
 		speed_restriction sr;
-		if (subdi.json.IsObject() && CheckTransJsonValueDef(sr.speed_class, subdi, "speed_class", "", ec)
+		std::string speed_class;
+		if (subdi.json.IsObject() && CheckTransJsonValueDef(speed_class, subdi, "speed_class", "", ec)
 				&& CheckTransJsonValueDefProc(sr.speed, subdi, "speed", 0, ec, dsconv::Speed)) {
+			if (speed_class.empty()) {
+				sr.speed_class = 0;
+			} else if (di.w) {
+				sr.speed_class = di.w->InternSpeedClass(speed_class);
+			} else {
+				ec.RegisterNewError<error_deserialisation>(subdi, "Speed class restrictions require a world: " + speed_class);
+				continue;
+			}
 			AddSpeedRestriction(sr);
 			subdi.PostDeserialisePropCheck(ec);
 		} else {
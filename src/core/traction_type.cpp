@@ -22,36 +22,45 @@
 #include "core/traction_type.h"
 #include "core/serialisable_impl.h"
 #include "core/train.h"
+#include "core/world.h"
 
 bool traction_set::CanTrainPass(const train *t) const {
 	const traction_set &ts = t->GetActiveTractionTypes();
-	for (auto &it : ts.tractions) {
-		if (it->always_available) {
-			return true;
-		}
-		if (HasTraction(it)) {
+	return ts.IsIntersecting(*this) || ts.IsIntersecting(t->GetWorld().GetAlwaysAvailableTractionTypes());
+}
+
+bool traction_set::IsOverflowIntersecting(const traction_set &ts) const {
+	size_t count = std::min(overflow.size(), ts.overflow.size());
+	for (size_t i = 0; i < count; i++) {
+		if (overflow[i] & ts.overflow[i]) {
 			return true;
 		}
 	}
 	return false;
 }
 
-bool traction_set::HasTraction(const traction_type *tt) const {
-	return std::find(tractions.begin(), tractions.end(), tt) != tractions.end();
-}
-
-bool traction_set::IsIntersecting(const traction_set &ts) const {
-	for (auto &it : tractions) {
-		if (ts.HasTraction(it)) {
-			return true;
-		}
+void traction_set::RemoveTractionType(traction_type *type) {
+	if (!HasTraction(type)) {
+		return;
 	}
-	return false;
+	if (type->id < 64) {
+		bits &= ~(((uint64_t) 1) << type->id);
+	} else {
+		overflow[(type->id / 64) - 1] &= ~(((uint64_t) 1) << (type->id % 64));
+	}
+	tractions.erase(std::remove(tractions.begin(), tractions.end(), type), tractions.end());
 }
 
 void traction_set::IntersectWith(const traction_set &ts) {
+	bits &= ts.bits;
+	if (overflow.size() > ts.overflow.size()) {
+		overflow.resize(ts.overflow.size());
+	}
+	for (size_t i = 0; i < overflow.size(); i++) {
+		overflow[i] &= ts.overflow[i];
+	}
 	container_unordered_remove_if(tractions, [&](traction_type *tt) {
-		return !ts.HasTraction(tt);
+		return !HasTraction(tt);
 	});
 }
 
@@ -71,9 +80,7 @@ void traction_set::Deserialise(const deserialiser_input &di, error_collection &e
 		if (cur.IsString() && di.w) {
 			traction_type *tt = di.w->GetTractionTypeByName(cur.GetString());
 			if (tt) {
-				if (!HasTraction(tt)) {
-					tractions.push_back(tt);
-				}
+				AddTractionType(tt);
 			} else {
 				ec.RegisterNewError<error_deserialisation>(di, string_format("No such traction type: \"%s\"", cur.GetString()));
 			}
@@ -24,6 +24,7 @@
 #include "core/traverse.h"
 #include "core/world.h"
 
+#include <algorithm>
 #include <cassert>
 
 train::train(world &w_) : world_obj(w_) {
@@ -39,11 +40,6 @@ inline int CalcGravityForce(unsigned int total_mass, int elevationdecrease, unsi
 	return (int) ((((int64_t) (9810 * elevationdecrease)) * ((int64_t) total_mass)) / ((int64_t) length));
 }
 
-inline int CalcDrag(unsigned int drag_const, unsigned int drag_v, unsigned int drag_v_2, unsigned int v) {
-	return drag_const + (((uint64_t) v) * ((uint64_t) drag_v)) / ((uint64_t) 1000)
-			+ (((uint64_t) v) * ((uint64_t) v) * ((uint64_t) drag_v_2)) / ((uint64_t) 1000000);
-}
-
 // returns true if need for speed control
 // Parameters:
 // IN     brake_deceleration    m/(s^2) << 8            Maximum positive deceleration
@@ -53,8 +49,11 @@ inline int CalcDrag(unsigned int drag_const, unsigned int drag_v, unsigned int d
 // IN     target_distance       mm                      Distance to start of target speed
 // OUT    brake_speed           mm/s                    The ideal speed to brake to (if return true)
 // OUT    displacement_limit    mm                      Limit the displacement in this step (if return true)
+// IN     cache                                         Optional braking profile cache, if null the brake speed is calculated exactly
+// IN     mode                                          Braking profile mode to use with cache
 bool CheckCalculateProjectedBrakingSpeed(unsigned int brake_deceleration, unsigned int target_speed, unsigned int current_max_speed,
-		unsigned int brake_threshold_speed, unsigned int target_distance, unsigned int &brake_speed, unsigned int &displacement_limit) {
+		unsigned int brake_threshold_speed, unsigned int target_distance, unsigned int &brake_speed, unsigned int &displacement_limit,
+		train_braking_profile_cache *cache = nullptr, BRAKING_PROFILE_MODE mode = BRAKING_PROFILE_MODE::STRICT) {
 
 	// v^2 = u^2 + 2as
 	// (2000 * (m/(s^2) << 8) * mm) >> 8 --> 2000 * m/(s^2) * mm --> 2 * mm/(s^2) * mm --> 2 * (mm/s)^2
@@ -76,19 +75,160 @@ bool CheckCalculateProjectedBrakingSpeed(unsigned int brake_deceleration, unsign
 			}
 		}
 		return true;
+	} else if (cache) {
+		brake_speed = std::max(cache->GetBrakeSpeed(mode, brake_deceleration, target_speed, target_distance, vsq), brake_threshold_speed);
+		return true;
 	} else {
 		brake_speed = (unsigned int) fast_isqrt(vsq);
 		return true;
 	}
 }
 
+constexpr unsigned int train_braking_profile_cache::DECEL_BUCKET;
+constexpr unsigned int train_braking_profile_cache::SPEED_STEP;
+constexpr unsigned int train_braking_profile_cache::MAX_PROFILES;
+
+train_braking_profile_cache::profile &train_braking_profile_cache::GetProfile(unsigned int decel_bucket, unsigned int target_speed, bool &found) {
+	use_counter++;
+	profile *lru = nullptr;
+	for (auto &it : profiles) {
+		if (it.decel_bucket == decel_bucket && it.target_speed == target_speed) {
+			it.last_use = use_counter;
+			found = true;
+			return it;
+		}
+		if (!lru || it.last_use < lru->last_use) {
+			lru = &it;
+		}
+	}
+
+	found = false;
+	if (profiles.size() < MAX_PROFILES) {
+		profiles.emplace_back(decel_bucket, target_speed);
+		lru = &profiles.back();
+	} else {
+		*lru = profile(decel_bucket, target_speed);
+	}
+	lru->last_use = use_counter;
+	return *lru;
+}
+
+unsigned int train_braking_profile_cache::TableLookup(profile &p, unsigned int target_distance) {
+	// As in CheckCalculateProjectedBrakingSpeed, but in mm << 8 such that rounding the distances up has no significant effect on the result
+	// d = (v^2 - u^2) / 2a --> ((mm/s)^2 << 16) / (2000 * (m/(s^2) << 8)) --> mm << 8
+	const uint64_t divisor = ((uint64_t) 2000) * ((uint64_t) p.decel_bucket);
+	const uint64_t target_speed_sq = ((uint64_t) p.target_speed) * ((uint64_t) p.target_speed);
+	const uint64_t distance = ((uint64_t) target_distance) << 8;
+
+	if (p.distances.empty()) {
+		p.distances.push_back(0);
+	}
+	while (p.distances.back() <= distance) {
+		uint64_t speed = p.target_speed + (p.distances.size() * SPEED_STEP);
+		p.distances.push_back((((speed * speed) - target_speed_sq) << 16) / divisor + 1);
+	}
+
+	// Interpolating between points on or after the braking curve, which is concave, never gives a speed greater than the curve
+	size_t index = std::upper_bound(p.distances.begin(), p.distances.end(), distance) - p.distances.begin() - 1;
+	uint64_t from = p.distances[index];
+	uint64_t to = p.distances[index + 1];
+	return p.target_speed + (index * SPEED_STEP) + (unsigned int) ((SPEED_STEP * (distance - from)) / (to - from));
+}
+
+unsigned int train_braking_profile_cache::GetBrakeSpeed(BRAKING_PROFILE_MODE mode, unsigned int brake_deceleration, unsigned int target_speed,
+		unsigned int target_distance, uint64_t vsq) {
+	unsigned int decel_bucket = 0;
+	if (mode == BRAKING_PROFILE_MODE::TABLE) {
+		// Round down, such that the table never overestimates the braking capability
+		decel_bucket = brake_deceleration - (brake_deceleration % DECEL_BUCKET);
+	}
+
+	bool found;
+	profile &p = GetProfile(decel_bucket, target_speed, found);
+	if (decel_bucket) {
+		p.last_brake_speed = TableLookup(p, target_distance);
+	} else if (found) {
+		p.last_brake_speed = (unsigned int) seeded_isqrt<uint64_t>(vsq, p.last_brake_speed);
+	} else {
+		p.last_brake_speed = (unsigned int) fast_isqrt(vsq);
+	}
+	return p.last_brake_speed;
+}
+
 void train::TrainTimeStep(unsigned int ms) {
 	if (!train_segments.empty()) {
-		TrainMoveStep(ms);
+		TrainMovePrepare(ms);
+		TrainMoveCommit();
+	}
+}
+
+void train::TrainTimeStepPrepare(unsigned int ms) {
+	if (!train_segments.empty()) {
+		TrainMovePrepare(ms);
 	}
 }
 
-void train::TrainMoveStep(unsigned int ms) {
+void train::TrainTimeStepCommit() {
+	if (tflags & TF::PENDING_MOVE) {
+		TrainMoveCommit();
+	}
+}
+
+bool train::IsPendingMoveScanned() const {
+	return tflags & TF::PENDING_MOVE_SCANNED;
+}
+
+bool train::IsHeld() const {
+	return train_segments.empty() || tflags & TF::HELD;
+}
+
+bool train::IsFreeRunning() const {
+	return tflags & TF::FREE_RUNNING;
+}
+
+// Returns true if checking the lookahead can be skipped at this step
+bool train::CheckFreeRunning(int min_acceleration) {
+	if (!(tflags & TF::FREE_RUNNING)) {
+		return false;
+	}
+	if (!GetWorld().IsTrainFreeRunningEnabled() || la.GetCurrentOffset() > free_run.end_offset ||
+			current_max_speed != free_run.max_speed || -min_acceleration < free_run.brake_deceleration) {
+		tflags &= ~TF::FREE_RUNNING;
+		return false;
+	}
+	uint64_t generation = GetWorld().GetRoutingStateGeneration();
+	if (generation != free_run.routing_generation) {
+		//something has changed somewhere, check whether it is anything in the lookahead
+		if (!la.IsSightedRoutingUnchanged()) {
+			tflags &= ~TF::FREE_RUNNING;
+			return false;
+		}
+		free_run.routing_generation = generation;
+	}
+	return true;
+}
+
+void train::SaveStepState(train_step_state &state) {
+	state.current_speed = current_speed;
+	state.flags = static_cast<unsigned int>(tflags);
+	state.red_sig_wait_start_time = red_sig_wait_start_time;
+	la.StartUndoRecording(state.la);
+	state.free_run = free_run;
+}
+
+void train::EndSaveStepState() {
+	la.StopUndoRecording();
+}
+
+void train::RestoreStepState(train_step_state &state) {
+	current_speed = state.current_speed;
+	tflags = static_cast<TF>(state.flags);
+	red_sig_wait_start_time = state.red_sig_wait_start_time;
+	la.Undo(state.la);
+	free_run = state.free_run;
+}
+
+void train::TrainMovePrepare(unsigned int ms) {
 	int slopeforce = CalcGravityForce(total_mass, tail_relative_height - head_relative_height, total_length);
 	int dragforce = CalcDrag(total_drag_const, total_drag_v, total_drag_v2, current_speed);
 
@@ -121,45 +261,79 @@ void train::TrainMoveStep(unsigned int ms) {
 	int target_speed = std::min((int) current_max_speed, max_new_speed);
 	unsigned int displacement_limit = UINT_MAX;
 
-	auto lookaheadfunc = [&](unsigned int distance, unsigned int speed) {
-		unsigned int brake_speed;
-		unsigned int local_displacement_limit;
-		if (CheckCalculateProjectedBrakingSpeed(-min_acceleration, speed, target_speed, CREEP_SPEED, distance, brake_speed, local_displacement_limit)) {
-			if ((int) brake_speed < target_speed) {
-				target_speed = brake_speed;
+	bool waitingatredsig = false;
+	unsigned int prev_scan_count = la.GetScanCount();
+
+	if (!CheckFreeRunning(min_acceleration)) {
+		const unsigned int max_speed = current_max_speed;
+		bool can_free_run = GetWorld().IsTrainFreeRunningEnabled() && min_acceleration < 0;
+		uint64_t free_run_distance = UINT64_MAX;
+
+		auto lookaheadfunc = [&](unsigned int distance, unsigned int speed) {
+			unsigned int brake_speed;
+			unsigned int local_displacement_limit;
+			if (CheckCalculateProjectedBrakingSpeed(-min_acceleration, speed, target_speed, CREEP_SPEED, distance, brake_speed, local_displacement_limit,
+					&braking_profiles, GetWorld().GetBrakingProfileMode())) {
+				if ((int) brake_speed < target_speed) {
+					target_speed = brake_speed;
+				}
+				if (displacement_limit > local_displacement_limit) {
+					displacement_limit = local_displacement_limit;
+				}
 			}
-			if (displacement_limit > local_displacement_limit) {
-				displacement_limit = local_displacement_limit;
+			if (can_free_run && speed < max_speed) {
+				// minimum distance from which CheckCalculateProjectedBrakingSpeed cannot limit the speed below max_speed
+				// ((mm/s)^2 << 8) / (2000 * (m/(s^2) << 8)) --> mm
+				uint64_t vsq_delta = (((uint64_t) max_speed) * ((uint64_t) max_speed)) - (((uint64_t) speed) * ((uint64_t) speed));
+				uint64_t divisor = ((uint64_t) 2000) * ((uint64_t) -min_acceleration);
+				uint64_t min_distance = ((vsq_delta << 8) + divisor - 1) / divisor;
+				if (distance < min_distance) {
+					can_free_run = false;
+				} else if (distance - min_distance < free_run_distance) {
+					free_run_distance = distance - min_distance;
+				}
 			}
-		}
-	};
+		};
 
-	bool waitingatredsig = false;
+		auto lookaheaderrorfunc = [&](lookahead::LA_ERROR err, const track_target_ptr &piece) {
+			switch (err) {
+				case lookahead::LA_ERROR::NONE:
+					break;
 
-	auto lookaheaderrorfunc = [&](lookahead::LA_ERROR err, const track_target_ptr &piece) {
-		switch (err) {
-			case lookahead::LA_ERROR::NONE:
-				break;
+				case lookahead::LA_ERROR::SIG_TARGET_CHANGE:
+					//TODO: fill this in
+					break;
 
-			case lookahead::LA_ERROR::SIG_TARGET_CHANGE:
-				//TODO: fill this in
-				break;
+				case lookahead::LA_ERROR::SIG_ASPECT_LESS_THAN_EXPECTED:
+					//TODO: fill this in
+					break;
 
-			case lookahead::LA_ERROR::SIG_ASPECT_LESS_THAN_EXPECTED:
-				//TODO: fill this in
-				break;
+				case lookahead::LA_ERROR::WAITING_AT_RED_SIG:
+					waitingatredsig = true;
+					break;
 
-			case lookahead::LA_ERROR::WAITING_AT_RED_SIG:
-				waitingatredsig = true;
-				break;
+				case lookahead::LA_ERROR::TRACTION_UNSUITABLE:
+					//TODO: fill this in
+					break;
+			}
+		};
 
-			case lookahead::LA_ERROR::TRACTION_UNSUITABLE:
-				//TODO: fill this in
-				break;
-		}
-	};
+		la.CheckLookaheads(this, head_pos, lookaheadfunc, lookaheaderrorfunc);
 
-	la.CheckLookaheads(this, head_pos, lookaheadfunc, lookaheaderrorfunc);
+		if (can_free_run) {
+			// the lookahead may change when the next routing point or points are sighted
+			uint64_t current_offset = la.GetCurrentOffset();
+			uint64_t end_offset = la.GetNextSightingOffset() - 1;
+			if (free_run_distance < end_offset - current_offset) {
+				end_offset = current_offset + free_run_distance;
+			}
+			free_run.end_offset = end_offset;
+			free_run.routing_generation = GetWorld().GetRoutingStateGeneration();
+			free_run.max_speed = max_speed;
+			free_run.brake_deceleration = -min_acceleration;
+			tflags |= TF::FREE_RUNNING;
+		}
+	}
 
 	if (waitingatredsig && current_speed == 0) {
 		if (!(tflags & TF::WAITING_AT_RED_SIG)) {
@@ -178,6 +352,22 @@ void train::TrainMoveStep(unsigned int ms) {
 	if (displacement > displacement_limit)
 		displacement = displacement_limit;
 
+	pending_displacement = displacement;
+	tflags |= TF::PENDING_MOVE;
+	if (prev_speed == 0 && displacement_limit == 0) {
+		tflags |= TF::HELD;
+	} else {
+		tflags &= ~TF::HELD;
+	}
+	if (la.GetScanCount() != prev_scan_count) {
+		tflags |= TF::PENDING_MOVE_SCANNED;
+	}
+}
+
+void train::TrainMoveCommit() {
+	tflags &= ~(TF::PENDING_MOVE | TF::PENDING_MOVE_SCANNED);
+	unsigned int displacement = pending_displacement;
+
 	int head_elevation_delta, tail_elevation_delta;
 
 	AdvanceDisplacement(displacement, head_pos, &head_elevation_delta, [this](track_location &old_track, track_location &new_track) {
@@ -186,12 +376,16 @@ void train::TrainMoveStep(unsigned int ms) {
 	AdvanceDisplacement(displacement, tail_pos, &tail_elevation_delta, [this](track_location &old_track, track_location &new_track) {
 		old_track.GetTrack()->TrainLeave(old_track.GetDirection(), this);
 	});
+	position_generation++;
 	head_relative_height += head_elevation_delta;
 	tail_relative_height += tail_elevation_delta;
 	la.Advance(displacement);
 }
 
 void train::CalculateTrainMotionProperties(unsigned int weather_factor_shl8) {
+	tflags &= ~(TF::HELD | TF::FREE_RUNNING);
+	braking_profiles.Clear();
+	projection.Invalidate();
 	total_length = 0;
 	total_drag_const = 0;
 	total_drag_v = 0;
@@ -201,9 +395,11 @@ void train::CalculateTrainMotionProperties(unsigned int weather_factor_shl8) {
 	total_tractive_power = 0;
 	total_braking_force = 0;
 	veh_max_speed = 0;
-	current_max_speed = 0;
 
-	if (train_segments.begin() == train_segments.end()) return;    //train with no carriages
+	if (train_segments.begin() == train_segments.end()) {    //train with no carriages
+		CalculateCoveredTrackSpeedLimit();
+		return;
+	}
 
 	for (auto it = train_segments.begin(); it != train_segments.end(); ++it) {
 		total_length += it->veh_type->length * it->veh_multiplier;
@@ -229,50 +425,57 @@ void train::CalculateTrainMotionProperties(unsigned int weather_factor_shl8) {
 	}
 	total_drag_v2 += train_segments.front().veh_type->face_drag_v2;
 	total_drag_v2 += train_segments.back().veh_type->face_drag_v2;
+
+	CalculateCoveredTrackSpeedLimit();
+}
+
+void train_track_speed_limit_set::Add(unsigned int speed) {
+	auto it = std::lower_bound(items.begin(), items.end(), speed, [](const train_track_speed_limit_item &item, unsigned int speed) {
+		return item.speed < speed;
+	});
+	if (it != items.end() && it->speed == speed) {
+		it->count++;
+	} else {
+		items.emplace(it, speed, 1);
+	}
 }
 
+bool train_track_speed_limit_set::Remove(unsigned int speed) {
+	auto it = std::lower_bound(items.begin(), items.end(), speed, [](const train_track_speed_limit_item &item, unsigned int speed) {
+		return item.speed < speed;
+	});
+	if (it == items.end() || it->speed != speed) {
+		return false;
+	}
+	it->count--;
+	if (it->count == 0) {
+		items.erase(it);
+	}
+	return true;
+}
+
+// Limits are stored without capping to the vehicle maximum speed, such that they remain valid if it changes.
+// If the speed class changes, the stored limits are recalculated by RefreshCoveredTrackSpeedLimits.
 void train::AddCoveredTrackSpeedLimit(unsigned int speed) {
-	if (speed >= veh_max_speed) {
+	if (speed == UINT_MAX) {
 		return;
 	}
-	for (auto &it : covered_track_speed_limits) {
-		if (it.speed == speed) {
-			it.count++;
-			return;
-		}
-	}
-	covered_track_speed_limits.emplace_front(speed, 1);
+	covered_track_speed_limits.Add(speed);
 	CalculateCoveredTrackSpeedLimit();
 }
+
 void train::RemoveCoveredTrackSpeedLimit(unsigned int speed) {
-	if (speed >= veh_max_speed) {
-		return;
-	}
-	auto prev_it = covered_track_speed_limits.before_begin();
-	auto it = prev_it;
-	++it;
-	for (; it != covered_track_speed_limits.end(); prev_it = it, ++it) {
-		if (it->speed == speed) {
-			it->count--;
-			if (it->count == 0) {
-				covered_track_speed_limits.erase_after(prev_it);    //this invalidates iterator it
-				CalculateCoveredTrackSpeedLimit();
-			}
-			return;
-		}
+	if (covered_track_speed_limits.Remove(speed)) {
+		CalculateCoveredTrackSpeedLimit();
 	}
 }
 
 void train::CalculateCoveredTrackSpeedLimit() {
-	current_max_speed = veh_max_speed;
-	for (auto it = covered_track_speed_limits.begin(); it != covered_track_speed_limits.begin(); ++it) {
-		if (it->speed < current_max_speed) {
-			current_max_speed = it->speed;
-		}
-	}
+	current_max_speed = std::min(veh_max_speed, covered_track_speed_limits.GetLowest());
 }
 
 void train::ReverseDirection() {
+	tflags &= ~(TF::HELD | TF::FREE_RUNNING);
 	tflags ^= TF::CONSIST_REV_DIR;
 
 	track_location new_head = tail_pos;
@@ -281,17 +484,24 @@ void train::ReverseDirection() {
 
 	tail_pos.ReverseDirection();
 	head_pos.ReverseDirection();
+	position_generation++;
 
 	unsigned int new_head_height = tail_relative_height;
 	tail_relative_height = head_relative_height;
 	head_relative_height = new_head_height;
 
 	la.Init(this, head_pos);
+	projection.Invalidate();
 }
 
+bool train::UpdateProjection() {
+	return projection.Update(*this, GetWorld().GetGameTime());
+}
+
+// The covered limits are otherwise maintained as the train enters and leaves track pieces,
+// this rescans the whole length of the train, for use when the speed class of the train changes.
 void train::RefreshCoveredTrackSpeedLimits() {
-	covered_track_speed_limits.clear();
-	CalculateCoveredTrackSpeedLimit();
+	covered_track_speed_limits.Clear();
 
 	track_location local_backtrack_pos = head_pos;
 	local_backtrack_pos.ReverseDirection();
@@ -299,7 +509,7 @@ void train::RefreshCoveredTrackSpeedLimits() {
 	auto func = [this](track_location &old_track, track_location &new_track) {
 		const speed_restriction_set *speeds = new_track.GetTrack()->GetSpeedRestrictions();
 		if (speeds) {
-			this->AddCoveredTrackSpeedLimit(speeds->GetTrainTrackSpeedLimit(this));
+			this->AddCoveredTrackSpeedLimit(speeds->GetTrainClassTrackSpeedLimit(this));
 		}
 	};
 
@@ -308,6 +518,8 @@ void train::RefreshCoveredTrackSpeedLimits() {
 	AdvanceDisplacement(total_length, local_backtrack_pos, 0, func);
 	local_backtrack_pos.ReverseDirection();
 	assert(local_backtrack_pos == tail_pos);
+
+	CalculateCoveredTrackSpeedLimit();
 }
 
 class error_droptrainintoposition : public error_obj {
@@ -318,7 +530,9 @@ class error_droptrainintoposition : public error_obj {
 };
 
 void train::DropTrainIntoPosition(const track_location &position, error_collection &ec) {
+	tflags &= ~(TF::HELD | TF::FREE_RUNNING);
 	tail_relative_height = head_relative_height = 0;
+	covered_track_speed_limits.Clear();    // refilled by TrainEnter below
 
 	head_pos = position;
 	tail_pos = position;
@@ -333,10 +547,15 @@ void train::DropTrainIntoPosition(const track_location &position, error_collecti
 	flagwrapper<ADRESULTF> ad_result_flags;
 	unsigned int leftover = AdvanceDisplacement(total_length, tail_pos, &tail_relative_height, func, ADF::CHECK_FOR_TRAINS, &ad_result_flags);
 
+	tail_pos.ReverseDirection();
+	position_generation++;
+
+	//include the last track piece, this is done after tail_pos is final, such that the piece sees the train's correct occupation
+	track_location last = tail_pos;
+	last.ReverseDirection();
 	track_location temp;
-	func(tail_pos, temp);    //include the last track piece
+	func(last, temp);
 
-	tail_pos.ReverseDirection();
 	if (leftover) {
 		ec.RegisterNewError<error_droptrainintoposition>(this, position,
 				string_format("Insufficient track to drop train: tail at: (%s), leftover: %umm",
@@ -344,12 +563,14 @@ void train::DropTrainIntoPosition(const track_location &position, error_collecti
 		return;
 	}
 
-	RefreshCoveredTrackSpeedLimits();
+	CalculateCoveredTrackSpeedLimit();
 
 	la.Init(this, head_pos);
+	projection.Invalidate();
 }
 
 void train::UprootTrain(error_collection &ec) {
+	tflags &= ~(TF::HELD | TF::FREE_RUNNING);
 
 	auto func = [this](track_location &old_track, track_location &new_track) {
 		new_track.GetTrack()->TrainLeave(new_track.GetTrack()->GetReverseDirection(new_track.GetDirection()), this);
@@ -361,7 +582,9 @@ void train::UprootTrain(error_collection &ec) {
 
 	tail_relative_height = head_relative_height = 0;
 	tail_pos = head_pos = track_location();
+	position_generation++;
 	la.Clear();
+	projection.Invalidate();
 }
 
 traction_set train::GetAllTractionTypes() const {
@@ -376,8 +599,16 @@ void train::ValidateActiveTractionSet() {
 	active_tractions.IntersectWith(GetAllTractionTypes());
 }
 
+bool train::SetName(const std::string &newname) {
+	if (!GetWorld().RenameTrain(this, newname)) {
+		return false;
+	}
+	world_obj::SetName(newname);
+	return true;
+}
+
 void train::GenerateName() {
-	size_t id = reinterpret_cast<size_t>(this);
+	size_t id = train_id;
 	std::string name;
 	do {
 		name = "train_" + std::to_string(GetWorld().GetLoadCount()) + "_" + std::to_string(GetWorld().GetGameTime()) + "_" + std::to_string(id);
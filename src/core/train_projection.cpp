@@ -0,0 +1,228 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2013 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#include "common.h"
+#include "core/train_projection.h"
+#include "core/train.h"
+#include "core/signal.h"
+#include "core/param.h"
+#include "util/util.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+constexpr unsigned int train_projection::MAX_POINTS;
+constexpr unsigned int train_projection::DISTANCE_STEP;
+constexpr unsigned int train_projection::SPEED_TOLERANCE;
+constexpr unsigned int train_projection::TIME_TOLERANCE;
+
+static unsigned int ProjectedSpeed(uint64_t speed_sq) {
+	return speed_sq ? (unsigned int) fast_isqrt(speed_sq) : 0;
+}
+
+void train_projection::Project(const train &t, world_time now) {
+	const lookahead &la = t.GetLookahead();
+	const train_dynamics &td = t.GetTrainDynamics();
+	const train_motion_state &tms = t.GetTrainMotionState();
+
+	projection_count++;
+	valid = true;
+	base_offset = la.GetCurrentOffset();
+	base_time = now;
+	scan_count = la.GetScanCount();
+	max_speed = tms.current_max_speed;
+	points.clear();
+
+	struct speed_limit {
+		uint64_t start;
+		uint64_t end;
+		unsigned int speed;
+	};
+	std::vector<speed_limit> limits;
+	uint64_t horizon = 0;
+	uint64_t stop = UINT64_MAX;
+
+	auto add_point = [&](const track_target_ptr &target, bool is_berth, uint64_t offset) {
+		if (points.size() < MAX_POINTS) {
+			points.push_back(train_projection_point { target, is_berth, offset, 0, 0 });
+		}
+	};
+
+	la.EnumerateScanned([&](uint64_t start, uint64_t end, unsigned int speed, const track_target_ptr &piece) {
+		if (end <= base_offset) {
+			return;
+		}
+		uint64_t rel_start = start > base_offset ? start - base_offset : 0;
+		uint64_t rel_end = end - base_offset;
+		horizon = std::max(horizon, rel_end);
+		if (speed == 0) {
+			stop = std::min(stop, rel_start);
+		} else if (speed != UINT_MAX) {
+			//the limit applies until the tail of the train has left the piece
+			limits.push_back(speed_limit { rel_start, rel_end + td.total_length, speed });
+		}
+		if (start >= base_offset && piece.track->HasBerth(piece.direction)) {
+			add_point(piece, true, start);
+		}
+	}, [&](uint64_t offset, const vartrack_target_ptr<routing_point> &rp, unsigned int aspect) {
+		if (offset < base_offset) {
+			return;
+		}
+		horizon = std::max(horizon, offset - base_offset);
+		if (aspect == 0) {
+			stop = std::min(stop, offset - base_offset);
+		}
+		add_point(track_target_ptr(rp.track, rp.direction), false, offset);
+	});
+
+	//nothing is known beyond the end of the lookahead, so assume that the train must stop there
+	profile_length = std::min(horizon, stop);
+	size_t nodes = (size_t) ((profile_length + DISTANCE_STEP - 1) / DISTANCE_STEP) + 1;
+	auto node_distance = [&](size_t k) -> uint64_t {
+		return std::min(((uint64_t) k) * DISTANCE_STEP, profile_length);
+	};
+
+	//speed ceiling at each node
+	profile_speed.assign(nodes, td.veh_max_speed);
+	for (size_t k = 0; k < nodes && node_distance(k) < td.total_length; k++) {
+		profile_speed[k] = std::min(profile_speed[k], tms.current_max_speed);
+	}
+	for (auto &it : limits) {
+		size_t last = std::min<uint64_t>((it.end + DISTANCE_STEP - 1) / DISTANCE_STEP, nodes - 1);
+		for (size_t k = it.start / DISTANCE_STEP; k <= last; k++) {
+			profile_speed[k] = std::min(profile_speed[k], it.speed);
+		}
+	}
+	profile_speed[nodes - 1] = 0;
+
+	// mm/s^2
+	unsigned int mass = td.total_mass ? td.total_mass : 1;
+	const uint64_t accel_cap = (((uint64_t) ACCEL_BRAKE_CAP) * 1000) >> 8;
+	const uint64_t brake = std::min<uint64_t>((((uint64_t) td.total_braking_force) * 1000) / mass, accel_cap);
+
+	//braking curves back from lower speeds ahead
+	for (size_t k = nodes - 1; k > 0; k--) {
+		uint64_t step = node_distance(k) - node_distance(k - 1);
+		uint64_t speed = profile_speed[k];
+		profile_speed[k - 1] = std::min(profile_speed[k - 1], ProjectedSpeed((speed * speed) + (2 * brake * step)));
+	}
+
+	//acceleration forwards from the current speed
+	profile_speed[0] = tms.current_speed;
+	for (size_t k = 0; k + 1 < nodes; k++) {
+		uint64_t speed = profile_speed[k];
+		int force = td.total_tractive_force;
+		if (speed) {
+			force = std::min(force, (int) ((1000 * ((uint64_t) td.total_tractive_power)) / speed));
+		}
+		force -= CalcDrag(td.total_drag_const, td.total_drag_v, td.total_drag_v2, speed);
+		if (force > 0) {
+			uint64_t accel = std::min<uint64_t>((((uint64_t) force) * 1000) / mass, accel_cap);
+			uint64_t step = node_distance(k + 1) - node_distance(k);
+			profile_speed[k + 1] = std::min(profile_speed[k + 1], ProjectedSpeed((speed * speed) + (2 * accel * step)));
+		} else {
+			profile_speed[k + 1] = std::min(profile_speed[k + 1], (unsigned int) speed);
+		}
+	}
+
+	profile_time.assign(nodes, UINT64_MAX);
+	profile_time[0] = 0;
+	for (size_t k = 0; k + 1 < nodes; k++) {
+		uint64_t speed_sum = ((uint64_t) profile_speed[k]) + ((uint64_t) profile_speed[k + 1]);
+		if (!speed_sum) {
+			break;    //stationary, the rest of the profile cannot be reached
+		}
+		// mm * 2000 / (mm/s) --> ms, using the mean speed over the step
+		profile_time[k + 1] = profile_time[k] + (((node_distance(k + 1) - node_distance(k)) * 2000) / speed_sum);
+	}
+
+	size_t reachable = 0;
+	for (auto &it : points) {
+		uint64_t time;
+		if (!Lookup(it.offset - base_offset, it.speed, time)) {
+			break;
+		}
+		it.eta = base_time + (world_time) time;
+		reachable++;
+	}
+	points.resize(reachable);
+}
+
+// distance is from base_offset, time is from base_time
+bool train_projection::Lookup(uint64_t distance, unsigned int &speed, uint64_t &time) const {
+	if (distance > profile_length) {
+		return false;
+	}
+	size_t k = (size_t) (distance / DISTANCE_STEP);
+	if (k + 1 >= profile_speed.size()) {
+		k = profile_speed.size() - 1;
+		speed = profile_speed[k];
+		time = profile_time[k];
+		return time != UINT64_MAX;
+	}
+	uint64_t start = ((uint64_t) k) * DISTANCE_STEP;
+	uint64_t step = std::min<uint64_t>(start + DISTANCE_STEP, profile_length) - start;
+	uint64_t part = distance - start;
+	if (profile_time[k] == UINT64_MAX || (part && profile_time[k + 1] == UINT64_MAX)) {
+		return false;
+	}
+	if (!part) {
+		speed = profile_speed[k];
+		time = profile_time[k];
+		return true;
+	}
+	speed = profile_speed[k] + (unsigned int) ((((int64_t) profile_speed[k + 1] - (int64_t) profile_speed[k]) * (int64_t) part) / (int64_t) step);
+	time = profile_time[k] + (((profile_time[k + 1] - profile_time[k]) * part) / step);
+	return true;
+}
+
+bool train_projection::Update(const train &t, world_time now) {
+	const lookahead &la = t.GetLookahead();
+	const train_motion_state &tms = t.GetTrainMotionState();
+	uint64_t current = la.GetCurrentOffset();
+	if (!valid || la.GetScanCount() != scan_count || tms.current_max_speed != max_speed || current < base_offset) {
+		Project(t, now);
+		return true;
+	}
+
+	unsigned int speed;
+	uint64_t time;
+	if (!Lookup(current - base_offset, speed, time)
+			|| (unsigned int) std::abs((int) speed - (int) tms.current_speed) > SPEED_TOLERANCE
+			|| (unsigned int) std::abs((int64_t) (base_time + time) - (int64_t) now) > TIME_TOLERANCE) {
+		Project(t, now);
+		return true;
+	}
+
+	size_t passed = 0;
+	while (passed < points.size() && points[passed].offset < current) {
+		passed++;
+	}
+	points.erase(points.begin(), points.begin() + passed);
+	return false;
+}
+
+bool train_projection::GetEta(const generic_track *target, world_time &eta) const {
+	for (auto &it : points) {
+		if (it.target.track == target) {
+			eta = it.eta;
+			return true;
+		}
+	}
+	return false;
+}
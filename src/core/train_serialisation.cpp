@@ -121,7 +121,13 @@ void train::Deserialise(const deserialiser_input &di, error_collection &ec) {
 	CheckIterateJsonArrayOrValue(di, "vehicle_classes", "vehicle_class", ec, parse_train_segment_val);
 	CheckTransJsonValueProc(current_speed, di, "speed", ec, dsconv::Speed);
 	CheckTransJsonValue(head_relative_height, di, "head_relative_height", ec);
-	CheckTransJsonValue(veh_speed_class, di, "veh_speed_class", ec);
+	if (CheckTransJsonValue(veh_speed_class, di, "veh_speed_class", ec)) {
+		speed_class_id_type old_speed_class_id = veh_speed_class_id;
+		veh_speed_class_id = GetWorld().InternSpeedClass(veh_speed_class);
+		if (veh_speed_class_id != old_speed_class_id && head_pos.IsValid()) {
+			RefreshCoveredTrackSpeedLimits();
+		}
+	}
 	CheckTransJsonSubArray(active_tractions, di, "active_tractions", "traction_types", ec);
 	CheckTransJsonValueFlag(tflags, TF::CONSIST_REV_DIR, di, "reverse_consist", ec);
 	CheckTransJsonSubObj(la, di, "lookahead", "lookahead", ec, false);
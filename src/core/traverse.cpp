@@ -21,97 +21,32 @@
 #include "core/track_reservation.h"
 #include <limits>
 
+unsigned int GetTrainObstructionDistance(const track_location &track, unsigned int step) {
+	generic_track::train_occupation to;
+	unsigned int distance;
+	if (!track.GetTrack()->GetNearestTrainOccupation(track.GetDirection(), track.GetOffset(), to, distance)) {
+		return std::numeric_limits<unsigned int>::max();
+	}
+	if (distance > 0 && step == 0) {
+		//not moving along this piece, only a train which we are in the middle of is an obstruction
+		return std::numeric_limits<unsigned int>::max();
+	}
+	return distance;
+}
+
 //returns displacement length that could not be fulfilled
 unsigned int AdvanceDisplacement(unsigned int displacement, track_location &track, flagwrapper<ADF> ad_flags, flagwrapper<ADRESULTF> *ad_result_flags) {
-	return AdvanceDisplacement(displacement, track, nullptr, [&](track_location &a, track_location &b) { }, ad_flags, ad_result_flags);
+	return AdvanceDisplacement(displacement, track, nullptr, [](track_location &a, track_location &b) { }, ad_flags, ad_result_flags);
 }
 
 //returns displacement length that could not be fulfilled
 unsigned int AdvanceDisplacement(unsigned int displacement, track_location &track, int *elevation_delta /*optional, out*/,
-		std::function<void (track_location & /*old*/, track_location & /*new*/)> func, flagwrapper<ADF> ad_flags, flagwrapper<ADRESULTF> *ad_result_flags) {
-
-	if (elevation_delta) {
-		*elevation_delta = 0;
-	}
-
-	if (!track.IsValid()) {
-		if (ad_result_flags) {
-			*ad_result_flags |= ADRESULTF::TRACK_INVALID;
-		}
-		return displacement;
-	}
-
-	while (displacement > 0) {
-		unsigned int length_on_piece = track.GetTrack()->GetRemainingLength(track.GetDirection(), track.GetOffset());
-
-		if (ad_flags & ADF::CHECK_FOR_TRAINS) {
-			unsigned int start_offset = track.GetOffset();
-			unsigned int end_offset = track.GetTrack()->GetNewOffset(track.GetDirection(), track.GetOffset(), std::min(displacement, length_on_piece));
-
-			unsigned int obstruction_offset = std::numeric_limits<unsigned int>::max();
-
-			std::vector<generic_track::train_occupation> tos;
-			track.GetTrack()->GetTrainOccupationState(tos);
-			for (auto &it : tos) {
-				if (it.start_offset < start_offset && it.end_offset > start_offset) {
-					//whoops, we're in the middle of a train
-					obstruction_offset = 0;
-					break;
-				}
-				if (end_offset > start_offset && it.start_offset >= start_offset) {
-					//going forwards, train in front
-					obstruction_offset = std::min(obstruction_offset, it.start_offset - start_offset);
-				} else if (end_offset < start_offset && it.end_offset <= start_offset) {
-					//going backwards, train behind
-					obstruction_offset = std::min(obstruction_offset, start_offset - it.end_offset);
-				}
-			}
-
-			if (obstruction_offset < displacement) {
-				track.GetOffset() = track.GetTrack()->GetNewOffset(track.GetDirection(), track.GetOffset(), obstruction_offset);
-				if (elevation_delta) {
-					*elevation_delta += track.GetTrack()->GetPartialElevationDelta(track.GetDirection(), obstruction_offset);
-				}
-				displacement -= obstruction_offset;
-
-				if (ad_result_flags) {
-					*ad_result_flags |= ADRESULTF::TRAIN_IN_WAY;
-				}
-				return displacement;
-			}
-		}
-
-		if (length_on_piece >= displacement) {
-			track.GetOffset() = track.GetTrack()->GetNewOffset(track.GetDirection(), track.GetOffset(), displacement);
-			if (elevation_delta) {
-				*elevation_delta += track.GetTrack()->GetPartialElevationDelta(track.GetDirection(), displacement);
-			}
-			break;
-		} else {
-			displacement -= length_on_piece;
-
-			if (elevation_delta) {
-				*elevation_delta += track.GetTrack()->GetElevationDelta(track.GetDirection());
-			}
-
-			track_location old_track = track;
-			const track_target_ptr &targ = old_track.GetTrack()->GetConnectingPiece(old_track.GetDirection());
-			if (targ.IsValid()) {
-				track.SetTargetStartLocation(targ);
-			} else {    //run out of valid track
-				track.GetOffset() = track.GetTrack()->GetNewOffset(track.GetDirection(), track.GetOffset(), length_on_piece);
-				if (ad_result_flags) {
-					*ad_result_flags |= ADRESULTF::RAN_OUT_OF_TRACK;
-				}
-				return displacement;
-			}
-
-			if (func) {
-				func(old_track, track);
-			}
+		const std::function<void (track_location & /*old*/, track_location & /*new*/)> &func, flagwrapper<ADF> ad_flags, flagwrapper<ADRESULTF> *ad_result_flags) {
+	return AdvanceDisplacement(displacement, track, elevation_delta, [&](track_location &old_track, track_location &new_track) {
+		if (func) {
+			func(old_track, new_track);
 		}
-	}
-	return 0;
+	}, ad_flags, ad_result_flags);
 }
 
 void TrackScan(unsigned int max_pieces, unsigned int junction_max, track_target_ptr start_track, route_recording_list &route_pieces, generic_route_recording_state *grrs, TSEF &error_flags, std::function<bool(const route_recording_list &route_pieces, const track_target_ptr &piece, generic_route_recording_state *grrs)> step_func) {
@@ -28,8 +28,17 @@
 #include "core/signal.h"
 #include "core/train.h"
 #include "core/serialisable_impl.h"
+#include "util/worker_pool.h"
 #include <iostream>
 
+struct train_step_context {
+	worker_pool pool;
+	std::vector<train *> trains;
+	std::vector<train_step_state> states;
+
+	train_step_context(unsigned int threads) : pool(threads) { }
+};
+
 world::world() : track_circuits(*this), track_triggers(*this) {
 	InitFutureTypes();
 	action::RegisterAllActionTypes(action_types);
@@ -40,57 +49,195 @@ world::~world() {
 
 void world::GameStep(world_time delta) {
 	update_set.clear();
+	all_trains.Compact();
 
 	gametime += delta;
 
 	futures.ExecuteUpTo(gametime);
 
-	for (auto it = tick_update_list.begin(); it != tick_update_list.end(); ++it) {
-		(*it)->TrackTick();
+	TickUpdates();
+	train_step_routing_generation = routing_state_generation;
+	train_step_reservation_generation = reservation_state_generation;
+	if (train_step) {
+		ParallelTrainTimeStep(delta);
+	} else {
+		all_trains.Enumerate([&](train &t) {
+			t.TrainTimeStep(delta);
+		});
+	}
+	if (train_projections) {
+		UpdateTrainProjections();
+	}
+	//update notifications may mark further objects as updated
+	for (size_t i = 0; i < update_set.size(); i++) {
+		update_set[i]->UpdateNotification(*this);
+	}
+}
+
+// Updating a projection only modifies the train's own projection, so may be run concurrently for different trains
+void world::UpdateTrainProjections() {
+	if (train_step) {
+		std::vector<train *> &trains = train_step->trains;
+		trains.clear();
+		all_trains.Enumerate([&](train &t) {
+			trains.push_back(&t);
+		});
+		train_step->pool.ParallelFor(trains.size(), [&](size_t i) {
+			trains[i]->UpdateProjection();
+		});
+	} else {
+		all_trains.Enumerate([&](train &t) {
+			t.UpdateProjection();
+		});
+	}
+}
+
+const train_projection &world::GetTrainProjection(train &t) {
+	t.UpdateProjection();
+	return t.GetProjection();
+}
+
+// Train movement is prepared for all trains in parallel, against the state of the world after the track tick.
+// The prepared moves are then committed serially in the usual order.
+// If committing a move changes state which a later train's prepare step may have depended on,
+// that train's prepare is undone and its time step is re-run serially, such that the result is identical to serial stepping.
+void world::ParallelTrainTimeStep(world_time delta) {
+	std::vector<train *> &trains = train_step->trains;
+	std::vector<train_step_state> &states = train_step->states;
+	trains.clear();
+	all_trains.Enumerate([&](train &t) {
+		trains.push_back(&t);
+	});
+	if (states.size() < trains.size()) {
+		states.resize(trains.size());
+	}
+
+	train_step->pool.ParallelFor(trains.size(), [&](size_t i) {
+		trains[i]->SaveStepState(states[i]);
+		trains[i]->TrainTimeStepPrepare(delta);
+		trains[i]->EndSaveStepState();
+	});
+
+	uint64_t routing_gen = routing_state_generation;
+	uint64_t reservation_gen = reservation_state_generation;
+	for (size_t i = 0; i < trains.size(); i++) {
+		train *t = trains[i];
+		if (routing_gen != routing_state_generation || (reservation_gen != reservation_state_generation && t->IsPendingMoveScanned())) {
+			t->RestoreStepState(states[i]);
+			t->TrainTimeStep(delta);
+		} else {
+			t->TrainTimeStepCommit();
+		}
+	}
+}
+
+void world::SetTrainStepThreadCount(unsigned int threads) {
+	if (threads <= 1) {
+		train_step.reset();
+	} else if (threads != GetTrainStepThreadCount()) {
+		train_step.reset(new train_step_context(threads));
+	}
+}
+
+unsigned int world::GetTrainStepThreadCount() const {
+	return train_step ? train_step->pool.GetThreadCount() : 1;
+}
+
+generic_track *world::AddTrack(std::unique_ptr<generic_track> &&piece, error_collection &ec) {
+	track_id_type id = InternTrackName(piece->GetName());
+	if (all_pieces[id]) {
+		ec.RegisterNewError<generic_error_obj>("Track piece name conflict: " + piece->GetName());
+		return nullptr;
+	}
+	piece->track_id = id;
+	all_pieces[id] = std::move(piece);
+	return all_pieces[id].get();
+}
+
+track_id_type world::InternTrackName(const std::string &name) {
+	auto res = track_name_index.insert(std::make_pair(name, (track_id_type) all_pieces.size()));
+	if (res.second) {
+		all_pieces.emplace_back();
+		track_id_names.push_back(&(res.first->first));
+	}
+	return res.first->second;
+}
+
+speed_class_id_type world::InternSpeedClass(const std::string &name) {
+	if (name.empty()) {
+		return 0;
 	}
-	for (auto it = all_trains.begin(); it != all_trains.end(); ) {
-		auto current = it;
-		++it;    //do this as *current may be modified/deleted
-		current->TrainTimeStep(delta);
+	auto res = speed_class_index.insert(std::make_pair(name, (speed_class_id_type) speed_class_names.size() + 1));
+	if (res.second) {
+		speed_class_names.push_back(&(res.first->first));
 	}
-	for (auto &it : update_set) {
-		it->UpdateNotification(*this);
+	return res.first->second;
+}
+
+speed_class_id_type world::FindSpeedClassId(const std::string &name) const {
+	if (name.empty()) {
+		return 0;
 	}
+	auto it = speed_class_index.find(name);
+	return it != speed_class_index.end() ? it->second : INVALID_SPEED_CLASS_ID;
+}
+
+const std::string &world::GetSpeedClassNameById(speed_class_id_type id) const {
+	static const std::string empty;
+	return id == 0 ? empty : *speed_class_names[id - 1];
+}
+
+track_id_type world::FindTrackId(const std::string &name) const {
+	auto it = track_name_index.find(name);
+	return it != track_name_index.end() ? it->second : INVALID_TRACK_ID;
 }
 
 void world::ConnectTrack(generic_track *track1, EDGE dir1, std::string name2, EDGE dir2, error_collection &ec) {
-	auto target_it = all_pieces.find(name2);
-	if (target_it == all_pieces.end()) {
+	generic_track *target = FindTrackByName(name2);
+	if (!target) {
 		connection_forward_declarations.emplace_back(track1, dir1, name2, dir2);
 	} else {
-		track1->FullConnect(dir1, track_target_ptr(target_it->second.get(), dir2), ec);
+		track1->FullConnect(dir1, track_target_ptr(target, dir2), ec);
 	}
 }
 
 void world::LayoutInit(error_collection &ec) {
 	for (auto &it : connection_forward_declarations) {
-		auto target_it = all_pieces.find(it.name2);
-		if (target_it == all_pieces.end()) {
+		generic_track *target = FindTrackByName(it.name2);
+		if (!target) {
 			ec.RegisterNewError<error_track_connection_notfound>(track_target_ptr(it.track1, it.dir1), it.name2);
 		} else {
-			it.track1->FullConnect(it.dir1, track_target_ptr(target_it->second.get(), it.dir2), ec);
+			it.track1->FullConnect(it.dir1, track_target_ptr(target, it.dir2), ec);
 		}
 	}
 	for (auto &it : all_pieces) {
-		it.second->AutoConnections(ec);
+		if (it) {
+			it->AutoConnections(ec);
+		}
 	}
 	layout_init_final_fixups.Execute(ec);
 	for (auto &it : all_pieces) {
-		it.second->CheckUnconnectedEdges(ec);
+		if (it) {
+			it->CheckUnconnectedEdges(ec);
+		}
 	}
 	wflags |= WFLAGS::DONE_LAYOUT_INIT;
 }
 
 void world::PostLayoutInit(error_collection &ec) {
 	for (auto &it : all_pieces) {
-		it.second->PostLayoutInit(ec);
+		if (it) {
+			it->PostLayoutInit(ec);
+		}
 	}
 	post_layout_init_final_fixups.Execute(ec);
+	route_conflicts.Build(*this);
+	for (auto &it : all_pieces) {
+		generic_signal *gs = dynamic_cast<generic_signal *>(it.get());
+		if (gs) {
+			gs->InitTickUpdateDependencies();
+		}
+	}
 	wflags |= WFLAGS::DONE_POST_LAYOUT_INIT;
 }
 
@@ -167,8 +314,18 @@ void world::SubmitAction(const action &request) {
 }
 
 void world::AddTractionType(std::string name, bool always_available) {
-	traction_types[name].name=name;
-	traction_types[name].always_available=always_available;
+	auto result = traction_types.insert(std::make_pair(name, traction_type(name, always_available)));
+	traction_type &tt = result.first->second;
+	if (result.second) {
+		tt.id = traction_types_by_id.size();
+		traction_types_by_id.push_back(&tt);
+	}
+	tt.always_available = always_available;
+	if (always_available) {
+		always_available_tractions.AddTractionType(&tt);
+	} else {
+		always_available_tractions.RemoveTractionType(&tt);
+	}
 }
 
 traction_type *world::GetTractionTypeByName(std::string name) const {
@@ -181,11 +338,9 @@ traction_type *world::GetTractionTypeByName(std::string name) const {
 }
 
 generic_track *world::FindTrackByName(const std::string &name) const {
-	auto it = all_pieces.find(name);
-	if (it != all_pieces.end()) {
-		if (it->second) {
-			return it->second.get();
-		}
+	auto it = track_name_index.find(name);
+	if (it != track_name_index.end()) {
+		return all_pieces[it->second].get();
 	}
 	return nullptr;
 }
@@ -200,7 +355,137 @@ track_train_counter_block *world::FindTrackTrainBlockOrTrackCircuitByName(const
 }
 
 void world::RegisterTickUpdate(generic_track *targ) {
+	unsigned int index = tick_update_list.size();
 	tick_update_list.push_back(targ);
+	targ->tick_update_index = index;
+	tick_update_wake_times.push_back(0);
+	if (index / 64 >= tick_update_dirty.size()) {
+		tick_update_dirty.push_back(0);
+	}
+	tick_update_dirty[index / 64] |= ((uint64_t) 1) << (index % 64);
+}
+
+void world::SetTickUpdateMode(TICK_UPDATE_MODE mode) {
+	tick_update_mode = mode;
+	if (mode == TICK_UPDATE_MODE::EVENT) {
+		for (unsigned int i = 0; i < tick_update_list.size(); i++) {
+			MarkTickUpdateDirty(i);
+		}
+	}
+}
+
+// In poll mode, all pieces are ticked in order. When a signal is ticked, it first updates the signal which it reads the aspect of.
+// So each signal sees the state of the signals ahead of it as of this tick, regardless of the order of the list.
+// In event mode, only dirty pieces are ticked. Pieces which are not dirty would not change state if ticked.
+// A piece marked dirty during this pass is ticked in this pass if it has not already been updated this tick, otherwise on the next tick.
+// This gives the same result as poll mode, unless ticking a piece has side-effects on other pieces: the result of that depends on
+// which pieces were updated before it, so in that case poll this tick instead.
+void world::TickUpdates() {
+	bool poll = (tick_update_mode == TICK_UPDATE_MODE::POLL);
+	while (!tick_update_wakeups.empty() && tick_update_wakeups.top().first <= gametime) {
+		const tick_update_wakeup &wakeup = tick_update_wakeups.top();
+		if (tick_update_wake_times[wakeup.second] == wakeup.first) {
+			// otherwise this has been superseded by an earlier wake
+			tick_update_wake_times[wakeup.second] = 0;
+			MarkTickUpdateDirty(wakeup.second);
+		}
+		tick_update_wakeups.pop();
+	}
+	tick_update_worklist.clear();
+	for (size_t word = 0; !poll && word < tick_update_dirty.size(); word++) {
+		for (uint64_t bits = tick_update_dirty[word]; bits; bits &= bits - 1) {
+			unsigned int index = (word * 64) + __builtin_ctzll(bits);
+			if (tick_update_list[index]->IsTickUpdateOrderSensitive()) {
+				poll = true;
+				break;
+			}
+			tick_update_worklist.push_back(index);
+		}
+	}
+
+	if (poll) {
+		for (auto it = tick_update_list.begin(); it != tick_update_list.end(); ++it) {
+			(*it)->TrackTick();
+		}
+		return;
+	}
+
+	in_tick_updates = true;
+	for (size_t i = 0; i < tick_update_worklist.size(); i++) {
+		tick_update_list[tick_update_worklist[i]]->TrackTick();
+	}
+	in_tick_updates = false;
+}
+
+void world::SetTickUpdateWakeup(unsigned int index, world_time wake) {
+	if (tick_update_mode != TICK_UPDATE_MODE::EVENT) {
+		return;
+	}
+	if (wake <= gametime) {
+		MarkTickUpdateDirty(index);
+	} else {
+		world_time &pending = tick_update_wake_times[index];
+		if (pending && pending <= wake) {
+			return;
+		}
+		pending = wake;
+		tick_update_wakeups.emplace(wake, index);
+	}
+}
+
+bool world::IsQuiescent() const {
+	if (tick_update_mode != TICK_UPDATE_MODE::EVENT) {
+		return false;
+	}
+	for (auto &it : tick_update_dirty) {
+		if (it) {
+			return false;
+		}
+	}
+
+	// Check that nothing which a train could have seen has changed since the trains last stepped,
+	// and that none of the trains could move given that state
+	if (routing_state_generation != train_step_routing_generation || reservation_state_generation != train_step_reservation_generation) {
+		return false;
+	}
+	bool held = true;
+	all_trains.Enumerate([&](const train &t) {
+		held = held && t.IsHeld();
+	});
+	return held;
+}
+
+bool world::GetNextEventTime(world_time &next) const {
+	bool found = futures.GetNextTriggerTime(next);
+	if (!tick_update_wakeups.empty() && (!found || tick_update_wakeups.top().first < next)) {
+		next = tick_update_wakeups.top().first;
+		found = true;
+	}
+	return found;
+}
+
+unsigned int world::FastForward(world_time target, world_time step) {
+	if (!step) {
+		step = 1;
+	}
+	unsigned int steps = 0;
+	while (gametime < target) {
+		if (IsQuiescent()) {
+			// Skip to the start of the step during which the next event is due.
+			// This is the same step as if no steps had been skipped, so the result is the same.
+			world_time next;
+			if (!GetNextEventTime(next) || next > target) {
+				gametime = target;
+				break;
+			}
+			if (next > gametime) {
+				gametime += ((next - gametime - 1) / step) * step;
+			}
+		}
+		GameStep(std::min(step, target - gametime));
+		steps++;
+	}
+	return steps;
 }
 
 void world::UnregisterTickUpdate(generic_track *targ) {
@@ -215,51 +500,181 @@ void world::ExecuteIfActionScope(std::function<void()> func) {
 
 void world::CapAllTrackPieceUnconnectedEdges() {
 	layout_init_final_fixups.AddFixup([this](error_collection &ec) {
-		std::deque<start_of_line *> newpieces;
+		//pieces are added after the scan, as adding to all_pieces would invalidate the iteration
+		std::deque<track_target_ptr> unconnected;
 		for (auto &it : all_pieces) {
+			if (!it) {
+				continue;
+			}
 			std::vector<generic_track::edgelistitem> edgelist;
-			it.second->GetListOfEdges(edgelist);
+			it->GetListOfEdges(edgelist);
 			for (auto &jt : edgelist) {
 				if (!jt.target->IsValid()) {
-					std::string name = string_format("#edge%d", this->auto_seq_item);
-					this->auto_seq_item++;
-					start_of_line *sol = new start_of_line(*this);
-					sol->SetName(name);
-					newpieces.push_back(sol);
-					sol->FullConnect(EDGE::FRONT, track_target_ptr(it.second.get(), jt.edge), ec);
+					unconnected.emplace_back(it.get(), jt.edge);
 				}
 			}
 		}
-		for (auto &it : newpieces) {
-			this->all_pieces[it->GetName()].reset(it);
+		for (auto &it : unconnected) {
+			std::string name;
+			do {
+				name = string_format("#edge%d", this->auto_seq_item);
+				this->auto_seq_item++;
+			} while (FindTrackId(name) != INVALID_TRACK_ID);
+			std::unique_ptr<start_of_line> sol(new start_of_line(*this));
+			sol->SetName(name);
+			//only connect once the piece has been accepted, such that a rejected piece does not leave a dangling connection
+			generic_track *piece = this->AddTrack(std::move(sol), ec);
+			if (piece) {
+				piece->FullConnect(EDGE::FRONT, it, ec);
+			}
 		}
 	});
 }
 
+train_registry::train_registry() { }
+
+train_registry::~train_registry() { }
+
+train *train_registry::Create(world &w) {
+	train *t = new train(w);
+	t->train_id = next_id++;
+	t->registry_slot = slots.size();
+	slots.emplace_back(t);
+	id_index[t->train_id] = t;
+	count++;
+	return t;
+}
+
+void train_registry::Delete(train *t) {
+	if (!t || t->registry_slot >= slots.size() || slots[t->registry_slot].get() != t) {
+		return;
+	}
+	auto it = name_index.find(t->GetName());
+	if (it != name_index.end() && it->second == t) {
+		name_index.erase(it);
+	}
+	id_index.erase(t->train_id);
+	count--;
+	slots[t->registry_slot].reset();
+}
+
+bool train_registry::Rename(train *t, const std::string &newname) {
+	if (!newname.empty()) {
+		train *existing = FindByName(newname);
+		if (existing && existing != t) {
+			return false;
+		}
+	}
+	auto it = name_index.find(t->GetName());
+	if (it != name_index.end() && it->second == t) {
+		name_index.erase(it);
+	}
+	if (!newname.empty()) {
+		name_index[newname] = t;
+	}
+	return true;
+}
+
+train *train_registry::FindByName(const std::string &name) const {
+	auto it = name_index.find(name);
+	return it != name_index.end() ? it->second : nullptr;
+}
+
+train *train_registry::FindById(train_id_type id) const {
+	auto it = id_index.find(id);
+	return it != id_index.end() ? it->second : nullptr;
+}
+
+// This must not be called whilst enumerating, as it moves trains between slots
+void train_registry::Compact() {
+	if (count == slots.size()) {
+		return;
+	}
+	size_t out = 0;
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i]) {
+			slots[i]->registry_slot = out;
+			if (i != out) {
+				slots[out] = std::move(slots[i]);
+			}
+			out++;
+		}
+	}
+	slots.resize(out);
+}
+
 train *world::CreateEmptyTrain() {
-	all_trains.emplace_front(*this);
-	return &all_trains.front();
+	return all_trains.Create(*this);
 }
 
 void world::DeleteTrain(train *t) {
-	all_trains.remove_if([&](const train &lt) { return &lt == t; });
+	all_trains.Delete(t);
+}
+
+bool world::RenameTrain(train *t, const std::string &newname) {
+	return all_trains.Rename(t, newname);
 }
 
 train *world::FindTrainByName(const std::string &name) const {
-	for (auto &it : all_trains) {
-		if (it.GetName() == name) {
-			return const_cast<train*>(&it);
+	return all_trains.FindByName(name);
+}
+
+train *world::FindTrainById(train_id_type id) const {
+	return all_trains.FindById(id);
+}
+
+train *world::FindNearestTrainAhead(const track_location &location, unsigned int max_distance, unsigned int *distance) const {
+	track_location loc = location;
+	unsigned int travelled = 0;
+	bool wrapped = false;
+
+	// A piece can be entered in at most 4 directions (double-slips), so a walk longer than this has entered a loop
+	// which does not include the start, such as one entered from a branch, or one made only of zero-length pieces
+	uint64_t max_steps = (((uint64_t) GetTrackIdCount()) * 4) + 1;
+	for (uint64_t steps = 0; loc.IsValid(); steps++) {
+		if (steps > max_steps) {
+			return nullptr;
+		}
+		generic_track::train_occupation to;
+		unsigned int piece_distance;
+		if (loc.GetTrack()->GetNearestTrainOccupation(loc.GetDirection(), loc.GetOffset(), to, piece_distance)) {
+			if (piece_distance > max_distance - travelled) {
+				return nullptr;
+			}
+			if (distance) {
+				*distance = travelled + piece_distance;
+			}
+			return to.t;
 		}
+
+		unsigned int remaining = loc.GetTrack()->GetRemainingLength(loc.GetDirection(), loc.GetOffset());
+		if (remaining > max_distance - travelled) {
+			return nullptr;
+		}
+		travelled += remaining;
+
+		const track_target_ptr &next = loc.GetTrack()->GetConnectingPiece(loc.GetDirection());
+		if (!next.IsValid()) {
+			return nullptr;
+		}
+		if (next.track == location.GetTrack() && next.direction == location.GetDirection()) {
+			//gone round a loop, the start piece is checked again for any trains behind the start offset
+			if (wrapped) {
+				return nullptr;
+			}
+			wrapped = true;
+		}
+		loc.SetTargetStartLocation(next);
 	}
 	return nullptr;
 }
 
 unsigned int world::EnumerateTrains(std::function<void(const train &)> f) const {
 	unsigned int count = 0;
-	for (auto &it : all_trains) {
-		f(it);
+	all_trains.Enumerate([&](const train &t) {
+		f(t);
 		count++;
-	}
+	});
 	return count;
 }
 
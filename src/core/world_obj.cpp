@@ -20,6 +20,12 @@
 #include "core/world.h"
 #include "core/serialisable_impl.h"
 
+// Generations are unique across all sets, such that an object can never appear to be in a set which it was not inserted into
+uint64_t updatable_obj_set::NextGeneration() {
+	static uint64_t last_generation = 0;
+	return ++last_generation;
+}
+
 void updatable_obj::AddUpdateHook(const std::function<void(updatable_obj*, world &)> &f) {
 	update_functions.push_back(f);
 }
@@ -65,6 +65,11 @@ void world_deserialisation::LoadGame(const deserialiser_input &di, error_collect
 
 void world_deserialisation::DeserialiseGameState(error_collection &ec) {
 	game_state_init.Execute(ec);
+
+	// Loaded reservations bypass the route set notifications
+	if (w.route_conflicts.IsBuilt()) {
+		w.route_conflicts.RefreshAllRoutes();
+	}
 }
 
 void world_deserialisation::DeserialiseRootObjArray(const ws_deserialisation_type_factory &wdtf, const ws_dtf_params &wdtf_params,
@@ -102,24 +107,28 @@ template <typename T> T* world_deserialisation::MakeOrFindGenericTrack(const des
 		isautoname = true;
 	}
 
-	std::unique_ptr<generic_track> &ptr = w.all_pieces[trackname];
+	//pieces which may not be made here are only looked up, such that an unknown name does not allocate an ID
+	track_id_type id = findonly ? w.FindTrackId(trackname) : w.InternTrackName(trackname);
+	if (id == INVALID_TRACK_ID || (findonly && !w.all_pieces[id])) {
+		ec.RegisterNewError<error_deserialisation>(di, string_format("LoadGame: Cannot make a new track piece at this point: %s", trackname.c_str()));
+		return nullptr;
+	}
+	std::unique_ptr<generic_track> &ptr = w.all_pieces[id];
 	if (ptr) {
 		if (typeid(*ptr) != typeid(T)) {
 			ec.RegisterNewError<error_deserialisation>(di,
 					string_format("LoadGame: Track type definition conflict: %s is not a %s", ptr->GetFriendlyName().c_str(), di.type.c_str()));
 			return nullptr;
 		}
-	} else if (!findonly) {
+	} else {
 		ptr.reset(new T(w));
+		ptr->track_id = id;
 		ptr->SetName(trackname);
 		ptr->SetAutoName(isautoname);
 		ptr->SetPreviousTrackPiece(previous_track_piece);
 		if (previous_track_piece)
 			previous_track_piece->SetNextTrackPiece(ptr.get());
 		previous_track_piece = ptr.get();
-	} else {
-		ec.RegisterNewError<error_deserialisation>(di, string_format("LoadGame: Cannot make a new track piece at this point: %s", trackname.c_str()));
-		return nullptr;
 	}
 	return static_cast<T*>(ptr.get());
 }
@@ -354,7 +363,7 @@ void world_deserialisation::LoadGameFromStrings(const std::string &base, const s
 
 	if (!save.empty()) {
 		//load gamestate from save, override any initial gamestate in base
-		ParseInputString(base, ec, WS_LOAD_GAME_FLAGS::NO_CONTENT | WS_LOAD_GAME_FLAGS::TRY_REPLACE_GAME_STATE);
+		ParseInputString(save, ec, WS_LOAD_GAME_FLAGS::NO_CONTENT | WS_LOAD_GAME_FLAGS::TRY_REPLACE_GAME_STATE);
 	}
 
 	if (ec.GetErrorCount()) {
@@ -402,7 +411,10 @@ std::string world_serialisation::SaveGameToString(error_collection &ec, flagwrap
 		w.Serialise(so, ec);
 		hndl.EndObject();
 		for (auto &it : w.all_pieces) {
-			generic_track &gt = *(it.second);
+			if (!it) {
+				continue;
+			}
+			generic_track &gt = *it;
 			hndl.StartObject();
 			gt.Serialise(so, ec);
 			hndl.EndObject();
@@ -0,0 +1,141 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2015 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#include "common.h"
+#include "sim/gen.h"
+#include "util/util.h"
+
+namespace sim {
+
+	layout_generator::layout_generator(const layout_gen_params &params_) : params(params_) {
+		auto unit_name = [](unsigned int unit, const char *item) {
+			return string_format("U%u_%s", unit, item);
+		};
+
+		AddItem(content, R"({ "type" : "start_of_line", "name" : "A" })");
+		for (unsigned int k = 0; k < params.units; k++) {
+			for (unsigned int j = 0; j < params.auto_signals; j++) {
+				AddTrackSeg(unit_name(k, string_format("A%u", j).c_str()), "1km");
+				std::string signal = unit_name(k, string_format("AS%u", j).c_str());
+				AddItem(content, string_format(R"({ "type" : "auto_signal", "name" : "%s" })", signal.c_str()));
+				counts.auto_signals++;
+				AddOverlap(signal);
+			}
+
+			AddTrackSeg(unit_name(k, "E"), "1km");
+			std::string entry = unit_name(k, "RS");
+			AddItem(content, string_format(R"({ "type" : "route_signal", "name" : "%s", "route_signal" : true })", entry.c_str()));
+			counts.route_signals++;
+			AddOverlap(entry);
+
+			AddItem(content, string_format(R"({ "type" : "points", "name" : "%s" })", unit_name(k, "PA").c_str()));
+			counts.points++;
+
+			AddTrackSeg(unit_name(k, "M"), "500m");
+			std::string main = unit_name(k, "RSM");
+			AddItem(content, string_format(R"({ "type" : "route_signal", "name" : "%s", "route_signal" : true })", main.c_str()));
+			counts.route_signals++;
+			AddOverlap(main);
+
+			AddItem(content, string_format(R"({ "type" : "points", "name" : "%s", "reverse_auto_connection" : true })", unit_name(k, "PB").c_str()));
+			counts.points++;
+		}
+		AddTrackSeg("END", "1km");
+		AddItem(content, R"({ "type" : "end_of_line", "name" : "B" })");
+
+		// Passing loops are separate chains, which are connected to the points explicitly
+		for (unsigned int k = 0; k < params.units; k++) {
+			AddTrackSeg(unit_name(k, "L"), "500m",
+					string_format(R"("connect" : { "from_direction" : "front", "to" : "%s", "to_direction" : "reverse" })", unit_name(k, "PA").c_str()));
+			AddItem(content, string_format(R"({ "type" : "route_signal", "name" : "%s", "route_signal" : true })", unit_name(k, "RSL").c_str()));
+			counts.route_signals++;
+			AddTrackSeg(unit_name(k, "LO"), "100m");
+			AddItem(content, string_format(R"({ "type" : "routing_marker", "overlap_end" : true, )"
+					R"("connect" : { "from_direction" : "back", "to" : "%s", "to_direction" : "reverse" } })", unit_name(k, "PB").c_str()));
+			counts.routing_markers++;
+		}
+
+		AddItem(content, R"({ "type" : "traction_type", "name" : "diesel", "always_available" : true })");
+		AddItem(content, R"({ "type" : "vehicle_class", "name" : "VC1", "length" : "20m", "mass" : "40t", "max_speed" : "100km/h", )"
+				R"("tractive_force" : "200kN", "tractive_power" : "1000kW", "braking_force" : "300kN", "traction_types" : [ "diesel" ] })");
+
+		if (params.units && params.auto_signals) {
+			for (unsigned int i = 0; i < params.trains; i++) {
+				unsigned int unit = i % params.units;
+				unsigned int section = i / params.units;
+				if (section >= params.auto_signals) {
+					break;
+				}
+				std::string piece = unit_name(unit, string_format("AS%u", params.auto_signals - 1 - section).c_str());
+				AddItem(game_state, string_format(R"({ "type" : "train", "name" : "TR%u", "active_tractions" : [ "diesel" ], )"
+						R"("vehicle_classes" : [ { "class_name" : "VC1", "count" : 4 } ], )"
+						R"("position" : { "piece" : "%s", "dir" : "front", "offset" : 0 } })", i, piece.c_str()));
+				counts.trains++;
+			}
+		}
+
+		counts.total_pieces = 2 + counts.track_segs + counts.points + counts.route_signals + counts.auto_signals + counts.routing_markers;
+	}
+
+	void layout_generator::AddItem(std::string &out, const std::string &item) {
+		if (!out.empty()) {
+			out += ",\n";
+		}
+		out += item;
+	}
+
+	void layout_generator::AddTrackSeg(const std::string &name, const char *length, const std::string &extra) {
+		AddItem(content, string_format(R"({ "type" : "track_seg", "name" : "%s", "length" : "%s", "track_circuit" : "%s"%s%s })",
+				name.c_str(), length, name.c_str(), extra.empty() ? "" : ", ", extra.c_str()));
+		counts.track_segs++;
+	}
+
+	void layout_generator::AddOverlap(const std::string &signal_name) {
+		AddTrackSeg(signal_name + "_ovlp", "100m");
+		AddItem(content, R"({ "type" : "routing_marker", "overlap_end" : true })");
+		counts.routing_markers++;
+	}
+
+	std::string layout_generator::GetJson() const {
+		return "{ \"content\" : [\n" + content + "\n], \"game_state\" : [\n" + game_state + "\n] }\n";
+	}
+
+	std::vector<std::string> layout_generator::GetRouteSettingCommands() const {
+		std::vector<std::string> cmds;
+		for (unsigned int k = 0; k < params.units; k++) {
+			cmds.push_back(string_format("reserve U%u_RS U%u_RSM", k, k));
+			if (k + 1 == params.units) {
+				cmds.push_back(string_format("reserve U%u_RSM B", k));
+			} else if (params.auto_signals) {
+				cmds.push_back(string_format("reserve U%u_RSM U%u_AS0", k, k + 1));
+			} else {
+				cmds.push_back(string_format("reserve U%u_RSM U%u_RS", k, k + 1));
+			}
+		}
+		return cmds;
+	}
+
+	unsigned int layout_generator::UnitsForPieceCount(unsigned int total_pieces, unsigned int auto_signals) {
+		unsigned int per_unit = 14 + (4 * auto_signals);
+		if (total_pieces <= 3 + per_unit) {
+			return 1;
+		}
+		return (total_pieces - 3) / per_unit;
+	}
+
+};
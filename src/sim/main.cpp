@@ -0,0 +1,466 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2015 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#include <cstdio>
+#include <cinttypes>
+#include <iostream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "main/SimpleOpt.h"
+#include "sim/sim.h"
+#include "sim/gen.h"
+#include "core/world_serialisation.h"
+#include "core/train.h"
+#include "text_cmd/text_cmd.h"
+#include "util/error.h"
+#include "util/util.h"
+
+typedef CSimpleOptTempl<char> CSO;
+
+enum {
+	OPT_NEWGAME,
+	OPT_LOAD,
+	OPT_TIME,
+	OPT_STEP,
+	OPT_CMD,
+	OPT_QUIET,
+	OPT_GENERATE,
+	OPT_UNITS,
+	OPT_AUTOS,
+	OPT_TRAINS,
+	OPT_SET_ROUTES,
+	OPT_DUMP,
+	OPT_SCALE,
+	OPT_THREADS,
+	OPT_POLL_SIGNALS,
+	OPT_TABLE_BRAKING,
+	OPT_PROJECTIONS,
+	OPT_NO_FREE_RUNNING,
+	OPT_FAST_FORWARD,
+	OPT_HELP,
+};
+
+static CSO::SOption g_rgOptions[] =
+{
+	{ OPT_NEWGAME,           "-n",             SO_REQ_SHRT  },
+	{ OPT_NEWGAME,           "--new-game",     SO_REQ_SHRT  },
+	{ OPT_LOAD,              "-l",             SO_REQ_SHRT  },
+	{ OPT_LOAD,              "--load-game",    SO_REQ_SHRT  },
+	{ OPT_TIME,              "-t",             SO_REQ_SHRT  },
+	{ OPT_TIME,              "--time",         SO_REQ_SHRT  },
+	{ OPT_STEP,              "-s",             SO_REQ_SHRT  },
+	{ OPT_STEP,              "--step",         SO_REQ_SHRT  },
+	{ OPT_CMD,               "-c",             SO_REQ_SHRT  },
+	{ OPT_CMD,               "--cmd",          SO_REQ_SHRT  },
+	{ OPT_QUIET,             "-q",             SO_NONE      },
+	{ OPT_QUIET,             "--quiet",        SO_NONE      },
+	{ OPT_GENERATE,          "-g",             SO_NONE      },
+	{ OPT_GENERATE,          "--generate",     SO_NONE      },
+	{ OPT_UNITS,             "--units",        SO_REQ_SHRT  },
+	{ OPT_AUTOS,             "--autos",        SO_REQ_SHRT  },
+	{ OPT_TRAINS,            "--trains",       SO_REQ_SHRT  },
+	{ OPT_SET_ROUTES,        "--set-routes",   SO_NONE      },
+	{ OPT_DUMP,              "--dump",         SO_REQ_SHRT  },
+	{ OPT_SCALE,             "--scale",        SO_REQ_SHRT  },
+	{ OPT_THREADS,           "-j",             SO_REQ_SHRT  },
+	{ OPT_THREADS,           "--threads",      SO_REQ_SHRT  },
+	{ OPT_POLL_SIGNALS,      "--poll-signals", SO_NONE      },
+	{ OPT_TABLE_BRAKING,     "--table-braking", SO_NONE     },
+	{ OPT_PROJECTIONS,       "--projections",  SO_NONE      },
+	{ OPT_NO_FREE_RUNNING,   "--no-free-running", SO_NONE   },
+	{ OPT_FAST_FORWARD,      "-f",             SO_NONE      },
+	{ OPT_FAST_FORWARD,      "--fast-forward", SO_NONE      },
+	{ OPT_HELP,              "-h",             SO_NONE      },
+	{ OPT_HELP,              "--help",         SO_NONE      },
+
+	SO_END_OF_OPTIONS
+};
+
+static const char* cmdlineargerrorstr(ESOError err) {
+	switch (err) {
+	case SO_OPT_INVALID:
+		return "Unrecognized option";
+	case SO_OPT_MULTIPLE:
+		return "Option matched multiple strings";
+	case SO_ARG_INVALID:
+		return "Option does not accept argument";
+	case SO_ARG_INVALID_TYPE:
+		return "Invalid argument format";
+	case SO_ARG_MISSING:
+		return "Required argument is missing";
+	case SO_ARG_INVALID_DATA:
+		return "Option argument appears to be another option";
+	default:
+		return "Unknown Error";
+	}
+}
+
+static void usage(const char *name) {
+	fprintf(stderr,
+			"Usage: %s (-n BASE | -l BASE SAVE | -g | --scale PIECES) [options]\n"
+			"Runs the simulation without a GUI as fast as possible and reports the throughput.\n"
+			"\t-n, --new-game BASE       Load game from BASE\n"
+			"\t-l, --load-game BASE SAVE Load game from BASE, with game state from SAVE\n"
+			"\t-g, --generate            Use a generated layout instead of loading a game\n"
+			"\t    --units N             Generated layout: number of units (default: 100)\n"
+			"\t    --autos N             Generated layout: auto signals per unit (default: 4)\n"
+			"\t    --trains N            Generated layout: number of trains (default: 50)\n"
+			"\t    --set-routes          Generated layout: set all main line routes after loading\n"
+			"\t    --dump FILE           Generated layout: write the layout to FILE\n"
+			"\t    --scale PIECES        Run the generated layout at doubling sizes up to PIECES track pieces\n"
+			"\t-t, --time MS             Game time to simulate in ms (default: 3600000)\n"
+			"\t-s, --step MS             Game time step in ms (default: 50)\n"
+			"\t-c, --cmd CMD             Execute text command CMD after loading, may be repeated\n"
+			"\t-j, --threads N           Number of threads to use for train stepping (default: 1)\n"
+			"\t    --poll-signals        Update every signal on every tick instead of only those with changed inputs\n"
+			"\t    --table-braking       Interpolate train braking speeds from tables instead of calculating them exactly\n"
+			"\t    --projections         Keep train arrival time projections up to date on every step\n"
+			"\t    --no-free-running     Check every train's lookahead on every step, even when nothing in it can limit the train's speed\n"
+			"\t-f, --fast-forward        Skip over steps during which nothing can change\n"
+			"\t-q, --quiet               Do not print user messages\n"
+			"\t-h, --help                Show this help\n", name);
+}
+
+static void PrintCounts(const sim::layout_gen_counts &counts) {
+	printf("Generated layout: %u pieces: %u track_seg, %u points, %u route_signal, %u auto_signal, %u routing_marker, %u trains\n",
+			counts.total_pieces, counts.track_segs, counts.points, counts.route_signals, counts.auto_signals, counts.routing_markers, counts.trains);
+}
+
+static bool LoadAndRun(sim::sim_world &w, const std::string &base, const std::string &save, const std::vector<std::string> &cmds,
+		world_time duration, world_time step, bool fast_forward, sim::phase_timer &pt, bool verbose) {
+	error_collection ec;
+	world_deserialisation ws(w);
+	sim::LoadGamePhased(ws, w, base, save, ec, pt);
+	if (ec.GetErrorCount()) {
+		std::cerr << "One or more errors occurred, aborting:\n" << ec << "\n";
+		return false;
+	}
+
+	for (auto &it : cmds) {
+		text_command_handler handler(it, w);
+		if (!handler.Execute()) {
+			fprintf(stderr, "Text command failed: %s\n", it.c_str());
+			return false;
+		}
+	}
+
+	sim::sim_result res;
+	pt.Run("GameStep", [&]() {
+		res = sim::RunSimulation(w, duration, step, fast_forward);
+	});
+
+	if (verbose) {
+		unsigned int train_count = w.EnumerateTrains([](const train &) { });
+		printf("Trains:          %u\n", train_count);
+		printf("Step threads:    %u\n", w.GetTrainStepThreadCount());
+		printf("Signal updates:  %s\n", w.GetTickUpdateMode() == TICK_UPDATE_MODE::POLL ? "poll" : "event");
+		printf("Braking speeds:  %s\n", w.GetBrakingProfileMode() == BRAKING_PROFILE_MODE::TABLE ? "table" : "strict");
+		if (w.AreTrainProjectionsEnabled()) {
+			unsigned int projections = 0;
+			w.EnumerateTrains([&](const train &t) {
+				projections += t.GetProjection().GetProjectionCount();
+			});
+			printf("Projections:     %u recalculated\n", projections);
+		}
+		printf("Simulated:       %.3f s in %" PRIu64 " steps of %u ms\n", res.GetSimSeconds(), res.steps, step);
+		printf("Wall time:       %.3f s\n", res.wall_seconds);
+		printf("Throughput:      %.1f sim-sec/wall-sec\n", res.GetSimSecondsPerWallSecond());
+		printf("User messages:   %" PRIu64 "\n", w.GetMessageCount());
+	}
+	return true;
+}
+
+static bool RunScaling(sim::layout_gen_params params, bool have_trains, bool set_routes, unsigned int max_pieces,
+		world_time duration, world_time step, bool fast_forward, unsigned int threads, bool poll_signals, bool table_braking, bool projections, bool free_running) {
+	std::vector<unsigned int> sizes;
+	for (unsigned int pieces = 250; pieces < max_pieces; pieces *= 2) {
+		sizes.push_back(pieces);
+	}
+	sizes.push_back(max_pieces);
+
+	printf("%8s %6s %10s %10s %10s %10s %10s %12s %12s %16s\n", "Pieces", "Trains", "Parse", "LayoutInit", "PostLayout", "GameState", "GameStep", "Sim/wall", "Mem (KiB)", "Proc peak (KiB)");
+	for (unsigned int pieces : sizes) {
+		params.units = sim::layout_generator::UnitsForPieceCount(pieces, params.auto_signals);
+		if (!have_trains) {
+			params.trains = params.units;
+		}
+		sim::layout_generator gen(params);
+		std::vector<std::string> cmds;
+		if (set_routes) {
+			cmds = gen.GetRouteSettingCommands();
+		}
+
+		sim::phase_timer pt;
+		{
+			sim::sim_world w;
+			w.SetQuiet(true);
+			w.SetTrainStepThreadCount(threads);
+			if (poll_signals) {
+				w.SetTickUpdateMode(TICK_UPDATE_MODE::POLL);
+			}
+			if (table_braking) {
+				w.SetBrakingProfileMode(BRAKING_PROFILE_MODE::TABLE);
+			}
+			w.SetTrainProjectionsEnabled(projections);
+			w.SetTrainFreeRunningEnabled(free_running);
+			if (!LoadAndRun(w, gen.GetJson(), "", cmds, duration, step, fast_forward, pt, false)) {
+				return false;
+			}
+		}
+
+		const std::vector<sim::phase_result> &phases = pt.GetPhases();
+		printf("%8u %6u", gen.GetCounts().total_pieces, gen.GetCounts().trains);
+		int64_t rss_delta_kb = 0;
+		for (auto &it : phases) {
+			printf(" %10.4f", it.wall_seconds);
+			rss_delta_kb += it.rss_delta_kb;
+		}
+		double gamestep = phases.back().wall_seconds;
+		printf(" %12.1f %12" PRId64 " %16" PRIu64 "\n", gamestep > 0.0 ? (duration / 1000.0) / gamestep : 0.0, rss_delta_kb, phases.back().mem.peak_kb);
+		fflush(stdout);
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	CSO args(argc, argv, g_rgOptions, SO_O_CLUMP|SO_O_EXACT|SO_O_SHORTARG|SO_O_FILEARG|SO_O_CLUMP_ARGD|SO_O_NOSLASH);
+	auto argerror = [&](const char* err) {
+		fprintf(stderr, "Command line processing error: %s, arg: %s\n", err, args.OptionText());
+	};
+
+	std::string base;
+	std::string save;
+	bool have_game = false;
+	world_time duration = 3600000;
+	world_time step = 50;
+	bool quiet = false;
+	std::vector<std::string> cmds;
+	bool generate = false;
+	sim::layout_gen_params gen_params;
+	bool have_trains = false;
+	bool set_routes = false;
+	std::string dump_file;
+	unsigned int scale_pieces = 0;
+	unsigned int threads = 1;
+	bool poll_signals = false;
+	bool table_braking = false;
+	bool projections = false;
+	bool free_running = true;
+	bool fast_forward = false;
+
+	auto set_game = [&](const std::string &b, const std::string &s) -> bool {
+		if (have_game) {
+			argerror("More than one new game/load game specified");
+			return false;
+		}
+		base = b;
+		save = s;
+		have_game = true;
+		return true;
+	};
+
+	auto parse_num = [&](unsigned int &out) -> bool {
+		std::string arg = args.OptionArg();
+		if (!ownstrtonum(out, arg.c_str(), arg.size())) {
+			argerror("Invalid numeric value");
+			return false;
+		}
+		return true;
+	};
+
+	while (args.Next()) {
+		if (args.LastError() != SO_SUCCESS) {
+			argerror(cmdlineargerrorstr(args.LastError()));
+			return 1;
+		}
+
+		switch (args.OptionId()) {
+			case OPT_NEWGAME:
+				if (!set_game(args.OptionArg(), "")) {
+					return 1;
+				}
+				break;
+
+			case OPT_LOAD: {
+				if (args.m_nNextOption + 1 > args.m_nLastArg) {
+					argerror(cmdlineargerrorstr(SO_ARG_MISSING));
+					return 1;
+				}
+				std::string str1 = args.OptionArg();
+				std::string str2 = args.m_argv[args.m_nNextOption++];
+				if (!set_game(str1, str2)) {
+					return 1;
+				}
+				break;
+			}
+
+			case OPT_TIME:
+				if (!parse_num(duration)) {
+					return 1;
+				}
+				break;
+
+			case OPT_STEP:
+				if (!parse_num(step) || !step) {
+					return 1;
+				}
+				break;
+
+			case OPT_CMD:
+				cmds.emplace_back(args.OptionArg());
+				break;
+
+			case OPT_QUIET:
+				quiet = true;
+				break;
+
+			case OPT_GENERATE:
+				generate = true;
+				break;
+
+			case OPT_UNITS:
+				if (!parse_num(gen_params.units)) {
+					return 1;
+				}
+				break;
+
+			case OPT_AUTOS:
+				if (!parse_num(gen_params.auto_signals)) {
+					return 1;
+				}
+				break;
+
+			case OPT_TRAINS:
+				if (!parse_num(gen_params.trains)) {
+					return 1;
+				}
+				have_trains = true;
+				break;
+
+			case OPT_SET_ROUTES:
+				set_routes = true;
+				break;
+
+			case OPT_DUMP:
+				dump_file = args.OptionArg();
+				break;
+
+			case OPT_SCALE:
+				if (!parse_num(scale_pieces) || !scale_pieces) {
+					return 1;
+				}
+				break;
+
+			case OPT_THREADS:
+				if (!parse_num(threads) || !threads) {
+					return 1;
+				}
+				break;
+
+			case OPT_POLL_SIGNALS:
+				poll_signals = true;
+				break;
+
+			case OPT_TABLE_BRAKING:
+				table_braking = true;
+				break;
+
+			case OPT_PROJECTIONS:
+				projections = true;
+				break;
+
+			case OPT_NO_FREE_RUNNING:
+				free_running = false;
+				break;
+
+			case OPT_FAST_FORWARD:
+				fast_forward = true;
+				break;
+
+			case OPT_HELP:
+				usage(argv[0]);
+				return 0;
+		}
+	}
+
+	if (scale_pieces) {
+		if (have_game || generate) {
+			argerror("--scale cannot be used with a loaded or generated game");
+			return 1;
+		}
+		return RunScaling(gen_params, have_trains, set_routes, scale_pieces, duration, step, fast_forward, threads, poll_signals, table_braking, projections, free_running) ? 0 : 1;
+	}
+
+	if (have_game == generate) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (generate) {
+		sim::layout_generator gen(gen_params);
+		base = gen.GetJson();
+		PrintCounts(gen.GetCounts());
+		if (set_routes) {
+			std::vector<std::string> route_cmds = gen.GetRouteSettingCommands();
+			cmds.insert(cmds.begin(), route_cmds.begin(), route_cmds.end());
+		}
+		if (!dump_file.empty()) {
+			FILE *f = fopen(dump_file.c_str(), "w");
+			if (!f || fwrite(base.data(), 1, base.size(), f) != base.size()) {
+				fprintf(stderr, "Could not write generated layout to: %s\n", dump_file.c_str());
+				if (f) {
+					fclose(f);
+				}
+				return 1;
+			}
+			fclose(f);
+		}
+	} else {
+		error_collection ec;
+		std::string base_content;
+		std::string save_content;
+		if (!slurp_file(base, base_content, ec) || (!save.empty() && !slurp_file(save, save_content, ec))) {
+			std::cerr << "One or more errors occurred, aborting:\n" << ec << "\n";
+			return 1;
+		}
+		base = std::move(base_content);
+		save = std::move(save_content);
+	}
+
+	std::unique_ptr<sim::sim_world> w(new sim::sim_world);
+	w->SetQuiet(quiet);
+	w->SetTrainStepThreadCount(threads);
+	if (poll_signals) {
+		w->SetTickUpdateMode(TICK_UPDATE_MODE::POLL);
+	}
+	if (table_braking) {
+		w->SetBrakingProfileMode(BRAKING_PROFILE_MODE::TABLE);
+	}
+	w->SetTrainProjectionsEnabled(projections);
+	w->SetTrainFreeRunningEnabled(free_running);
+
+	sim::phase_timer pt;
+	if (!LoadAndRun(*w, base, save, cmds, duration, step, fast_forward, pt, true)) {
+		return 1;
+	}
+	pt.Print(stdout);
+	return 0;
+}
@@ -0,0 +1,128 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2015 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#include "common.h"
+#include "sim/sim.h"
+#include "core/world_serialisation.h"
+#include <chrono>
+#include <cinttypes>
+#include <iostream>
+#include <fstream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace sim {
+
+	void sim_world::LogUserMessageLocal(LOG_CATEGORY lc, const std::string &message) {
+		message_count++;
+		if (!quiet) {
+			world::LogUserMessageLocal(lc, message);
+		}
+	}
+
+	double sim_result::GetSimSecondsPerWallSecond() const {
+		if (wall_seconds <= 0.0) {
+			return 0.0;
+		}
+		return GetSimSeconds() / wall_seconds;
+	}
+
+	double GetWallTime() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	sim_result RunSimulation(world &w, world_time duration_ms, world_time step_ms, bool fast_forward) {
+		sim_result res;
+		if (!step_ms) {
+			step_ms = 1;
+		}
+		res.start_time = w.GetGameTime();
+		world_time target = res.start_time + duration_ms;
+
+		double start = GetWallTime();
+		if (fast_forward) {
+			res.steps = w.FastForward(target, step_ms);
+		}
+		while (w.GetGameTime() < target) {
+			world_time remaining = target - w.GetGameTime();
+			w.GameStep(remaining < step_ms ? remaining : step_ms);
+			res.steps++;
+		}
+		res.wall_seconds = GetWallTime() - start;
+		res.end_time = w.GetGameTime();
+		return res;
+	}
+
+	mem_usage GetMemUsage() {
+		mem_usage mem;
+#ifndef _WIN32
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0) {
+			mem.peak_kb = usage.ru_maxrss;
+		}
+		std::ifstream statm("/proc/self/statm");
+		uint64_t size, resident;
+		if (statm >> size >> resident) {
+			mem.current_kb = resident * (sysconf(_SC_PAGESIZE) / 1024);
+		}
+#endif
+		return mem;
+	}
+
+	void phase_timer::Print(FILE *f) const {
+		fprintf(f, "%-16s %12s %16s %12s %18s\n", "Phase", "Time (s)", "RSS delta (KiB)", "RSS (KiB)", "Proc peak (KiB)");
+		for (auto &it : phases) {
+			fprintf(f, "%-16s %12.4f %16" PRId64 " %12" PRIu64 " %18" PRIu64 "\n", it.name.c_str(), it.wall_seconds, it.rss_delta_kb, it.mem.current_kb, it.mem.peak_kb);
+		}
+	}
+
+	void LoadGamePhased(world_deserialisation &ws, world &w, const std::string &base, const std::string &save, error_collection &ec, phase_timer &pt) {
+		pt.Run("Parse", [&]() {
+			if (!base.empty()) {
+				ws.ParseInputString(base, ec);
+			}
+			if (!save.empty()) {
+				ws.ParseInputString(save, ec, world_deserialisation::WS_LOAD_GAME_FLAGS::NO_CONTENT | world_deserialisation::WS_LOAD_GAME_FLAGS::TRY_REPLACE_GAME_STATE);
+			}
+		});
+		if (ec.GetErrorCount()) {
+			return;
+		}
+
+		pt.Run("LayoutInit", [&]() {
+			w.LayoutInit(ec);
+		});
+		if (ec.GetErrorCount()) {
+			return;
+		}
+
+		pt.Run("PostLayoutInit", [&]() {
+			w.PostLayoutInit(ec);
+		});
+		if (ec.GetErrorCount()) {
+			return;
+		}
+
+		pt.Run("GameState", [&]() {
+			ws.DeserialiseGameState(ec);
+		});
+	}
+
+};
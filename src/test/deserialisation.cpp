@@ -222,6 +222,62 @@ TEST_CASE( "deserialisation/scalartypeconv/length", "Test scalar type conversion
 	CHECK(PTR_CHECK(env.w->FindTrackByName("#4"))->GetLength(EDGE::FRONT) == 4294966826);
 }
 
+TEST_CASE( "deserialisation/trackids", "Test dense track ID allocation and lookup" ) {
+	std::string track_test_str =
+	R"({ "content" : [ )"
+		R"({ "type" : "track_seg", "name" : "T1", "length" : 1000, "connect" : { "to" : "T3" } }, )"
+		R"({ "type" : "track_seg", "name" : "T2", "length" : 1000 }, )"
+		R"({ "type" : "track_seg", "name" : "T3", "length" : 1000 } )"
+	"] }";
+	test_fixture_world env(track_test_str);
+
+	if (env.ec.GetErrorCount()) {
+		WARN("Error Collection: " << env.ec);
+	}
+	REQUIRE(env.ec.GetErrorCount() == 0);
+
+	REQUIRE(env.w->GetTrackIdCount() == 3);
+	CHECK(env.w->FindTrackId("T1") < 3);
+	CHECK(env.w->FindTrackId("T2") < 3);
+	CHECK(env.w->FindTrackId("T3") < 3);
+	CHECK(env.w->FindTrackId("T4") == INVALID_TRACK_ID);
+	for (track_id_type id = 0; id < env.w->GetTrackIdCount(); id++) {
+		generic_track *piece = PTR_CHECK(env.w->GetTrackById(id));
+		CHECK(piece->GetTrackId() == id);
+		CHECK(piece->GetName() == env.w->GetTrackNameById(id));
+		CHECK(env.w->FindTrackByName(piece->GetName()) == piece);
+	}
+	CHECK(env.w->GetTrackById(3) == nullptr);
+}
+
+TEST_CASE( "deserialisation/trackids/lookups", "Test that looking up track names does not allocate track IDs" ) {
+	std::string track_test_str =
+	R"({ "content" : [ )"
+		R"({ "type" : "start_of_line", "name" : "A" }, )"
+		R"({ "type" : "track_seg", "name" : "#edge0", "length" : 1000 }, )"
+		R"({ "type" : "route_signal", "name" : "S1", "route_restrictions" : [ { "targets" : "X1", "via" : "X2", "deny" : "all" } ] }, )"
+		R"({ "type" : "track_seg", "name" : "T2", "length" : 1000 } )"
+	"] }";
+	test_fixture_world env(track_test_str);
+	env.w->CapAllTrackPieceUnconnectedEdges();
+	env.w->LayoutInit(env.ec);
+
+	if (env.ec.GetErrorCount()) {
+		WARN("Error Collection: " << env.ec);
+	}
+	REQUIRE(env.ec.GetErrorCount() == 0);
+
+	CHECK(env.w->FindTrackId("X1") == INVALID_TRACK_ID);
+	CHECK(env.w->FindTrackId("X2") == INVALID_TRACK_ID);
+
+	// the unconnected end of T2 is capped with a new piece, which must not clash with the existing #edge0
+	CHECK(env.w->GetTrackIdCount() == 5);
+	generic_track *cap = PTR_CHECK(PTR_CHECK(env.w->FindTrackByName("T2"))->GetEdgeConnectingPiece(EDGE::BACK).track);
+	CHECK(cap->GetName() == "#edge1");
+	CHECK(env.w->FindTrackByName("#edge1") == cap);
+	CHECK(PTR_CHECK(env.w->FindTrackByName("#edge0"))->GetEdgeConnectingPiece(EDGE::BACK).track == env.w->FindTrackByName("S1"));
+}
+
 TEST_CASE( "deserialisation/scalartypeconv/errors", "Test scalar type conversion error detection" ) {
 	auto check_parse_err = [&](const std::string &str) {
 		test_fixture_world env_err(str);
@@ -0,0 +1,237 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2013 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#include "test/catch.hpp"
+#include "core/future.h"
+#include "core/world.h"
+#include "core/track_circuit.h"
+#include <algorithm>
+#include <climits>
+#include <map>
+
+namespace {
+	struct test_futurable : public futurable_obj { };
+
+	struct test_future : public future {
+		std::vector<future_id_type> &log;
+		future_id_type id;
+
+		test_future(futurable_obj &targ, world_time ft, future_id_type id_, std::vector<future_id_type> &log_)
+				: future(targ, ft, id_), log(log_), id(id_) { }
+		virtual void ExecuteAction() override { log.push_back(id); }
+		virtual std::string GetTypeSerialisationName() const override { return "test_future"; }
+	};
+};
+
+TEST_CASE( "future/set/order", "Test future set execution order, including ties and far future trigger times" ) {
+	test_futurable targ;
+	std::vector<future_id_type> log;
+	future_set fs;
+
+	world_time times[] = { 500, 3, 70000000, 64, 63, 500, 4096, 0, 4095, 500, 70000000, 1u << 31, 65 };
+	future_id_type id = 1;
+	for (world_time t : times) {
+		fs.RegisterFuture(std::make_shared<test_future>(targ, t, id++, log));
+	}
+	CHECK(fs.GetCount() == 13);
+
+	std::vector<future_id_type> enum_order;
+	fs.EnumerateRegisteredFutures([&](world_time ft, const std::shared_ptr<future> &f) {
+		enum_order.push_back(static_cast<test_future &>(*f).id);
+	});
+	CHECK(enum_order == std::vector<future_id_type>({ 8, 2, 5, 4, 13, 1, 6, 10, 9, 7, 3, 11, 12 }));
+
+	fs.ExecuteUpTo(2);
+	CHECK(log == std::vector<future_id_type>({ 8 }));
+	fs.ExecuteUpTo(64);
+	CHECK(log == std::vector<future_id_type>({ 8, 2, 5, 4 }));
+	fs.ExecuteUpTo(499);
+	CHECK(log == std::vector<future_id_type>({ 8, 2, 5, 4, 13 }));
+	fs.ExecuteUpTo(500);
+	CHECK(log == std::vector<future_id_type>({ 8, 2, 5, 4, 13, 1, 6, 10 }));
+	log.clear();
+	fs.ExecuteUpTo(69999999);
+	CHECK(log == std::vector<future_id_type>({ 9, 7 }));
+	log.clear();
+	fs.ExecuteUpTo(UINT_MAX);
+	CHECK(log == std::vector<future_id_type>({ 3, 11, 12 }));
+	CHECK(fs.GetCount() == 0);
+	CHECK(!targ.HaveFutures());
+}
+
+TEST_CASE( "future/set/remove", "Test future set removal and registration during execution" ) {
+	test_futurable targ;
+	std::vector<future_id_type> log;
+	future_set fs;
+
+	std::vector<std::shared_ptr<test_future> > futures;
+	world_time times[] = { 10, 10, 10, 100, 5000, 300000 };
+	future_id_type id = 1;
+	for (world_time t : times) {
+		futures.push_back(std::make_shared<test_future>(targ, t, id++, log));
+		fs.RegisterFuture(futures.back());
+	}
+	fs.RemoveFuture(*futures[1]);
+	fs.RemoveFuture(*futures[4]);
+	CHECK(fs.GetCount() == 4);
+
+	fs.ExecuteUpTo(200);
+	CHECK(log == std::vector<future_id_type>({ 1, 3, 4 }));
+
+	//A future registered in the past, or at the current time, is executed on the next call
+	fs.RegisterFuture(std::make_shared<test_future>(targ, 150, id++, log));
+	fs.RegisterFuture(std::make_shared<test_future>(targ, 200, id++, log));
+	fs.ExecuteUpTo(200);
+	CHECK(log == std::vector<future_id_type>({ 1, 3, 4, 7, 8 }));
+
+	fs.RemoveFuture(*futures[5]);
+	fs.ExecuteUpTo(1000000);
+	CHECK(log == std::vector<future_id_type>({ 1, 3, 4, 7, 8 }));
+	CHECK(fs.GetCount() == 0);
+	CHECK(!targ.HaveFutures());
+}
+
+TEST_CASE( "future/set/reference", "Compare future set against a reference ordered multimap" ) {
+	test_futurable targ;
+	std::vector<future_id_type> log;
+	std::vector<future_id_type> ref_log;
+	future_set fs;
+	std::multimap<world_time, std::shared_ptr<test_future> > ref;
+	std::vector<std::shared_ptr<test_future> > live;
+
+	uint32_t seed = 12345;
+	auto rand = [&]() -> uint32_t {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	};
+
+	world_time now = 0;
+	future_id_type id = 1;
+	for (unsigned int round = 0; round < 2000; round++) {
+		unsigned int adds = rand() % 4;
+		for (unsigned int i = 0; i < adds; i++) {
+			world_time delay;
+			switch (rand() % 4) {
+				case 0: delay = rand() % 8; break;
+				case 1: delay = rand() % 200; break;
+				case 2: delay = rand() % 20000; break;
+				default: delay = rand() % 5000000; break;
+			}
+			auto f = std::make_shared<test_future>(targ, now + delay, id++, log);
+			fs.RegisterFuture(f);
+			ref.insert(std::make_pair(f->GetTriggerTime(), f));
+			live.push_back(f);
+		}
+		if (!live.empty() && rand() % 3 == 0) {
+			size_t index = rand() % live.size();
+			std::shared_ptr<test_future> f = live[index];
+			auto range = ref.equal_range(f->GetTriggerTime());
+			for (auto it = range.first; it != range.second; ++it) {
+				if (it->second == f) {
+					ref.erase(it);
+					fs.RemoveFuture(*f);
+					break;
+				}
+			}
+		}
+
+		now += rand() % 300;
+		fs.ExecuteUpTo(now);
+		auto past_end = ref.upper_bound(now);
+		for (auto it = ref.begin(); it != past_end; ++it) {
+			ref_log.push_back(it->second->id);
+		}
+		ref.erase(ref.begin(), past_end);
+		REQUIRE(log == ref_log);
+		REQUIRE(fs.GetCount() == ref.size());
+		world_time next_ft = 0;
+		REQUIRE(fs.GetNextTriggerTime(next_ft) == !ref.empty());
+		if (!ref.empty()) {
+			REQUIRE(next_ft == ref.begin()->first);
+		}
+		live.erase(std::remove_if(live.begin(), live.end(), [&](const std::shared_ptr<test_future> &f) {
+			return f.use_count() == 1;
+		}), live.end());
+	}
+
+	std::vector<future_id_type> enum_order;
+	fs.EnumerateRegisteredFutures([&](world_time ft, const std::shared_ptr<future> &f) {
+		enum_order.push_back(static_cast<test_future &>(*f).id);
+	});
+	std::vector<future_id_type> ref_order;
+	for (auto &it : ref) {
+		ref_order.push_back(it.second->id);
+	}
+	CHECK(enum_order == ref_order);
+}
+
+TEST_CASE( "future/futurable/enumerate", "Test futurable object future enumeration order and removal during enumeration" ) {
+	test_futurable targ;
+	std::vector<future_id_type> log;
+	future_set fs;
+
+	world_time times[] = { 400, 100, 300, 100, 200 };
+	future_id_type id = 1;
+	for (world_time t : times) {
+		fs.RegisterFuture(std::make_shared<test_future>(targ, t, id++, log));
+	}
+
+	auto get_ids = [&]() {
+		std::vector<future_id_type> ids;
+		targ.EnumerateFutures([&](const future &f) {
+			ids.push_back(static_cast<const test_future &>(f).id);
+		});
+		return ids;
+	};
+	CHECK(get_ids() == std::vector<future_id_type>({ 1, 2, 3, 4, 5 }));
+
+	std::vector<future_id_type> seen;
+	targ.EnumerateFutures([&](future &f) {
+		future_id_type fid = static_cast<test_future &>(f).id;
+		seen.push_back(fid);
+		if (fid == 2 || fid == 5) {
+			fs.RemoveFuture(f);
+		}
+		if (fid == 3) {
+			fs.RegisterFuture(std::make_shared<test_future>(targ, 250, id++, log));
+		}
+	});
+	CHECK(seen == std::vector<future_id_type>({ 1, 2, 3, 4, 5, 6 }));
+	CHECK(get_ids() == std::vector<future_id_type>({ 1, 3, 4, 6 }));
+
+	fs.ExecuteUpTo(300);
+	CHECK(log == std::vector<future_id_type>({ 4, 6, 3 }));
+	CHECK(get_ids() == std::vector<future_id_type>({ 1 }));
+	CHECK(targ.HaveFutures());
+	fs.ExecuteUpTo(400);
+	CHECK(!targ.HaveFutures());
+}
+
+TEST_CASE( "future/futurable/worlddestruction", "Test destroying a world with futures still pending on its track circuits and triggers" ) {
+	std::vector<future_id_type> log;
+	std::unique_ptr<world> w(new world);
+	track_circuit *tc = w->track_circuits.FindOrMakeByName("T1");
+	track_train_counter_block *trigger = w->track_triggers.FindOrMakeByName("TR1");
+	w->futures.RegisterFuture(std::make_shared<test_future>(*tc, 100, w->MakeNewFutureID(), log));
+	w->futures.RegisterFuture(std::make_shared<test_future>(*trigger, 200, w->MakeNewFutureID(), log));
+	w->futures.RegisterFuture(std::make_shared<test_future>(*w, 300, w->MakeNewFutureID(), log));
+	CHECK(tc->HaveFutures());
+	CHECK(trigger->HaveFutures());
+	w.reset();
+	CHECK(log.empty());
+}
@@ -229,10 +229,12 @@ TEST_CASE( "lookahead/unrouted", "Test unrouted track lookahead" ) {
 	CheckLookaheadResult(pos, map, 50000, 0);
 	FinaliseLookaheadCheck(pos, map);
 
+	unsigned int scan_count = l.GetScanCount();
 	p1->SetPointsFlagsMasked(0, points::PTF::REV, points::PTF::OOC | points::PTF::REV);
 	CheckLookahead(nullptr, l, pos, map);
 	CheckLookaheadResult(pos, map, 450000, 0);
 	FinaliseLookaheadCheck(pos, map);
+	CHECK(l.GetScanCount() == scan_count + 1);    // only rescanned from the points onwards
 
 	p1->SetPointsFlagsMasked(0, points::PTF::ZERO, points::PTF::REV);
 	CheckLookahead(nullptr, l, pos, map);
@@ -261,6 +263,133 @@ TEST_CASE( "lookahead/unrouted", "Test unrouted track lookahead" ) {
 	FinaliseLookaheadCheck(pos, map);
 }
 
+TEST_CASE( "lookahead/alternativeroute", "Test lookahead rescan when a signal is rerouted to the same end signal by a different route" ) {
+	test_fixture_world_init_checked env(
+		R"({ "content" : [ )"
+			R"({ "type" : "start_of_line", "name" : "A" }, )"
+			R"({ "type" : "track_seg", "length" : 500000 }, )"
+			R"({ "type" : "route_signal", "name" : "S0", "route_signal" : true, "sighting" : 2000000, "max_aspect" : 3 }, )"
+			R"({ "type" : "track_seg", "length" : 500000, "name" : "T1" }, )"
+			R"({ "type" : "route_signal", "name" : "S1", "route_signal" : true, "sighting" : 2000000, "max_aspect" : 3 }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "points", "name" : "P1" }, )"
+			R"({ "type" : "track_seg", "length" : 400000, "speed_limits" : [ { "speed_class" : "", "speed" : 100 } ] }, )"
+			R"({ "type" : "points", "name" : "P2", "reverse_auto_connection" : true }, )"
+			R"({ "type" : "track_seg", "length" : 500000 }, )"
+			R"({ "type" : "route_signal", "name" : "S2", "route_signal" : true, "sighting" : 2000000, "max_aspect" : 3 }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "end_of_line", "name" : "B" }, )"
+			R"({ "type" : "track_seg", "length" : 400000, "speed_limits" : [ { "speed_class" : "", "speed" : 300 } ], )"
+					R"("connect" : { "from_direction" : "front", "to" : "P1", "to_direction" : "reverse" } }, )"
+			R"({ "type" : "track_seg", "length" : 0, "connect" : { "from_direction" : "back", "to" : "P2", "to_direction" : "reverse" } } )"
+		"] }"
+	);
+
+	generic_track *t1 = PTR_CHECK(env.w->FindTrackByName("T1"));
+	generic_signal *s0 = PTR_CHECK(env.w->FindTrackByNameCast<generic_signal>("S0"));
+	generic_signal *s1 = PTR_CHECK(env.w->FindTrackByNameCast<generic_signal>("S1"));
+	generic_signal *s2 = PTR_CHECK(env.w->FindTrackByNameCast<generic_signal>("S2"));
+	routing_point *b = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("B"));
+	points *p1 = PTR_CHECK(env.w->FindTrackByNameCast<points>("P1"));
+	points *p2 = PTR_CHECK(env.w->FindTrackByNameCast<points>("P2"));
+
+	env.w->SubmitAction(action_reserve_path(*(env.w), s0, s1));
+	env.w->SubmitAction(action_reserve_path(*(env.w), s1, s2));
+	env.w->SubmitAction(action_reserve_path(*(env.w), s2, b));
+	env.w->GameStep(1);
+	CHECK(env.w->GetLogText() == "");
+	REQUIRE(s0->GetAspect() == 3);
+
+	lookahead l;
+	std::map<unsigned int, unsigned int> map;
+	track_location pos(t1, EDGE::FRONT, 100000);
+	l.Init(nullptr, pos, s0->GetCurrentForwardRoute());
+	CheckLookahead(nullptr, l, pos, map);
+	CheckLookaheadResult(pos, map, 500000, 100);
+	CheckLookaheadResult(pos, map, 1500000, 0);
+	FinaliseLookaheadCheck(pos, map);
+
+	// S1 is rerouted to S2 by the other route, and its aspect drops as S2 no longer has a route set
+	// The block from S1 to S2 must be rescanned, even though S1 still leads to S2
+	env.w->SubmitAction(action_unreserve_track_route(*(env.w), *PTR_CHECK(s1->GetCurrentForwardRoute())));
+	env.w->SubmitAction(action_unreserve_track_route(*(env.w), *PTR_CHECK(s2->GetCurrentForwardRoute())));
+	env.w->GameStep(1);
+	p1->SetPointsFlagsMasked(0, points::PTF::REV, points::PTF::REV);
+	p2->SetPointsFlagsMasked(0, points::PTF::REV, points::PTF::REV);
+	env.w->SubmitAction(action_reserve_path(*(env.w), s1, s2));
+	env.w->GameStep(1);
+	CHECK(env.w->GetLogText() == "");
+	CHECK(s1->GetAspectNextTarget() == s2);
+
+	CheckLookahead(nullptr, l, pos, map, lookahead::LA_ERROR::SIG_ASPECT_LESS_THAN_EXPECTED, track_target_ptr(s1, EDGE::FRONT));
+	CheckLookaheadResult(pos, map, 500000, 300);
+	CheckLookaheadResult(pos, map, 1400000, 0);
+	FinaliseLookaheadCheck(pos, map);
+}
+
+TEST_CASE( "lookahead/undo", "Test undoing changes to a lookahead" ) {
+
+	test_fixture_world_init_checked env(lookahead_test_str_1);
+
+	env.w->GameStep(1);
+
+	generic_track *ts3 = env.w->FindTrackByName("TS3");
+	REQUIRE(ts3 != nullptr);
+	points *p1 = env.w->FindTrackByNameCast<points>("P1");
+	REQUIRE(p1 != nullptr);
+
+	lookahead l;
+	lookahead::undo_state state;
+	std::map<unsigned int, unsigned int> map;
+	track_location pos(ts3, EDGE::FRONT, 100000);
+	l.Init(nullptr, pos, 0);
+	l.Advance(350000);
+	pos = track_location(ts3, EDGE::FRONT, 450000);
+
+	auto check_initial = [&]() {
+		CheckLookahead(nullptr, l, pos, map);
+		CheckLookaheadResult(pos, map, 50000, 100);
+		CheckLookaheadResult(pos, map, 550000, 0);
+		FinaliseLookaheadCheck(pos, map);
+	};
+	check_initial();
+	unsigned int scan_count = l.GetScanCount();
+
+	// nothing modified
+	l.StartUndoRecording(state);
+	check_initial();
+	l.StopUndoRecording();
+	l.Undo(state);
+	CHECK(l.GetScanCount() == scan_count);
+	check_initial();
+
+	// rescanned from the points
+	l.StartUndoRecording(state);
+	p1->SetPointsFlagsMasked(0, points::PTF::REV, points::PTF::REV);
+	CheckLookahead(nullptr, l, pos, map);
+	CheckLookaheadResult(pos, map, 450000, 0);
+	FinaliseLookaheadCheck(pos, map);
+	CHECK(l.GetScanCount() == scan_count + 1);
+	l.StopUndoRecording();
+	p1->SetPointsFlagsMasked(0, points::PTF::ZERO, points::PTF::REV);
+	l.Undo(state);
+	CHECK(l.GetScanCount() == scan_count);
+	check_initial();
+	CHECK(l.GetScanCount() == scan_count);    // the items from before the rescan were restored, so nothing needs rescanning
+
+	// advanced past items
+	l.StartUndoRecording(state);
+	l.Advance(350000);
+	l.StopUndoRecording();
+	l.Undo(state);
+	CHECK(l.GetCurrentOffset() == (((uint64_t) 1) << 32) + 350000);
+	check_initial();
+}
+
 TEST_CASE( "lookahead/tractiontype", "Test traction types lookahead" ) {
 
 	test_fixture_world_init_checked env(lookahead_test_str_2, true, true);
@@ -354,7 +483,7 @@ TEST_CASE( "lookahead/serialisation", "Test lookahead serialisation and deserial
 	};
 	auto compare_lookaheads = [&](lookahead &l1, lookahead &l2, const track_location &pos) {
 		std::forward_list<std::pair<unsigned int, unsigned int> > distances[2];
-		std::forward_list<std::pair<lookahead::LA_ERROR, const track_target_ptr &> > errors[2];
+		std::forward_list<std::pair<lookahead::LA_ERROR, track_target_ptr> > errors[2];
 
 		auto fill = [&](lookahead &l, unsigned int index) {
 			l.CheckLookaheads(nullptr, pos, [&](unsigned int distance, unsigned int speed) {
@@ -1429,6 +1429,93 @@ TEST_CASE( "signal/updates", "Test signal state and reservation state change upd
 	CHECK(t7->IsAnyPieceReserved() == false);
 }
 
+TEST_CASE( "signal/updates/event", "Test that event driven signal updates give identical results to polling every signal each tick" ) {
+	test_fixture_world_init_checked poll_env(overlaptimeout_test_str_1);
+	test_fixture_world_init_checked event_env(overlaptimeout_test_str_1);
+	poll_env.w->SetTickUpdateMode(TICK_UPDATE_MODE::POLL);
+	CHECK(poll_env.w->GetTickUpdateMode() == TICK_UPDATE_MODE::POLL);
+	CHECK(event_env.w->GetTickUpdateMode() == TICK_UPDATE_MODE::EVENT);
+
+	autosig_test_class_1 poll_tenv(*(poll_env.w));
+	autosig_test_class_1 event_tenv(*(event_env.w));
+
+	auto check_same = [&]() {
+		INFO("Game Time: " << poll_env.w->GetGameTime());
+		CHECK(poll_env.w->GetLastUpdateSet().size() == event_env.w->GetLastUpdateSet().size());
+		for (unsigned int i = 1; i <= 6; i++) {
+			std::string name = string_format("S%u", i);
+			INFO("Signal: " << name);
+			generic_signal *ps = PTR_CHECK(poll_env.w->FindTrackByNameCast<generic_signal>(name));
+			generic_signal *es = PTR_CHECK(event_env.w->FindTrackByNameCast<generic_signal>(name));
+			REQUIRE(ps->GetAspect() == es->GetAspect());
+			REQUIRE(ps->GetReservedAspect() == es->GetReservedAspect());
+			REQUIRE(ps->GetAspectType() == es->GetAspectType());
+			auto same_name = [&](const routing_point *p, const routing_point *e) {
+				return (!p && !e) || (p && e && p->GetName() == e->GetName());
+			};
+			REQUIRE(same_name(ps->GetAspectNextTarget(), es->GetAspectNextTarget()));
+			REQUIRE(same_name(ps->GetAspectRouteTarget(), es->GetAspectRouteTarget()));
+			REQUIRE((ps->GetCurrentForwardOverlap() != nullptr) == (es->GetCurrentForwardOverlap() != nullptr));
+		}
+	};
+
+	auto step = [&](world_time delta, unsigned int count) {
+		for (unsigned int i = 0; i < count; i++) {
+			poll_env.w->GameStep(delta);
+			event_env.w->GameStep(delta);
+			check_same();
+		}
+	};
+
+	auto both = [&](std::function<void(world &, autosig_test_class_1 &)> f) {
+		f(*(poll_env.w), poll_tenv);
+		f(*(event_env.w), event_tenv);
+	};
+
+	auto set_tc = [&](const std::string &tc, bool occupied) {
+		both([&](world &w, autosig_test_class_1 &tenv) {
+			w.track_circuits.FindOrMakeByName(tc)->SetTCFlagsMasked(occupied ? track_circuit::TCF::FORCE_OCCUPIED : track_circuit::TCF::ZERO,
+					track_circuit::TCF::FORCE_OCCUPIED);
+		});
+	};
+
+	step(1, 2);
+	both([&](world &w, autosig_test_class_1 &tenv) {
+		w.SubmitAction(action_reserve_path(w, tenv.s3, tenv.s4));
+		w.SubmitAction(action_reserve_path(w, tenv.s4, tenv.s5));
+	});
+	step(1, 3);
+	both([&](world &w, autosig_test_class_1 &tenv) {
+		w.SubmitAction(action_reserve_path(w, tenv.s5, tenv.s6));
+	});
+	step(1, 3);
+	set_tc("T2", true);
+	step(1, 3);
+	set_tc("T2", false);
+	set_tc("T6", true);
+	both([&](world &w, autosig_test_class_1 &tenv) {
+		w.SubmitAction(action_unreserve_track(w, *(tenv.s5)));
+	});
+	step(1, 3);
+	set_tc("T5", true);
+	both([&](world &w, autosig_test_class_1 &tenv) {
+		w.SubmitAction(action_unreserve_track(w, *(tenv.s4)));
+	});
+	step(1000, 120);
+	set_tc("T6", false);
+	set_tc("T5", false);
+	step(1, 3);
+	both([&](world &w, autosig_test_class_1 &tenv) {
+		w.SubmitAction(action_reserve_path(w, tenv.s4, tenv.s5));
+		w.SubmitAction(action_reserve_path(w, tenv.s5, tenv.s6));
+	});
+	step(1, 3);
+	set_tc("S1ovlp", true);
+	step(1, 3);
+	set_tc("S1ovlp", false);
+	step(500, 10);
+}
+
 TEST_CASE( "signal/propagation/repeater", "Test aspect propagation and route creation with aspected and non-aspected repeater signals") {
 	auto test = [&](bool nonaspected) {
 		INFO("Test: " << (nonaspected ? "non-" : "") << "aspected");
@@ -1680,3 +1767,218 @@ TEST_CASE("signal/aspect/conditional", "Test conditionally allowed signal aspect
 	test("1-3", 0xE, std::vector<unsigned int> { 1, 0, 0, 3, 3 }, true, R"( { "condition" : "1-2", "allowed_aspects" : "0" } )");
 	test("1-3", 0xE, std::vector<unsigned int> { 1, 0, 3, 3, 0 }, true, R"( { "condition" : "1-4", "allowed_aspects" : "3" }, { "condition" : "4", "allowed_aspects" : "4" } )");
 }
+
+TEST_CASE("signal/routing/index", "Test that route lookup by end and vias matches a search of all routes") {
+	test_fixture_world_init_checked env(
+		R"({ "content" : [ )"
+			R"({ "type" : "start_of_line", "name" : "A" }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "route_signal", "name" : "S1", "route_shunt_signal" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "points", "name" : "P1" }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "routing_marker", "name" : "V1", "via" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "points", "name" : "P2", "reverse_auto_connection" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "route_signal", "name" : "S2", "route_shunt_signal" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "end_of_line", "name" : "B" }, )"
+			R"({ "type" : "track_seg", "length" : 50000, "connect" : { "from_direction" : "front", "to" : "P1", "to_direction" : "reverse" } }, )"
+			R"({ "type" : "routing_marker", "name" : "V2", "via" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000, "connect" : { "from_direction" : "back", "to" : "P2", "to_direction" : "reverse" } } )"
+		"] }"
+	);
+
+	routing_point *s1 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("S1"));
+	routing_point *s2 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("S2"));
+	routing_point *b = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("B"));
+	routing_point *v1 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("V1"));
+	routing_point *v2 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("V2"));
+
+	auto check = [&](const routing_point *start, const routing_point *end, GMRF gmr_flags, const via_list &vias, unsigned int expected) {
+		INFO("Start: " << start->GetName() << ", end: " << (end ? end->GetName() : "none") << ", vias: " << vias.size());
+		std::vector<routing_point::gmr_route_item> out;
+		CHECK(start->GetMatchingRoutes(out, end, route_class::All(), gmr_flags | GMRF::DONT_SORT, RRF::ZERO, vias) == expected);
+
+		std::vector<const route *> all;
+		start->EnumerateRoutes([&](const route *r) {
+			if ((!end || r->end.track == end) && (!(gmr_flags & GMRF::CHECK_VIAS) || r->vias == vias)) {
+				all.push_back(r);
+			}
+		});
+		REQUIRE(out.size() == all.size());
+		for (size_t i = 0; i < out.size(); i++) {
+			CHECK(out[i].rt == all[i]);
+		}
+	};
+
+	check(s1, s2, GMRF::ZERO, via_list(), 4);
+	check(s1, s2, GMRF::CHECK_VIAS, via_list { v1 }, 2);
+	check(s1, s2, GMRF::CHECK_VIAS, via_list { v2 }, 2);
+	check(s1, s2, GMRF::CHECK_VIAS, via_list(), 0);
+	check(s1, s2, GMRF::CHECK_VIAS, via_list { v1, v2 }, 0);
+	check(s1, b, GMRF::ZERO, via_list(), 0);
+	check(s1, nullptr, GMRF::ZERO, via_list(), 4);
+	check(s2, b, GMRF::ZERO, via_list(), 2);
+
+	env.w->SubmitAction(action_reserve_path(*(env.w), s1, s2).SetVias(via_list { v2 })
+			.SetGmrFlags(GMRF::CHECK_VIAS | GMRF::DYNAMIC_PRIORITY).SetAllowedRouteTypes(route_class::Flag(route_class::ID::ROUTE)));
+	env.w->GameStep(1);
+	CHECK(env.w->GetLogText() == "");
+	const route *rt = PTR_CHECK(static_cast<generic_signal *>(s1)->GetCurrentForwardRoute());
+	CHECK(rt->vias == via_list { v2 });
+}
+
+TEST_CASE("signal/routing/conflicts", "Test that the precomputed route conflict matrix is consistent with route reservation") {
+	test_fixture_world_init_checked env(
+		R"({ "content" : [ )"
+			R"({ "type" : "start_of_line", "name" : "A" }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "route_signal", "name" : "S1", "route_shunt_signal" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "points", "name" : "P1" }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "routing_marker", "name" : "V1", "via" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "points", "name" : "P2", "reverse_auto_connection" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "route_signal", "name" : "S2", "route_shunt_signal" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000 }, )"
+			R"({ "type" : "end_of_line", "name" : "B" }, )"
+			R"({ "type" : "track_seg", "length" : 50000, "connect" : { "from_direction" : "front", "to" : "P1", "to_direction" : "reverse" } }, )"
+			R"({ "type" : "routing_marker", "name" : "V2", "via" : true }, )"
+			R"({ "type" : "track_seg", "length" : 50000, "connect" : { "from_direction" : "back", "to" : "P2", "to_direction" : "reverse" } } )"
+		"] }"
+	);
+
+	generic_signal *s1 = PTR_CHECK(env.w->FindTrackByNameCast<generic_signal>("S1"));
+	generic_signal *s2 = PTR_CHECK(env.w->FindTrackByNameCast<generic_signal>("S2"));
+	routing_point *v1 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("V1"));
+	routing_point *v2 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("V2"));
+
+	const route_conflict_matrix &conflicts = env.w->route_conflicts;
+	REQUIRE(conflicts.IsBuilt());
+
+	std::vector<const route *> s1_routes;
+	std::vector<const route *> all_routes;
+	s1->EnumerateRoutes([&](const route *r) {
+		s1_routes.push_back(r);
+		all_routes.push_back(r);
+	});
+	s2->EnumerateRoutes([&](const route *r) {
+		all_routes.push_back(r);
+	});
+	REQUIRE(s1_routes.size() == 4);
+	CHECK(conflicts.GetRouteCount() == all_routes.size());
+
+	for (const route *a : all_routes) {
+		for (const route *b : all_routes) {
+			INFO("Routes: " << a->parent->GetName() << "/" << a->index << ", " << b->parent->GetName() << "/" << b->index);
+			bool s1_pair = a->parent == s1 && b->parent == s1;
+			CHECK(conflicts.IsConflicting(*a, *b) == (s1_pair && a->vias != b->vias));
+			CHECK(conflicts.IsConflicting(*a, *b) == conflicts.IsConflicting(*b, *a));
+		}
+	}
+
+	auto check_consistency = [&](unsigned int expected_set, unsigned int expected_blocked) {
+		unsigned int set = 0;
+		unsigned int blocked = 0;
+		for (const route *r : all_routes) {
+			INFO("Route: " << r->parent->GetName() << "/" << r->index);
+			if (conflicts.IsRouteSet(*r)) {
+				set++;
+			}
+			if (r->IsReservationBlockedBySetRoute(RRF::TRY_RESERVE)) {
+				blocked++;
+				CHECK_FALSE(r->RouteReservation(RRF::TRY_RESERVE).IsSuccess());
+			}
+			CHECK_FALSE(r->IsReservationBlockedBySetRoute(RRF::TRY_RESERVE | RRF::IGNORE_EXISTING));
+		}
+		CHECK(set == expected_set);
+		CHECK(blocked == expected_blocked);
+	};
+
+	check_consistency(0, 0);
+
+	env.w->SubmitAction(action_reserve_path(*(env.w), s1, s2).SetVias(via_list { v2 })
+			.SetGmrFlags(GMRF::CHECK_VIAS | GMRF::DYNAMIC_PRIORITY).SetAllowedRouteTypes(route_class::Flag(route_class::ID::ROUTE)));
+	env.w->GameStep(1);
+	CHECK(env.w->GetLogText() == "");
+	const route *rt = PTR_CHECK(s1->GetCurrentForwardRoute());
+	CHECK(conflicts.IsRouteSet(*rt));
+	CHECK(s2->GetCurrentForwardOverlap() != nullptr);
+	check_consistency(2, 2);
+
+	test_fixture_world_init_checked env2 = RoundTripCloneTestFixtureWorld(env);
+	generic_signal *s1_2 = PTR_CHECK(env2.w->FindTrackByNameCast<generic_signal>("S1"));
+	const route *rt_2 = PTR_CHECK(s1_2->GetCurrentForwardRoute());
+	CHECK(env2.w->route_conflicts.IsRouteSet(*rt_2));
+	unsigned int blocked_2 = 0;
+	s1_2->EnumerateRoutes([&](const route *r) {
+		if (r->IsReservationBlockedBySetRoute(RRF::TRY_RESERVE)) {
+			blocked_2++;
+		}
+	});
+	CHECK(blocked_2 == 2);
+
+	std::vector<routing_point::gmr_route_item> out;
+	CHECK(s1->GetMatchingRoutes(out, s2, route_class::All(), GMRF::CHECK_VIAS | GMRF::CHECK_TRY_RESERVE, RRF::ZERO, via_list { v1 }) == 0);
+	CHECK(s1->GetMatchingRoutes(out, s2, route_class::All(), GMRF::CHECK_VIAS | GMRF::CHECK_TRY_RESERVE, RRF::ZERO, via_list { v2 }) == 2);
+
+	env.w->SubmitAction(action_unreserve_track_route(*(env.w), *rt));
+	env.w->GameStep(1);
+	env.w->GameStep(1);
+	CHECK(env.w->GetLogText() == "");
+	CHECK(s1->GetCurrentForwardRoute() == nullptr);
+	CHECK_FALSE(conflicts.IsRouteSet(*rt));
+	check_consistency(0, 0);
+}
+
+TEST_CASE("signal/routing/action_count", "Test that memoised route reservation action counts track points state") {
+	test_fixture_world_init_checked env(track_test_str_1);
+
+	generic_points *p1 = PTR_CHECK(env.w->FindTrackByNameCast<generic_points>("P1"));
+	routing_point *s1 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("S1"));
+	routing_point *s2 = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("S2"));
+
+	std::vector<const route *> all_routes;
+	for (const char *name : { "S1", "S2", "S3", "S4", "S6" }) {
+		PTR_CHECK(env.w->FindTrackByNameCast<routing_point>(name))->EnumerateRoutes([&](const route *r) {
+			all_routes.push_back(r);
+		});
+	}
+	REQUIRE(all_routes.size() > 0);
+
+	auto check = [&]() -> std::vector<unsigned int> {
+		std::vector<unsigned int> counts;
+		for (const route *r : all_routes) {
+			INFO("Route: " << r->parent->GetName() << "/" << r->index);
+			unsigned int expected = 0;
+			r->RouteReservationActions(RRF::RESERVE, [&](action &&reservation_act) {
+				expected++;
+			});
+			CHECK(r->GetReservationActionCount() == expected);
+			CHECK(r->GetReservationActionCount() == expected);
+			counts.push_back(expected);
+		}
+		return counts;
+	};
+
+	std::vector<unsigned int> initial = check();
+
+	env.w->SubmitAction(action_points_action(*(env.w), *p1, 0, true));
+	env.w->GameStep(30000);
+	CHECK(env.w->GetLogText() == "");
+	CHECK((p1->GetPointsFlags(0) & generic_points::PTF::REV) == generic_points::PTF::REV);
+	CHECK(check() != initial);
+
+	env.w->SubmitAction(action_reserve_path(*(env.w), s1, nullptr));
+	env.w->SubmitAction(action_reserve_path(*(env.w), s2, nullptr));
+	env.w->GameStep(30000);
+	check();
+}
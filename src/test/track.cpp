@@ -28,7 +28,9 @@
 #include "core/world.h"
 #include "core/world_serialisation.h"
 #include "core/track_ops.h"
+#include "core/route.h"
 #include "core/param.h"
+#include "core/serialisable_impl.h"
 
 struct test_fixture_track_1 {
 	world_test w;
@@ -256,6 +258,94 @@ TEST_CASE( "track/deserialisation/track", "Test basic track segment deserialisat
 	REQUIRE(sr->GetTrackSpeedLimitByClass("bar", UINT_MAX) == UINT_MAX);
 }
 
+TEST_CASE( "track/speed_restriction_set", "Test speed restriction lookup by interned speed class" ) {
+	world_test w;
+	speed_class_id_type foo = w.InternSpeedClass("foo");
+	speed_class_id_type bar = w.InternSpeedClass("bar");
+	REQUIRE(w.InternSpeedClass("") == 0);
+	REQUIRE(w.InternSpeedClass("foo") == foo);
+	REQUIRE(foo != bar);
+	REQUIRE(w.GetSpeedClassNameById(bar) == "bar");
+	REQUIRE(w.FindSpeedClassId("baz") == INVALID_SPEED_CLASS_ID);
+
+	speed_restriction_set srs;
+	REQUIRE(srs.GetTrackSpeedLimitByClass(foo, 50000) == 50000);
+	srs.AddSpeedRestriction(speed_restriction { 30000, bar });
+	srs.AddSpeedRestriction(speed_restriction { 20000, foo });
+	srs.AddSpeedRestriction(speed_restriction { 25000, foo });
+	REQUIRE(srs.GetTrackSpeedLimitByClass(foo, 50000) == 20000);
+	REQUIRE(srs.GetTrackSpeedLimitByClass(bar, 50000) == 30000);
+	REQUIRE(srs.GetTrackSpeedLimitByClass(0, 50000) == 50000);
+	REQUIRE(srs.GetTrackSpeedLimitByClass(INVALID_SPEED_CLASS_ID, 50000) == 50000);
+	srs.AddSpeedRestriction(speed_restriction { 22000, 0 });
+	REQUIRE(srs.GetTrackSpeedLimitByClass(foo, 50000) == 20000);
+	REQUIRE(srs.GetTrackSpeedLimitByClass(bar, 50000) == 22000);
+	REQUIRE(srs.GetTrackSpeedLimitByClass(INVALID_SPEED_CLASS_ID, 50000) == 22000);
+	REQUIRE(srs.GetTrackSpeedLimitByClass(bar, 10000) == 10000);
+
+	// without a world, a class specific restriction must not be applied to all trains
+	rapidjson::Document dc;
+	dc.Parse<0>(R"([ { "speed_class" : "foo", "speed" : 10000 }, { "speed_class" : "", "speed" : 15000 } ])");
+	deserialiser_input di(dc, "speed_limits", "speed_limits", nullptr);
+	error_collection ec;
+	speed_restriction_set noworld;
+	noworld.Deserialise(di, ec);
+	INFO("Error Collection: " << ec);
+	CHECK(ec.GetErrorCount() == 1);
+	CHECK(noworld.GetTrackSpeedLimitByClass(0, 50000) == 15000);
+	CHECK(noworld.GetTrackSpeedLimitByClass("foo", 50000) == 15000);
+}
+
+TEST_CASE( "track/reservation/undo", "Test rollback of reservations made using a backup guard, including nested savepoints" ) {
+	track_reservation_state trs;
+	route r1, r2, r3;
+
+	auto reserve = [&](const route *r, EDGE direction, RRF rr_flags, track_reservation_state_backup_guard *guard) -> bool {
+		return trs.Reservation(reservation_request_res(direction, 0, rr_flags, r).SetBackupGuard(guard)).IsSuccess();
+	};
+	auto contents = [&]() -> std::vector<std::pair<const route *, RRF> > {
+		std::vector<std::pair<const route *, RRF> > output;
+		trs.ReservationEnumeration([&](const route *reserved_route, EDGE direction, unsigned int index, RRF rr_flags) {
+			output.emplace_back(reserved_route, rr_flags & (RRF::RESERVE | RRF::PROVISIONAL_RESERVE));
+		}, RRF::RESERVE | RRF::PROVISIONAL_RESERVE);
+		return output;
+	};
+	typedef std::vector<std::pair<const route *, RRF> > state;
+
+	REQUIRE(reserve(&r1, EDGE::FRONT, RRF::RESERVE, nullptr));
+	REQUIRE(reserve(&r2, EDGE::FRONT, RRF::RESERVE, nullptr));
+	{
+		track_reservation_state_backup_guard guard;
+		size_t savepoint0 = guard.Savepoint();
+		REQUIRE(reserve(&r1, EDGE::FRONT, RRF::UNRESERVE, &guard));
+		REQUIRE(reserve(&r2, EDGE::FRONT, RRF::UNRESERVE, &guard));
+		REQUIRE(reserve(&r3, EDGE::BACK, RRF::PROVISIONAL_RESERVE, &guard));
+		CHECK(contents() == (state { { &r3, RRF::PROVISIONAL_RESERVE } }));
+
+		size_t savepoint1 = guard.Savepoint();
+		REQUIRE(reserve(&r3, EDGE::BACK, RRF::RESERVE, &guard));
+		CHECK(contents() == (state { { &r3, RRF::RESERVE } }));
+		{
+			track_reservation_state_backup_guard inner_guard;
+			REQUIRE(reserve(&r1, EDGE::BACK, RRF::RESERVE, &inner_guard));
+			CHECK(contents() == (state { { &r3, RRF::RESERVE }, { &r1, RRF::RESERVE } }));
+		}
+		CHECK(contents() == (state { { &r3, RRF::RESERVE } }));
+
+		guard.RollbackTo(savepoint1);
+		CHECK(contents() == (state { { &r3, RRF::PROVISIONAL_RESERVE } }));
+		CHECK_FALSE(reserve(&r1, EDGE::FRONT, RRF::TRY_RESERVE, nullptr));
+
+		guard.RollbackTo(savepoint0);
+		CHECK(contents() == (state { { &r1, RRF::RESERVE }, { &r2, RRF::RESERVE } }));
+
+		REQUIRE(reserve(&r2, EDGE::FRONT, RRF::UNRESERVE, &guard));
+		CHECK(contents() == (state { { &r1, RRF::RESERVE } }));
+	}
+	CHECK(contents() == (state { { &r1, RRF::RESERVE }, { &r2, RRF::RESERVE } }));
+	CHECK_FALSE(reserve(&r3, EDGE::BACK, RRF::TRY_RESERVE, nullptr));
+}
+
 TEST_CASE( "track/deserialisation/points", "Test basic points deserialisation" ) {
 	std::string track_test_str =
 	"{ \"content\" : [ "
@@ -373,6 +373,89 @@ TEST_CASE( "track/ops/points/coupling/contradictory-reservation", "Test contradi
 	}
 }
 
+TEST_CASE( "track/ops/reservation/batch", "Test batched route reservation, with requests checked against each other" ) {
+	using PTF = generic_points::PTF;
+
+	std::function<void()> setup;
+	points *p1;
+	route_signal *s1;
+	routing_point *b;
+	routing_point *c;
+	points *p2;
+	route_signal *s2;
+	routing_point *f;
+	auto setup_test = [&](test_fixture_world_init_checked &env) {
+		setup = [&]() {
+			p1 = PTR_CHECK(env.w->FindTrackByNameCast<points>("P1"));
+			s1 = PTR_CHECK(env.w->FindTrackByNameCast<route_signal>("S1"));
+			b = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("B"));
+			c = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("C"));
+			p2 = PTR_CHECK(env.w->FindTrackByNameCast<points>("P2"));
+			s2 = PTR_CHECK(env.w->FindTrackByNameCast<route_signal>("S2"));
+			f = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("F"));
+		};
+	};
+
+	SECTION("Compatible") {
+		test_fixture_world_init_checked env(string_format(points_coupled_reserve_test_str1.c_str(), "normal"));
+		setup_test(env);
+		auto test = [&](std::function<void()> RoundTrip) {
+			env.w->SubmitAction(action_reserve_batch(*(env.w)).AddPath(s1, c).AddPath(s2, f));
+
+			RoundTrip();
+			env.w->GameStep(5001);
+			RoundTrip();
+			CHECK(p1->GetPointsFlags(0) == (PTF::COUPLED | PTF::REV));
+			CHECK(p2->GetPointsFlags(0) == (PTF::COUPLED | PTF::REV));
+			CHECK(s1->GetCurrentForwardRoute() != nullptr);
+			CHECK(s2->GetCurrentForwardRoute() != nullptr);
+			CHECK(env.w->GetLogText() == "");
+		};
+		ExecTestFixtureWorldWithRoundTrip(env, setup, test);
+	}
+
+	SECTION("Conflicting") {
+		test_fixture_world_init_checked env(string_format(points_coupled_reserve_test_str1.c_str(), "reverse"));
+		setup_test(env);
+		auto test = [&](std::function<void()> RoundTrip) {
+			env.w->SubmitAction(action_reserve_batch(*(env.w)).AddPath(s1, c).AddPath(s2, f));
+
+			RoundTrip();
+			env.w->GameStep(5001);
+			CHECK(env.w->GetLogText() == "Cannot reserve route: Conflicts with existing route\n");
+			RoundTrip();
+			CHECK(p1->GetPointsFlags(0) == (PTF::COUPLED | PTF::REV));
+			CHECK(p2->GetPointsFlags(0) == (PTF::COUPLED | PTF::ZERO));
+			CHECK(s1->GetCurrentForwardRoute() != nullptr);
+			CHECK(s2->GetCurrentForwardRoute() == nullptr);
+		};
+		ExecTestFixtureWorldWithRoundTrip(env, setup, test);
+	}
+
+	SECTION("Same start") {
+		test_fixture_world_init_checked env(string_format(points_coupled_reserve_test_str1.c_str(), "normal"));
+		setup_test(env);
+		auto test = [&](std::function<void()> RoundTrip) {
+			std::vector<routing_point::gmr_route_item> out;
+			REQUIRE(s1->GetMatchingRoutes(out, b, route_class::AllNonOverlaps()) == 1);
+			const route *s1_b = out[0].rt;
+
+			env.w->SubmitAction(action_reserve_batch(*(env.w)).AddRoute(*s1_b).AddPath(s1, c).AddRoute(*s1_b));
+
+			RoundTrip();
+			env.w->GameStep(5001);
+			CHECK(env.w->GetLogText() == "Cannot reserve route: Route already set from this signal\n");
+			RoundTrip();
+			CHECK(p1->GetPointsFlags(0) == (PTF::COUPLED | PTF::ZERO));
+			CHECK(p2->GetPointsFlags(0) == (PTF::COUPLED | PTF::ZERO));
+			REQUIRE(s1->GetCurrentForwardRoute() != nullptr);
+			CHECK(s1->GetCurrentForwardRoute()->end.track == b);
+			CHECK(s2->GetCurrentForwardRoute() == nullptr);
+		};
+		ExecTestFixtureWorldWithRoundTrip(env, setup, test);
+	}
+}
+
 TEST_CASE( "track/ops/points/coupling/ooc-time", "Test OOC times over coupled points" ) {
 	using PTF = generic_points::PTF;
 
@@ -1049,3 +1132,75 @@ TEST_CASE( "track/ops/reservation/overlap/dualswing", "Test points movement over
 		CHECK(s6->GetCurrentForwardOverlap() == nullptr);
 	}
 }
+
+std::string overlap_ops_test_str_3 =
+R"({ "content" : [ )"
+	R"({ "type" : "typedef", "new_type" : "4aspectauto", "base_type" : "auto_signal", "content" : { "max_aspect" : 3 } }, )"
+	R"({ "type" : "typedef", "new_type" : "4aspectroute", "base_type" : "route_signal", "content" : { "max_aspect" : 3, "route_signal" : true } }, )"
+
+	R"({ "type" : "start_of_line", "name" : "A" }, )"
+	R"({ "type" : "4aspectauto", "name" : "S1" }, )"
+	R"({ "type" : "track_seg", "length" : 50000, "track_circuit" : "T1" }, )"
+	R"({ "type" : "4aspectroute", "name" : "S2", "overlap_swingable" : true }, )"
+	R"({ "type" : "track_seg", "length" : 20000, "track_circuit" : "S2ovlp" }, )"
+	R"({ "type" : "points", "name" : "P1" }, )"
+	R"({ "type" : "points", "name" : "P3", "reverse_auto_connection" : true }, )"
+	R"({ "type" : "track_seg", "length" : 30000, "track_circuit" : "T2" }, )"
+	R"({ "type" : "routing_marker", "name" : "B", "overlap_end" : true }, )"
+	R"({ "type" : "end_of_line", "name" : "G" }, )"
+
+	R"({ "type" : "track_seg", "length" : 30000, "track_circuit" : "T3", "connect" : { "to" : "P1" } }, )"
+	R"({ "type" : "points", "name" : "P2" }, )"
+	R"({ "type" : "points", "name" : "P4", "reverse_auto_connection" : true }, )"
+	R"({ "type" : "track_seg", "length" : 30000, "track_circuit" : "T4" }, )"
+	R"({ "type" : "routing_marker", "name" : "C", "overlap_end" : true }, )"
+	R"({ "type" : "end_of_line", "name" : "H" }, )"
+
+	R"({ "type" : "track_seg", "length" : 30000, "track_circuit" : "T5", "connect" : { "to" : "P2" } }, )"
+	R"({ "type" : "routing_marker", "name" : "D", "overlap_end" : true }, )"
+	R"({ "type" : "end_of_line", "name" : "I" }, )"
+
+	R"({ "type" : "start_of_line" }, )"
+	R"({ "type" : "4aspectroute", "name" : "S3" }, )"
+	R"({ "type" : "track_seg", "length" : 30000, "track_circuit" : "T6", "connect" : { "to" : "P3" } }, )"
+
+	R"({ "type" : "start_of_line" }, )"
+	R"({ "type" : "4aspectroute", "name" : "S4" }, )"
+	R"({ "type" : "track_seg", "length" : 30000, "track_circuit" : "T7", "connect" : { "to" : "P4" } } )"
+"] }";
+
+TEST_CASE( "track/ops/reservation/batch/overlapswing", "Test batched route reservation where a request swings an overlap added by an earlier request" ) {
+	test_fixture_world_init_checked env(overlap_ops_test_str_3);
+	route_signal *s2 = PTR_CHECK(env.w->FindTrackByNameCast<route_signal>("S2"));
+	route_signal *s3 = PTR_CHECK(env.w->FindTrackByNameCast<route_signal>("S3"));
+	route_signal *s4 = PTR_CHECK(env.w->FindTrackByNameCast<route_signal>("S4"));
+	routing_point *b = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("B"));
+	routing_point *c = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("C"));
+	routing_point *d = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("D"));
+	routing_point *g = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("G"));
+	routing_point *h = PTR_CHECK(env.w->FindTrackByNameCast<routing_point>("H"));
+
+	CHECK(PTR_CHECK(s2->GetCurrentForwardOverlap())->end.track == b);
+
+	SECTION("Single") {
+		env.w->SubmitAction(action_reserve_path(*(env.w), s3, g));
+		env.w->GameStep(100000);
+		CHECK(env.w->GetLogText() == "");
+		CHECK(PTR_CHECK(s3->GetCurrentForwardRoute())->end.track == g);
+		CHECK(PTR_CHECK(s2->GetCurrentForwardOverlap())->end.track == c);
+
+		env.w->SubmitAction(action_reserve_path(*(env.w), s4, h));
+		env.w->GameStep(100000);
+		CHECK(env.w->GetLogText() == "");
+		CHECK(PTR_CHECK(s4->GetCurrentForwardRoute())->end.track == h);
+		CHECK(PTR_CHECK(s2->GetCurrentForwardOverlap())->end.track == d);
+	}
+	SECTION("Batch") {
+		env.w->SubmitAction(action_reserve_batch(*(env.w)).AddPath(s3, g).AddPath(s4, h));
+		env.w->GameStep(100000);
+		CHECK(env.w->GetLogText() == "Cannot reserve route: Conflicts with existing route\n");
+		CHECK(PTR_CHECK(s3->GetCurrentForwardRoute())->end.track == g);
+		CHECK(s4->GetCurrentForwardRoute() == nullptr);
+		CHECK(PTR_CHECK(s2->GetCurrentForwardOverlap())->end.track == c);
+	}
+}
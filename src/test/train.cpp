@@ -22,8 +22,11 @@
 #include "test/test_util.h"
 #include "util/util.h"
 #include "core/train.h"
+#include "core/param.h"
 #include "core/track_circuit.h"
 #include "core/points.h"
+#include "core/signal.h"
+#include "core/track_ops.h"
 #include <sstream>
 
 static void checkvc(world &w, const std::string &name, unsigned int length, unsigned int max_speed, unsigned int tractive_force, unsigned int tractive_power,
@@ -114,6 +117,59 @@ TEST_CASE( "train/vehicle_class/deserialisation", "Test vehicle class deserialis
 		, "non-zero");
 }
 
+TEST_CASE("/train/traction_set/bitset", "Traction set operations, including traction type IDs above the inline bitmap") {
+	world_test w;
+	for (unsigned int i = 0; i < 150; i++) {
+		w.AddTractionType(string_format("T%u", i), i == 100);
+	}
+	traction_type *t0 = PTR_CHECK(w.GetTractionTypeByName("T0"));
+	traction_type *t63 = PTR_CHECK(w.GetTractionTypeByName("T63"));
+	traction_type *t64 = PTR_CHECK(w.GetTractionTypeByName("T64"));
+	traction_type *t100 = PTR_CHECK(w.GetTractionTypeByName("T100"));
+	traction_type *t149 = PTR_CHECK(w.GetTractionTypeByName("T149"));
+	CHECK(w.GetTractionTypeById(t149->id) == t149);
+	CHECK(w.GetTractionTypeById(150) == nullptr);
+	CHECK(w.GetAlwaysAvailableTractionTypes().DumpString() == "T100");
+
+	traction_set a;
+	a.AddTractionType(t0);
+	a.AddTractionType(t64);
+	a.AddTractionType(t149);
+	a.AddTractionType(t64);
+	CHECK(a.DumpString() == "T0,T149,T64");
+	CHECK(a.HasTraction(t149));
+	CHECK(!a.HasTraction(t63));
+
+	traction_set b;
+	b.AddTractionType(t63);
+	CHECK(!a.IsIntersecting(b));
+	b.AddTractionType(t149);
+	CHECK(a.IsIntersecting(b));
+	CHECK(b.IsIntersecting(a));
+
+	traction_set c = a;
+	c.IntersectWith(b);
+	CHECK(c.DumpString() == "T149");
+	c.UnionWith(b);
+	CHECK(c.DumpString() == "T149,T63");
+	c.RemoveTractionType(t149);
+	CHECK(c.DumpString() == "T63");
+	CHECK(!c.IsIntersecting(a));
+
+	train *t = w.CreateEmptyTrain();
+	traction_set active;
+	active.AddTractionType(t64);
+	t->SetActiveTractionSet(active);
+	CHECK(a.CanTrainPass(t));
+	CHECK(!b.CanTrainPass(t));
+	active.AddTractionType(t100);
+	t->SetActiveTractionSet(active);
+	CHECK(b.CanTrainPass(t));
+	w.AddTractionType("T100", false);
+	CHECK(!b.CanTrainPass(t));
+	CHECK(w.GetAlwaysAvailableTractionTypes().IsEmpty());
+}
+
 TEST_CASE("/train/train/deserialisation/typeerror", "Check that trains cannot appear in content section") {
 
 	auto parsecheckerr = [&](const std::string &json, const std::string &errstr) {
@@ -136,6 +192,83 @@ TEST_CASE("/train/train/deserialisation/typeerror", "Check that trains cannot ap
 		, "Unknown object property");
 }
 
+TEST_CASE("/train/train/registry", "Train registry lookup by name and ID, and deletion") {
+	world_test w;
+
+	train *t1 = w.CreateEmptyTrain();
+	train *t2 = w.CreateEmptyTrain();
+	train *t3 = w.CreateEmptyTrain();
+	t1->SetName("A");
+	t2->SetName("B");
+	t3->GenerateName();
+	CHECK(t1->GetTrainId() != t2->GetTrainId());
+	CHECK(t2->GetTrainId() != t3->GetTrainId());
+	CHECK(w.GetTrainCount() == 3);
+	CHECK(w.FindTrainByName("A") == t1);
+	CHECK(w.FindTrainByName("B") == t2);
+	CHECK(w.FindTrainByName(t3->GetName()) == t3);
+	CHECK(w.FindTrainById(t2->GetTrainId()) == t2);
+
+	CHECK(t1->SetName("C"));
+	CHECK(w.FindTrainByName("A") == nullptr);
+	CHECK(w.FindTrainByName("C") == t1);
+
+	// renaming to the name of another train is rejected
+	CHECK_FALSE(t1->SetName("B"));
+	CHECK(t1->GetName() == "C");
+	CHECK(w.FindTrainByName("B") == t2);
+	CHECK(w.FindTrainByName("C") == t1);
+	CHECK(t1->SetName("C"));
+	CHECK(w.FindTrainByName("C") == t1);
+
+	train_id_type id2 = t2->GetTrainId();
+	w.DeleteTrain(t2);
+	CHECK(w.GetTrainCount() == 2);
+	CHECK(w.FindTrainByName("B") == nullptr);
+	CHECK(w.FindTrainById(id2) == nullptr);
+
+	std::vector<train *> order;
+	unsigned int count = w.EnumerateTrains([&](train &t) {
+		order.push_back(&t);
+	});
+	CHECK(count == 2);
+	CHECK((order == std::vector<train *>({ t3, t1 })));
+
+	train *t4 = w.CreateEmptyTrain();
+	CHECK(t4->GetTrainId() != id2);
+	CHECK(w.FindTrainById(t4->GetTrainId()) == t4);
+}
+
+TEST_CASE("/train/train/brakingprofiles", "Check braking profile cache results against exact braking speeds") {
+	train_braking_profile_cache strict;
+	train_braking_profile_cache table;
+	const unsigned int decels[] = { 3, 64, 130, 255, 256, 700, 2561 };
+	const unsigned int targets[] = { 0, 400, 5000, 17000 };
+	for (unsigned int decel : decels) {
+		for (unsigned int target : targets) {
+			for (unsigned int distance = 0; distance < 2000000; distance = distance * 5 / 4 + 7) {
+				INFO("Deceleration: " << decel << ", target: " << target << ", distance: " << distance);
+				uint64_t vsq = ((((uint64_t) 2000) * ((uint64_t) decel) * ((uint64_t) distance)) >> 8) + (((uint64_t) target) * ((uint64_t) target));
+				if (vsq <= CREEP_SPEED * CREEP_SPEED) {
+					continue;    // the brake threshold speed is used instead
+				}
+				unsigned int exact = fast_isqrt(vsq);
+				CHECK(strict.GetBrakeSpeed(BRAKING_PROFILE_MODE::STRICT, decel, target, distance, vsq) == exact);
+
+				unsigned int tolerance = (train_braking_profile_cache::SPEED_STEP / 4) + ((exact * train_braking_profile_cache::DECEL_BUCKET) / decel) + 2;
+				unsigned int interpolated = table.GetBrakeSpeed(BRAKING_PROFILE_MODE::TABLE, decel, target, distance, vsq);
+				CHECK(interpolated <= exact);
+				unsigned int lower = exact > tolerance ? exact - tolerance : 0;
+				CHECK(interpolated >= lower);
+			}
+		}
+	}
+	CHECK(strict.GetProfileCount() <= train_braking_profile_cache::MAX_PROFILES);
+	CHECK(table.GetProfileCount() <= train_braking_profile_cache::MAX_PROFILES);
+	table.Clear();
+	CHECK(table.GetProfileCount() == 0);
+}
+
 TEST_CASE("/train/train/deserialisation/dynamics", "Train deserialisation and dynamics") {
 	std::string test_train_deserialisation_dynamics =
 	R"({ "content" : [ )"
@@ -440,3 +573,490 @@ TEST_CASE("/train/train/dropanduproot", "Drop train into position and train upro
 		check_drop_train_insufficient_track(PTR_CHECK(tenv->w->FindTrainByName("TR1")), track_location(tenv->w->FindTrackByName("T1"), EDGE::FRONT, 49000));
 	}
 }
+
+static std::string MakeParallelStepTestLayout(const std::string &rs_params = "") {
+	std::string content = R"({ "type" : "start_of_line", "name" : "A" }, )";
+	for (unsigned int i = 0; i < 6; i++) {
+		content += string_format(R"({ "type" : "track_seg", "name" : "T%u", "length" : "400m", "track_circuit" : "T%u" }, )", i, i);
+		content += string_format(R"({ "type" : "auto_signal", "name" : "S%u" }, )", i);
+		content += string_format(R"({ "type" : "track_seg", "name" : "O%u", "length" : "50m", "track_circuit" : "O%u" }, )", i, i);
+		content += R"({ "type" : "routing_marker", "overlap_end" : true }, )";
+	}
+	content += R"({ "type" : "track_seg", "name" : "E", "length" : "400m", "track_circuit" : "E" }, )"
+			R"({ "type" : "route_signal", "name" : "RS", "route_signal" : true )" + rs_params + R"( }, )"
+			R"({ "type" : "track_seg", "name" : "RSO", "length" : "50m", "track_circuit" : "RSO" }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "name" : "F", "length" : "5km", "track_circuit" : "F" }, )"
+			R"({ "type" : "end_of_line", "name" : "B" }, )"
+			R"({ "type" : "traction_type", "name" : "diesel", "always_available" : true }, )"
+			R"({ "type" : "vehicle_class", "name" : "VC1", "length" : "20m", "mass" : "40t", "max_speed" : "100km/h", )"
+			R"("tractive_force" : "200kN", "tractive_power" : "1000kW", "braking_force" : "300kN", "traction_types" : [ "diesel" ] })";
+
+	std::string game_state;
+	for (unsigned int i = 0; i < 3; i++) {
+		if (i) {
+			game_state += ", ";
+		}
+		game_state += string_format(R"({ "type" : "train", "name" : "TR%u", "active_tractions" : [ "diesel" ], )"
+				R"("vehicle_classes" : [ { "class_name" : "VC1", "count" : 4 } ], )"
+				R"("position" : { "piece" : "S%u", "dir" : "front", "offset" : 0 } })", i, 4 - (i * 2));
+	}
+	return R"({ "content" : [ )" + content + R"( ], "game_state" : [ )" + game_state + " ] }";
+}
+
+TEST_CASE("/train/train/parallelstep", "Check that multi-threaded train stepping gives identical results to serial stepping") {
+	std::string layout = MakeParallelStepTestLayout();
+	test_fixture_world_init_checked serial_env(layout, true, true);
+	test_fixture_world_init_checked parallel_env(layout, true, true);
+	parallel_env.w->SetTrainStepThreadCount(4);
+	CHECK(serial_env.w->GetTrainStepThreadCount() == 1);
+	CHECK(parallel_env.w->GetTrainStepThreadCount() == 4);
+
+	auto set_exit_route = [&](world &w) {
+		generic_signal *rs = w.FindTrackByNameCast<generic_signal>("RS");
+		routing_point *b = w.FindTrackByNameCast<routing_point>("B");
+		REQUIRE(rs != nullptr);
+		REQUIRE(b != nullptr);
+		std::vector<routing_point::gmr_route_item> out;
+		REQUIRE(rs->GetMatchingRoutes(out, b, route_class::All()) == 1);
+		w.SubmitAction(action_reserve_track(w, *(out[0].rt)));
+	};
+
+	auto check_same = [&](unsigned int step) {
+		std::vector<const train *> serial_trains;
+		std::vector<const train *> parallel_trains;
+		serial_env.w->EnumerateTrains([&](const train &t) { serial_trains.push_back(&t); });
+		parallel_env.w->EnumerateTrains([&](const train &t) { parallel_trains.push_back(&t); });
+		REQUIRE(serial_trains.size() == 3);
+		REQUIRE(parallel_trains.size() == 3);
+		for (unsigned int i = 0; i < serial_trains.size(); i++) {
+			INFO("Step: " << step << ", train: " << serial_trains[i]->GetName());
+			const train_motion_state &s = serial_trains[i]->GetTrainMotionState();
+			const train_motion_state &p = parallel_trains[i]->GetTrainMotionState();
+			REQUIRE(s.current_speed == p.current_speed);
+			REQUIRE(s.head_pos.GetTrack()->GetName() == p.head_pos.GetTrack()->GetName());
+			REQUIRE(s.head_pos.GetOffset() == p.head_pos.GetOffset());
+			REQUIRE(s.tail_pos.GetTrack()->GetName() == p.tail_pos.GetTrack()->GetName());
+			REQUIRE(s.tail_pos.GetOffset() == p.tail_pos.GetOffset());
+		}
+	};
+
+	bool moved = false;
+	for (unsigned int step = 0; step < 4000; step++) {
+		if (step == 1500) {
+			set_exit_route(*(serial_env.w));
+			set_exit_route(*(parallel_env.w));
+		}
+		serial_env.w->GameStep(50);
+		parallel_env.w->GameStep(50);
+		check_same(step);
+		serial_env.w->EnumerateTrains([&](const train &t) {
+			if (t.GetTrainMotionState().head_pos.GetTrack()->GetName() == "F") {
+				moved = true;
+			}
+		});
+	}
+	CHECK(moved);
+}
+
+TEST_CASE("/train/train/freerunning", "Check that skipping lookahead checks for free running trains gives identical results") {
+	std::string layout = MakeParallelStepTestLayout();
+	test_fixture_world_init_checked checked_env(layout, true, true);
+	test_fixture_world_init_checked free_env(layout, true, true);
+	checked_env.w->SetTrainFreeRunningEnabled(false);
+	CHECK(free_env.w->IsTrainFreeRunningEnabled());
+
+	for (auto w : { checked_env.w.get(), free_env.w.get() }) {
+		generic_signal *rs = PTR_CHECK(w->FindTrackByNameCast<generic_signal>("RS"));
+		routing_point *b = PTR_CHECK(w->FindTrackByNameCast<routing_point>("B"));
+		std::vector<routing_point::gmr_route_item> out;
+		REQUIRE(rs->GetMatchingRoutes(out, b, route_class::All()) == 1);
+		w->SubmitAction(action_reserve_track(*w, *(out[0].rt)));
+	}
+
+	unsigned int free_running_steps = 0;
+	unsigned int moving_steps = 0;
+	for (unsigned int step = 0; step < 4000; step++) {
+		checked_env.w->GameStep(50);
+		free_env.w->GameStep(50);
+
+		std::vector<const train *> checked_trains;
+		std::vector<const train *> free_trains;
+		checked_env.w->EnumerateTrains([&](const train &t) { checked_trains.push_back(&t); });
+		free_env.w->EnumerateTrains([&](const train &t) { free_trains.push_back(&t); });
+		REQUIRE(checked_trains.size() == free_trains.size());
+		for (unsigned int i = 0; i < checked_trains.size(); i++) {
+			INFO("Step: " << step << ", train: " << checked_trains[i]->GetName());
+			CHECK(!checked_trains[i]->IsFreeRunning());
+			const train_motion_state &c = checked_trains[i]->GetTrainMotionState();
+			const train_motion_state &f = free_trains[i]->GetTrainMotionState();
+			REQUIRE(c.current_speed == f.current_speed);
+			REQUIRE(c.head_pos.GetTrack()->GetName() == f.head_pos.GetTrack()->GetName());
+			REQUIRE(c.head_pos.GetOffset() == f.head_pos.GetOffset());
+			REQUIRE(c.tail_pos.GetTrack()->GetName() == f.tail_pos.GetTrack()->GetName());
+			REQUIRE(c.tail_pos.GetOffset() == f.tail_pos.GetOffset());
+			if (f.current_speed) {
+				moving_steps++;
+				if (free_trains[i]->IsFreeRunning()) {
+					free_running_steps++;
+				}
+			}
+		}
+	}
+	INFO("Moving: " << moving_steps << ", free running: " << free_running_steps);
+	CHECK(free_running_steps > 0);
+	CHECK(free_running_steps < moving_steps);
+}
+
+TEST_CASE("/train/train/nearesttrain", "Check finding the nearest train ahead of a track location") {
+	std::string test_str =
+	R"({ "content" : [ )"
+		R"({ "type" : "start_of_line", "name" : "A" }, )"
+		R"({ "type" : "track_seg", "name" : "T0", "length" : "1km" }, )"
+		R"({ "type" : "track_seg", "name" : "T1", "length" : "500m" }, )"
+		R"({ "type" : "track_seg", "name" : "T2", "length" : "200m" }, )"
+		R"({ "type" : "end_of_line", "name" : "B" }, )"
+		R"({ "type" : "traction_type", "name" : "diesel", "always_available" : true }, )"
+		R"({ "type" : "vehicle_class", "name" : "VC1", "length" : "20m", "mass" : "40t", "max_speed" : "100km/h", )"
+		R"("tractive_force" : "200kN", "tractive_power" : "1000kW", "braking_force" : "300kN", "traction_types" : [ "diesel" ] } )"
+	R"( ], )"
+	R"( "game_state" : [ )"
+		R"({ "type" : "train", "name" : "TR0", "active_tractions" : [ "diesel" ], "vehicle_classes" : [ { "class_name" : "VC1", "count" : 2 } ], )"
+			R"("position" : { "piece" : "T0", "dir" : "front", "offset" : 300000 } }, )"
+		R"({ "type" : "train", "name" : "TR1", "active_tractions" : [ "diesel" ], "vehicle_classes" : [ { "class_name" : "VC1", "count" : 2 } ], )"
+			R"("position" : { "piece" : "T0", "dir" : "front", "offset" : 600000 } }, )"
+		R"({ "type" : "train", "name" : "TR2", "active_tractions" : [ "diesel" ], "vehicle_classes" : [ { "class_name" : "VC1", "count" : 2 } ], )"
+			R"("position" : { "piece" : "T1", "dir" : "front", "offset" : 20000 } }, )"
+		R"({ "type" : "train", "name" : "TR3", "active_tractions" : [ "diesel" ], "vehicle_classes" : [ { "class_name" : "VC1", "count" : 2 } ], )"
+			R"("position" : { "piece" : "T1", "dir" : "front", "offset" : 400000 } } )"
+	"] }";
+	test_fixture_world_init_checked env(test_str, true, true);
+	world &w = *(env.w);
+	train *tr0 = PTR_CHECK(w.FindTrainByName("TR0"));
+	train *tr1 = PTR_CHECK(w.FindTrainByName("TR1"));
+	train *tr2 = PTR_CHECK(w.FindTrainByName("TR2"));
+	train *tr3 = PTR_CHECK(w.FindTrainByName("TR3"));
+
+	auto check_nearest = [&](const std::string &piece, EDGE direction, unsigned int offset, unsigned int max_distance, train *expected, unsigned int expected_distance) {
+		INFO("From: " << piece << ", offset: " << offset << ", max distance: " << max_distance);
+		unsigned int distance = 0;
+		CHECK(w.FindNearestTrainAhead(track_location(w.FindTrackByName(piece), direction, offset), max_distance, &distance) == expected);
+		if (expected) {
+			CHECK(distance == expected_distance);
+		}
+	};
+
+	// trains are 40m long, TR0 and TR1 are on T0, TR2 is across T0 and T1, and TR3 is on T1
+	check_nearest("T0", EDGE::FRONT, 0, UINT_MAX, tr0, 260000);
+	check_nearest("T0", EDGE::FRONT, 280000, UINT_MAX, tr0, 0);
+	check_nearest("T0", EDGE::FRONT, 300000, UINT_MAX, tr1, 260000);
+	check_nearest("T0", EDGE::FRONT, 650000, UINT_MAX, tr2, 330000);
+	check_nearest("T0", EDGE::FRONT, 990000, UINT_MAX, tr2, 0);
+	check_nearest("T0", EDGE::BACK, 700000, UINT_MAX, tr1, 100000);
+	check_nearest("T0", EDGE::BACK, 200000, UINT_MAX, nullptr, 0);
+	check_nearest("T1", EDGE::FRONT, 100000, UINT_MAX, tr3, 260000);
+	check_nearest("T1", EDGE::FRONT, 100000, 259999, nullptr, 0);
+	check_nearest("T1", EDGE::BACK, 100000, UINT_MAX, tr2, 80000);
+	check_nearest("T1", EDGE::FRONT, 420000, UINT_MAX, nullptr, 0);
+	check_nearest("T2", EDGE::BACK, 100000, UINT_MAX, tr3, 200000);
+
+	// the occupations of trains which have moved are recalculated
+	for (unsigned int i = 0; i < 10; i++) {
+		w.GameStep(1000);
+	}
+	unsigned int tr2_head = tr2->GetTrainMotionState().head_pos.GetOffset();
+	unsigned int tr3_head = tr3->GetTrainMotionState().head_pos.GetOffset();
+	REQUIRE(tr2->GetTrainMotionState().head_pos.GetTrack() == w.FindTrackByName("T1"));
+	REQUIRE(tr3->GetTrainMotionState().head_pos.GetTrack() == w.FindTrackByName("T1"));
+	CHECK(tr3_head > 400000);
+	REQUIRE(tr2_head < 100000);
+	check_nearest("T1", EDGE::FRONT, 100000, UINT_MAX, tr3, tr3_head - 40000 - 100000);
+	check_nearest("T1", EDGE::BACK, 100000, UINT_MAX, tr2, 100000 - tr2_head);
+
+	// a train dropped between two others is found in order
+	error_collection ec;
+	tr1->UprootTrain(ec);
+	tr1->DropTrainIntoPosition(track_location(w.FindTrackByName("T0"), EDGE::FRONT, 900000), ec);
+	INFO("Error Collection: " << ec);
+	REQUIRE(ec.GetErrorCount() == 0);
+	check_nearest("T0", EDGE::FRONT, 700000, UINT_MAX, tr1, 160000);
+	check_nearest("T0", EDGE::BACK, 850000, UINT_MAX, tr0, 850000 - tr0->GetTrainMotionState().head_pos.GetOffset());
+}
+
+TEST_CASE("/train/train/nearesttrain/loop", "Check that finding the nearest train ahead stops in a loop which does not include the start") {
+	std::string test_str =
+	R"({ "content" : [ )"
+		R"({ "type" : "start_of_line", "name" : "A" }, )"
+		R"({ "type" : "track_seg", "name" : "T0", "length" : "1km" }, )"
+		R"({ "type" : "spring_points", "name" : "P1", "reverse_auto_connection" : true }, )"
+		R"({ "type" : "track_seg", "name" : "L1", "length" : 0 }, )"
+		R"({ "type" : "track_seg", "name" : "L2", "length" : 0 }, )"
+		R"({ "type" : "track_seg", "name" : "L3", "length" : 0, "connect" : { "to" : "P1" } } )"
+	"] }";
+	test_fixture_world_init_checked env(test_str);
+	world &w = *(env.w);
+
+	CHECK(w.FindNearestTrainAhead(track_location(w.FindTrackByName("T0"), EDGE::FRONT, 0)) == nullptr);
+	CHECK(w.FindNearestTrainAhead(track_location(w.FindTrackByName("L2"), EDGE::FRONT, 0)) == nullptr);
+}
+
+TEST_CASE("/train/train/fastforward", "Check that fast-forwarding gives identical results to stepping, and skips steps when nothing can change") {
+	std::string layout =
+		R"({ "content" : [ )"
+			R"({ "type" : "start_of_line", "name" : "A" }, )"
+			R"({ "type" : "track_seg", "name" : "T0", "length" : "400m", "track_circuit" : "T0" }, )"
+			R"({ "type" : "auto_signal", "name" : "S0" }, )"
+			R"({ "type" : "track_seg", "name" : "O0", "length" : "50m", "track_circuit" : "O0" }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "name" : "E", "length" : "400m", "track_circuit" : "E" }, )"
+			R"({ "type" : "route_signal", "name" : "RS", "route_signal" : true, "route_set_delay" : 120000 }, )"
+			R"({ "type" : "track_seg", "name" : "RSO", "length" : "50m", "track_circuit" : "RSO" }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "name" : "F", "length" : "5km", "track_circuit" : "F" }, )"
+			R"({ "type" : "end_of_line", "name" : "B" }, )"
+			R"({ "type" : "traction_type", "name" : "diesel", "always_available" : true }, )"
+			R"({ "type" : "vehicle_class", "name" : "VC1", "length" : "20m", "mass" : "40t", "max_speed" : "100km/h", )"
+			R"("tractive_force" : "200kN", "tractive_power" : "1000kW", "braking_force" : "300kN", "traction_types" : [ "diesel" ] })"
+		R"( ], "game_state" : [ )"
+			R"({ "type" : "train", "name" : "TR0", "active_tractions" : [ "diesel" ], )"
+			R"("vehicle_classes" : [ { "class_name" : "VC1", "count" : 4 } ], )"
+			R"("position" : { "piece" : "S0", "dir" : "front", "offset" : 0 } })"
+		" ] }";
+	test_fixture_world_init_checked step_env(layout, true, true);
+	test_fixture_world_init_checked ff_env(layout, true, true);
+
+	auto set_exit_route = [&](world &w) {
+		generic_signal *rs = w.FindTrackByNameCast<generic_signal>("RS");
+		routing_point *b = w.FindTrackByNameCast<routing_point>("B");
+		REQUIRE(rs != nullptr);
+		REQUIRE(b != nullptr);
+		std::vector<routing_point::gmr_route_item> out;
+		REQUIRE(rs->GetMatchingRoutes(out, b, route_class::All()) == 1);
+		w.SubmitAction(action_reserve_track(w, *(out[0].rt)));
+	};
+
+	auto get_train = [&](world &w) -> const train & {
+		return *PTR_CHECK(w.FindTrainByName("TR0"));
+	};
+
+	auto check_same = [&]() {
+		INFO("Game time: " << step_env.w->GetGameTime());
+		REQUIRE(step_env.w->GetGameTime() == ff_env.w->GetGameTime());
+		const train_motion_state &s = get_train(*(step_env.w)).GetTrainMotionState();
+		const train_motion_state &f = get_train(*(ff_env.w)).GetTrainMotionState();
+		REQUIRE(s.current_speed == f.current_speed);
+		REQUIRE(s.head_pos.GetTrack()->GetName() == f.head_pos.GetTrack()->GetName());
+		REQUIRE(s.head_pos.GetOffset() == f.head_pos.GetOffset());
+		REQUIRE(step_env.w->FindTrackByNameCast<generic_signal>("RS")->GetAspect() == ff_env.w->FindTrackByNameCast<generic_signal>("RS")->GetAspect());
+	};
+
+	auto run = [&](world_time duration) {
+		world_time target = step_env.w->GetGameTime() + duration;
+		unsigned int steps = 0;
+		while (step_env.w->GetGameTime() < target) {
+			step_env.w->GameStep(std::min<world_time>(50, target - step_env.w->GetGameTime()));
+			steps++;
+		}
+		unsigned int ff_steps = ff_env.w->FastForward(target, 50);
+		check_same();
+		CHECK(ff_steps <= steps);
+		return ff_steps;
+	};
+
+	auto rs_aspect = [&]() {
+		return ff_env.w->FindTrackByNameCast<generic_signal>("RS")->GetAspect();
+	};
+
+	// The train runs up to the red route signal and stops
+	run(300000);
+	CHECK(get_train(*(ff_env.w)).GetTrainMotionState().head_pos.GetTrack()->GetName() == "E");
+	CHECK(get_train(*(ff_env.w)).GetTrainMotionState().current_speed == 0);
+	CHECK(ff_env.w->IsQuiescent());
+	CHECK(run(600000) == 0);
+
+	// The route set delay is skipped over, until the signal clears
+	set_exit_route(*(step_env.w));
+	set_exit_route(*(ff_env.w));
+	CHECK_FALSE(ff_env.w->IsQuiescent());
+	CHECK(run(119950) < 10);
+	CHECK(rs_aspect() == 0);
+	CHECK(step_env.w->GetTickUpdateWakeupCount() == 1);
+	CHECK(ff_env.w->GetTickUpdateWakeupCount() == 1);
+	run(100);
+	CHECK(rs_aspect() > 0);
+
+	// The train is now moving
+	CHECK_FALSE(ff_env.w->IsQuiescent());
+	CHECK(run(10000) == 200);
+	run(1000000);
+	CHECK(get_train(*(ff_env.w)).GetTrainMotionState().head_pos.GetTrack()->GetName() == "F");
+}
+
+TEST_CASE("/train/train/coveredspeedlimits", "Check tracking of the speed limits of the track covered by a train") {
+	train_track_speed_limit_set limits;
+	CHECK(limits.GetLowest() == UINT_MAX);
+	limits.Add(300);
+	limits.Add(100);
+	limits.Add(200);
+	limits.Add(100);
+	CHECK(limits.GetItems().size() == 3);
+	CHECK(limits.GetLowest() == 100);
+	CHECK(limits.Remove(100) == true);
+	CHECK(limits.GetLowest() == 100);
+	CHECK(limits.Remove(100) == true);
+	CHECK(limits.GetLowest() == 200);
+	CHECK(limits.Remove(100) == false);
+	CHECK(limits.Remove(200) == true);
+	CHECK(limits.Remove(300) == true);
+	CHECK(limits.Empty() == true);
+
+	std::string test_str =
+	R"({ "content" : [ )"
+		R"({ "type" : "start_of_line", "name" : "A"}, )"
+		R"({ "type" : "track_seg", "name" : "T0", "length" : "50m", "speed_limits" : [ { "speed_class" : "", "speed" : 5000 } ] }, )"
+		R"({ "type" : "track_seg", "name" : "T1", "length" : "50m", "speed_limits" : [ { "speed_class" : "", "speed" : 10000 } ] }, )"
+		R"({ "type" : "track_seg", "name" : "T2", "length" : "50m", "speed_limits" : [ { "speed_class" : "", "speed" : 50000 } ] }, )"
+		R"({ "type" : "track_seg", "name" : "T3", "length" : "200m" }, )"
+		R"({ "type" : "end_of_line", "name" : "B" }, )"
+		R"({ "type" : "traction_type", "name" : "diesel", "always_available" : true }, )"
+		R"({ "type" : "vehicle_class", "name" : "VC1", "length" : "30m", "mass" : "15t", "max_speed" : 20000, "traction_types" : [ "diesel" ] } )"
+	R"( ], )"
+	R"( "game_state" : [ )"
+		R"({ "type" : "train", "name" : "TR0", "vehicle_classes" : [ { "class_name" : "VC1", "count" : 2} ] } )"
+	"] }";
+	test_fixture_world_init_checked env(test_str, true, true, true);
+	train *t = PTR_CHECK(env.w->FindTrainByName("TR0"));
+	REQUIRE(t->GetMaxVehSpeed() == 20000);
+
+	auto drop = [&](const std::string &piece, unsigned int offset) {
+		error_collection ec;
+		t->DropTrainIntoPosition(track_location(env.w->FindTrackByName(piece), EDGE::FRONT, offset), ec);
+		INFO("Error Collection: " << ec);
+		REQUIRE(ec.GetErrorCount() == 0);
+	};
+	auto uproot = [&]() {
+		error_collection ec;
+		t->UprootTrain(ec);
+		INFO("Error Collection: " << ec);
+		REQUIRE(ec.GetErrorCount() == 0);
+	};
+
+	drop("T1", 40000);    // head in T1, tail in T0
+	CHECK(t->GetTrainMotionState().current_max_speed == 5000);
+	CHECK(t->GetCoveredTrackSpeedLimits().GetItems().size() == 2);
+	uproot();
+	CHECK(t->GetTrainMotionState().current_max_speed == 20000);
+	CHECK(t->GetCoveredTrackSpeedLimits().Empty() == true);
+
+	drop("T3", 10000);    // head in T3, tail in T2, the limit of T2 is above the vehicle maximum speed
+	CHECK(t->GetTrainMotionState().current_max_speed == 20000);
+	CHECK(t->GetCoveredTrackSpeedLimits().GetItems().size() == 1);
+	uproot();
+
+	drop("T2", 20000);    // head in T2, tail in T1
+	CHECK(t->GetTrainMotionState().current_max_speed == 10000);
+	CHECK(t->GetCoveredTrackSpeedLimits().GetItems().size() == 2);
+	uproot();
+
+	// changing the vehicle maximum speed of a placed train
+	vehicle_class *vc = PTR_CHECK(env.w->FindVehicleClassByName("VC1"));
+	drop("T3", 10000);
+	vc->max_speed = 60000;
+	t->CalculateTrainMotionProperties(1 << 8);
+	CHECK(t->GetTrainMotionState().current_max_speed == 50000);
+	CHECK(t->GetCoveredTrackSpeedLimits().GetItems().size() == 1);
+	uproot();
+	CHECK(t->GetCoveredTrackSpeedLimits().Empty() == true);
+
+	drop("T1", 40000);
+	vc->max_speed = 8000;
+	t->CalculateTrainMotionProperties(1 << 8);
+	CHECK(t->GetTrainMotionState().current_max_speed == 5000);
+	CHECK(t->GetCoveredTrackSpeedLimits().GetItems().size() == 2);
+	uproot();
+	CHECK(t->GetTrainMotionState().current_max_speed == 8000);
+	CHECK(t->GetCoveredTrackSpeedLimits().Empty() == true);
+}
+
+TEST_CASE("/train/train/projection", "Check train arrival time projections") {
+	std::string layout =
+		R"({ "content" : [ )"
+			R"({ "type" : "start_of_line", "name" : "A" }, )"
+			R"({ "type" : "track_seg", "name" : "T0", "length" : "400m", "track_circuit" : "T0" }, )"
+			R"({ "type" : "auto_signal", "name" : "S0" }, )"
+			R"({ "type" : "track_seg", "name" : "O0", "length" : "50m", "track_circuit" : "O0" }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "name" : "E", "length" : "1km", "track_circuit" : "E" }, )"
+			R"({ "type" : "route_signal", "name" : "RS", "route_signal" : true }, )"
+			R"({ "type" : "track_seg", "name" : "RSO", "length" : "50m", "track_circuit" : "RSO" }, )"
+			R"({ "type" : "routing_marker", "overlap_end" : true }, )"
+			R"({ "type" : "track_seg", "name" : "F", "length" : "1km", "track_circuit" : "F", "speed_limits" : [ { "speed_class" : "", "speed" : "40km/h" } ] }, )"
+			R"({ "type" : "track_seg", "name" : "G", "length" : "2km", "track_circuit" : "G" }, )"
+			R"({ "type" : "end_of_line", "name" : "B" }, )"
+			R"({ "type" : "traction_type", "name" : "diesel", "always_available" : true }, )"
+			R"({ "type" : "vehicle_class", "name" : "VC1", "length" : "20m", "mass" : "40t", "max_speed" : "100km/h", )"
+			R"("tractive_force" : "200kN", "tractive_power" : "1000kW", "braking_force" : "300kN", "traction_types" : [ "diesel" ] })"
+		R"( ], "game_state" : [ )"
+			R"({ "type" : "train", "name" : "TR0", "active_tractions" : [ "diesel" ], )"
+			R"("vehicle_classes" : [ { "class_name" : "VC1", "count" : 4 } ], )"
+			R"("position" : { "piece" : "S0", "dir" : "front", "offset" : 0 } })"
+		" ] }";
+	test_fixture_world_init_checked env(layout, true, true);
+	world &w = *(env.w);
+	train *tr = PTR_CHECK(w.FindTrainByName("TR0"));
+	generic_track *rs = PTR_CHECK(w.FindTrackByName("RS"));
+	generic_track *b = PTR_CHECK(w.FindTrackByName("B"));
+
+	w.GameStep(50);
+
+	// RS is at danger, so the train is projected to stop at it
+	const train_projection &tp = w.GetTrainProjection(*tr);
+	CHECK(tp.GetProjectionCount() == 1);
+	world_time rs_eta = 0;
+	world_time b_eta = 0;
+	REQUIRE(tp.GetEta(rs, rs_eta));
+	CHECK(rs_eta > w.GetGameTime());
+	CHECK(tp.GetPoints().back().speed == 0);
+	CHECK(!tp.GetEta(b, b_eta));
+
+	std::vector<routing_point::gmr_route_item> out;
+	REQUIRE(static_cast<routing_point *>(rs)->GetMatchingRoutes(out, static_cast<routing_point *>(b), route_class::All()) == 1);
+	w.SubmitAction(action_reserve_track(w, *(out[0].rt)));
+	w.SetTrainProjectionsEnabled(true);
+
+	// once the train has sighted RS, it is projected to run through to B
+	unsigned int steps = 0;
+	while (!tp.GetEta(b, b_eta) && steps < 2000) {
+		w.GameStep(50);
+		steps++;
+	}
+	REQUIRE(tp.GetEta(b, b_eta));
+	REQUIRE(tp.GetEta(rs, rs_eta));
+	world_time prev = w.GetGameTime();
+	for (auto &it : tp.GetPoints()) {
+		INFO("Target: " << it.target);
+		CHECK(it.eta >= prev);
+		prev = it.eta;
+	}
+	CHECK(b_eta > rs_eta);
+
+	unsigned int initial_count = tp.GetProjectionCount();
+	steps = 0;
+	world_time rs_arrival = 0;
+	for (; steps < 4000; steps++) {
+		w.GameStep(50);
+		world_time eta;
+		if (!rs_arrival && !tp.GetEta(rs, eta)) {
+			rs_arrival = w.GetGameTime();
+		}
+	}
+	INFO("RS ETA: " << rs_eta << ", arrival: " << rs_arrival);
+	REQUIRE(rs_arrival != 0);
+	unsigned int error = (unsigned int) std::abs((int) rs_arrival - (int) rs_eta);
+	CHECK(error <= 2000);
+
+	// the projection is only recalculated when it diverges or the lookahead changes, not on every step
+	unsigned int recalculated = tp.GetProjectionCount() - initial_count;
+	INFO("Projections: " << recalculated);
+	CHECK(recalculated < steps / 20);
+}
@@ -101,3 +101,33 @@ TEST_CASE( "logging/future/generic", "Test generic future log messages" ) {
 	env.w.GameStep(100);
 	REQUIRE(env.w.GetLogText() == expected1 + expected2);
 }
+
+TEST_CASE( "world/updateset", "Test update set insertion, de-duplication and clearing" ) {
+	test_fixture_world_ops_1 env;
+	points p2(env.w);
+	world_test other;
+
+	env.p1.MarkUpdated();
+	p2.MarkUpdated();
+	env.p1.MarkUpdated();
+	const updatable_obj_set &us = env.w.GetLastUpdateSet();
+	REQUIRE(us.size() == 2);
+	CHECK(us[0] == &env.p1);
+	CHECK(us[1] == &p2);
+	CHECK(us.count(&env.p1) == 1);
+	CHECK(us.count(&p2) == 1);
+
+	//generations are not shared between sets
+	CHECK(other.GetLastUpdateSet().count(&env.p1) == 0);
+	CHECK(other.GetLastUpdateSet().count(&p2) == 0);
+
+	env.w.GameStep(1);
+	CHECK(us.empty());
+	CHECK(us.count(&env.p1) == 0);
+	CHECK(us.count(&p2) == 0);
+
+	p2.MarkUpdated();
+	CHECK(us.size() == 1);
+	CHECK(us.count(&env.p1) == 0);
+	CHECK(us.count(&p2) == 1);
+}
@@ -0,0 +1,98 @@
+//  grass - Generic Rail And Signalling Simulator
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version. See: COPYING-GPL.txt
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+//  2015 - Jonathan Rennison <j.g.rennison@gmail.com>
+//==========================================================================
+
+#include "common.h"
+#include "util/worker_pool.h"
+
+worker_pool::worker_pool(unsigned int thread_count) : next_index(0) {
+	for (unsigned int i = 1; i < thread_count; i++) {
+		threads.emplace_back(&worker_pool::WorkerMain, this);
+	}
+}
+
+worker_pool::~worker_pool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		shutdown = true;
+	}
+	work_cv.notify_all();
+	for (auto &it : threads) {
+		it.join();
+	}
+}
+
+void worker_pool::RunItems(const std::function<void(size_t)> &func, size_t count) {
+	while (true) {
+		size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+		if (index >= count) {
+			return;
+		}
+		func(index);
+	}
+}
+
+void worker_pool::WorkerMain() {
+	uint64_t seen_generation = 0;
+	while (true) {
+		const std::function<void(size_t)> *func;
+		size_t count;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			work_cv.wait(lock, [&]() { return shutdown || job_generation != seen_generation; });
+			if (shutdown) {
+				return;
+			}
+			seen_generation = job_generation;
+			func = job;
+			count = job_count;
+		}
+
+		RunItems(*func, count);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		busy_workers--;
+		if (busy_workers == 0) {
+			done_cv.notify_one();
+		}
+	}
+}
+
+void worker_pool::ParallelFor(size_t count, const std::function<void(size_t)> &func) {
+	if (threads.empty() || count <= 1) {
+		for (size_t i = 0; i < count; i++) {
+			func(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &func;
+		job_count = count;
+		next_index.store(0, std::memory_order_relaxed);
+		busy_workers = threads.size();
+		job_generation++;
+	}
+	work_cv.notify_all();
+
+	RunItems(func, count);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_cv.wait(lock, [&]() { return busy_workers == 0; });
+	job = nullptr;
+}